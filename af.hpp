@@ -0,0 +1,68 @@
+#ifndef __EXP_AFFINITY_HPP__
+#define __EXP_AFFINITY_HPP__
+
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+#include <ec.hpp>
+
+namespace support {
+
+////////
+/// pin semantics ->
+/// - binds the calling thread to cpu; noop if cpu < 0
+/// - false w/ err set if the kernel refuses [offline, not allowed]
+////////
+inline bool
+pin(support::error_code& err,
+    int cpu) {
+
+  if (cpu < 0) {
+    return true;
+  }
+  if (cpu >= CPU_SETSIZE) {
+    err.append(-1, "Failed to pin thread - bad cpu <" +
+                   std::to_string(cpu) + ">");
+    return false;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  const int rc = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+  if (rc) {
+    err.append(-1, "Failed to pin thread to cpu <" + std::to_string(cpu) +
+                   ">: " + std::strerror(rc));
+    return false;
+  }
+  return true;
+}
+
+////////
+/// cpus semantics ->
+/// - parses a comma separated cpu list, e.g. "2,3,5"
+/// - empty entries are skipped
+////////
+inline std::vector<int>
+cpus(const std::string& list) {
+
+  std::vector<int> out;
+  size_t b = 0;
+  while (b <= list.size()) {
+    size_t e = list.find(',', b);
+    if (e == std::string::npos) {
+      e = list.size();
+    }
+    if (e > b) {
+      out.push_back(::atoi(list.substr(b, e - b).c_str()));
+    }
+    b = e + 1;
+  }
+  return out;
+}
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef __EXP_ALLOCATION_HOOKS_HPP__
+#define __EXP_ALLOCATION_HOOKS_HPP__
+
+#include <at.hpp>
+
+////////
+/// replaces the global operator new/delete w/ support::allocations
+/// when built w/ -DEXP_TRACK_ALLOCATIONS
+/// - replacement functions can't be inline; include from exactly one
+///   translation unit, the one w/ main
+////////
+#ifdef EXP_TRACK_ALLOCATIONS
+
+void* operator new(size_t n) {
+  void* p = support::allocations::allocate(n);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t n) {
+  void* p = support::allocations::allocate(n);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t n, const std::nothrow_t&) noexcept {
+  return support::allocations::allocate(n);
+}
+
+void* operator new[](size_t n, const std::nothrow_t&) noexcept {
+  return support::allocations::allocate(n);
+}
+
+void* operator new(size_t n, std::align_val_t a) {
+  void* p = support::allocations::allocate(n, static_cast<size_t>(a));
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t n, std::align_val_t a) {
+  void* p = support::allocations::allocate(n, static_cast<size_t>(a));
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept {
+  support::allocations::release(p);
+}
+
+void operator delete[](void* p) noexcept {
+  support::allocations::release(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  support::allocations::release(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+  support::allocations::release(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+  support::allocations::release(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+  support::allocations::release(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+  support::allocations::release(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+  support::allocations::release(p);
+}
+
+#endif
+
+#endif
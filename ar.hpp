@@ -0,0 +1,187 @@
+#ifndef __EXP_ARENA_HPP__
+#define __EXP_ARENA_HPP__
+
+#include <new>
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include <mx.hpp>
+
+namespace support {
+
+////////
+/// region allocator for pointer heavy containers
+/// - blocks under 1MB are carved from large regions and recycled
+///   through exact size free lists; bigger ones [hash buckets] are
+///   mapped on their own
+/// - mappings are backed by 2MB pages when asked: MAP_HUGETLB first,
+///   falling back to madvise(MADV_HUGEPAGE) on 2MB aligned memory
+/// - optionally bound to a preferred numa node [mbind]
+/// - tb.cpp compares page backings under the matching engine
+/// - single threaded; memory returns to the os on destruction
+////////
+class arena {
+public:
+
+  ////////
+  /// page backing
+  /// - normal      -> whatever the os gives
+  /// - transparent -> madvise for transparent huge pages
+  /// - explicit    -> MAP_HUGETLB, transparent if none are reserved
+  ////////
+  enum class pages_t { normal, transparent, hugetlb };
+
+  ////////
+  /// mapping policy
+  ////////
+  struct policy {
+
+    ////////
+    /// normal pages, any node, 64MB regions
+    ////////
+    policy();
+
+    pages_t  pages;   /// page backing
+    int      node;    /// preferred numa node; -1 -> any
+    size_t   region;  /// bytes per small block region
+  };
+
+  ////////
+  /// semantics ->
+  /// - nothing is mapped until the first allocation
+  ////////
+  arena(const policy& p = policy());
+
+  ////////
+  /// semantics ->
+  /// - unmaps all regions [blocks must no longer be used]
+  ////////
+  ~arena();
+
+  arena(const arena&) = delete;
+  arena& operator=(const arena&) = delete;
+
+  ////////
+  /// allocate semantics ->
+  /// - n bytes, 16 byte aligned
+  /// - throws std::bad_alloc if the os refuses
+  ////////
+  void* allocate(size_t n);
+
+  ////////
+  /// deallocate semantics ->
+  /// - n must be what p was allocated with
+  ////////
+  void deallocate(void* p, size_t n);
+
+  ////////
+  /// bytes mapped now / ever mapped w/ MAP_HUGETLB
+  ////////
+  size_t mapped() const;
+  size_t hugetlb() const;
+
+  ////////
+  /// for tracing the mapping summary
+  ////////
+  template <class T>
+  friend T& operator<<(T& out, const arena& in);
+
+private:
+
+  ////////
+  /// free list link
+  ////////
+  struct free_block {
+    free_block*  next;
+  };
+
+  static const size_t align_   = 16;
+  static const size_t classes_ = 32;  /// up to 512 bytes
+  static const size_t huge_    = size_t(2) << 20;
+
+  ////////
+  /// semantics ->
+  /// - size bytes from the current region, a new one if short
+  ////////
+  void* carve(size_t size);
+
+  ////////
+  /// semantics ->
+  /// - true if a mapping of n bytes gets 2MB pages [at least 1MB]
+  ////////
+  bool huge(size_t n) const;
+
+  ////////
+  /// semantics ->
+  /// - maps n bytes [rounded up], w/ 2MB pages per policy if huge
+  /// - nullptr on failure
+  ////////
+  void* map(size_t& n, bool huge);
+
+  ////////
+  /// semantics ->
+  /// - n rounded up to the mapping granularity
+  ////////
+  size_t round(size_t n, bool huge) const;
+
+  typedef std::unordered_map<size_t, free_block*> medium_t;
+
+  policy               policy_;
+  free_block*          free_[classes_];
+  medium_t             medium_;
+  char*                cur_;
+  char*                end_;
+  std::vector<void*>   regions_;
+  size_t               mapped_;
+  size_t               hugetlb_;
+  metrics::gauge       mapped_bytes_;  /// process wide, all arenas
+};
+
+////////
+/// std allocator over an arena
+/// - a null arena falls back to operator new/delete
+////////
+template <class T>
+class arena_allocator {
+public:
+
+  typedef T value_type;
+
+  arena_allocator(arena* a = nullptr) noexcept;
+
+  template <class U>
+  arena_allocator(const arena_allocator<U>& o) noexcept;
+
+  T* allocate(size_t n);
+  void deallocate(T* p, size_t n);
+
+  ////////
+  /// backing arena or nullptr
+  ////////
+  arena* get() const noexcept;
+
+  template <class U>
+  struct rebind {
+    typedef arena_allocator<U> other;
+  };
+
+private:
+  arena*  arena_;
+};
+
+template <class T, class U>
+bool operator==(const arena_allocator<T>& l, const arena_allocator<U>& r);
+
+template <class T, class U>
+bool operator!=(const arena_allocator<T>& l, const arena_allocator<U>& r);
+
+}
+
+#include <ar.ipp>
+
+#endif
@@ -0,0 +1,336 @@
+namespace support {
+
+////////
+/// policy constructor
+////////
+inline
+arena::
+policy::
+policy() :
+  pages (pages_t::normal),
+  node  (-1),
+  region(64 << 20)
+{}
+
+////////
+/// constructor
+////////
+inline
+arena::
+arena(const policy& p) :
+  policy_ (p),
+  cur_    (nullptr),
+  end_    (nullptr),
+  mapped_ (0),
+  hugetlb_(0),
+  mapped_bytes_(metrics::instance().make_gauge(
+    "arena_mapped_bytes", "Bytes mapped by arenas")) {
+
+  for (size_t i = 0; i < classes_; ++i) {
+    free_[i] = nullptr;
+  }
+  policy_.region = (policy_.region + huge_ - 1) / huge_ * huge_;
+  if (!policy_.region) {
+    policy_.region = huge_;
+  }
+}
+
+////////
+/// destructor
+////////
+inline
+arena::
+~arena() {
+  for (size_t i = 0; i < regions_.size(); ++i) {
+    ::munmap(regions_[i], policy_.region);
+  }
+  mapped_bytes_.add(-static_cast<int64_t>(mapped_));
+}
+
+////////
+/// allocate
+////////
+inline void*
+arena::
+allocate(size_t n) {
+
+  const size_t c = (n + align_ - 1) / align_;
+  if (c <= classes_) {
+    const size_t i = c ? c - 1 : 0;
+    if (free_[i]) {
+      free_block* b = free_[i];
+      free_[i] = b->next;
+      return b;
+    }
+    return carve((i + 1) * align_);
+  }
+  ////////
+  /// medium blocks [pool chunks] share the regions' pages
+  ////////
+  if (n < huge_ / 2) {
+    const size_t size = (n + 63) & ~size_t(63);
+    free_block*& b = medium_[size];
+    if (b) {
+      free_block* p = b;
+      b = b->next;
+      return p;
+    }
+    return carve(size);
+  }
+  size_t m = n;
+  void* p = map(m, huge(n));
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+////////
+/// deallocate
+////////
+inline void
+arena::
+deallocate(void* p,
+           size_t n) {
+
+  if (!p) {
+    return;
+  }
+  free_block* b = static_cast<free_block*>(p);
+  const size_t c = (n + align_ - 1) / align_;
+  if (c <= classes_) {
+    const size_t i = c ? c - 1 : 0;
+    b->next = free_[i];
+    free_[i] = b;
+    return;
+  }
+  if (n < huge_ / 2) {
+    free_block*& f = medium_[(n + 63) & ~size_t(63)];
+    b->next = f;
+    f = b;
+    return;
+  }
+  const size_t m = round(n, huge(n));
+  ::munmap(p, m);
+  mapped_ -= m;
+  mapped_bytes_.add(-static_cast<int64_t>(m));
+}
+
+////////
+/// carve
+////////
+inline void*
+arena::
+carve(size_t size) {
+
+  ////////
+  /// the current region's tail is dropped when short
+  ////////
+  if (size_t(end_ - cur_) < size) {
+    size_t m = policy_.region;
+    char* r = static_cast<char*>(map(m, huge(m)));
+    if (!r) {
+      throw std::bad_alloc();
+    }
+    regions_.push_back(r);
+    cur_ = r;
+    end_ = r + m;
+  }
+  void* p = cur_;
+  cur_ += size;
+  return p;
+}
+
+////////
+/// mapped
+////////
+inline size_t
+arena::
+mapped() const {
+  return mapped_;
+}
+
+////////
+/// hugetlb
+////////
+inline size_t
+arena::
+hugetlb() const {
+  return hugetlb_;
+}
+
+////////
+/// huge
+////////
+inline bool
+arena::
+huge(size_t n) const {
+  return policy_.pages != pages_t::normal && n >= huge_ / 2;
+}
+
+////////
+/// round
+////////
+inline size_t
+arena::
+round(size_t n,
+      bool huge) const {
+
+  const size_t g = huge ? huge_ : size_t(::sysconf(_SC_PAGESIZE));
+  return (n + g - 1) / g * g;
+}
+
+////////
+/// map
+////////
+inline void*
+arena::
+map(size_t& n,
+    bool huge) {
+
+  n = round(n, huge);
+  void* p = MAP_FAILED;
+  bool  h = false;
+  if (huge && policy_.pages == pages_t::hugetlb) {
+    p = ::mmap(nullptr, n, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    h = p != MAP_FAILED;
+  }
+  if (p == MAP_FAILED && huge) {
+
+    ////////
+    /// over map and trim so the region starts on a 2MB boundary
+    ////////
+    void* q = ::mmap(nullptr, n + huge_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (q != MAP_FAILED) {
+      const uintptr_t a = reinterpret_cast<uintptr_t>(q);
+      const uintptr_t b = (a + huge_ - 1) & ~(uintptr_t(huge_) - 1);
+      if (b != a) {
+        ::munmap(q, b - a);
+      }
+      if (a + huge_ != b) {
+        ::munmap(reinterpret_cast<void*>(b + n), a + huge_ - b);
+      }
+      p = reinterpret_cast<void*>(b);
+      ::madvise(p, n, MADV_HUGEPAGE);
+    }
+  }
+  if (p == MAP_FAILED && !huge) {
+    p = ::mmap(nullptr, n, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  }
+  if (p == MAP_FAILED) {
+    return nullptr;
+  }
+  ////////
+  /// prefer the node before anything touches the pages; best effort
+  ////////
+  if (policy_.node >= 0 && policy_.node < 64) {
+    unsigned long mask = 1UL << policy_.node;
+    ::syscall(SYS_mbind, p, n, MPOL_PREFERRED, &mask,
+              sizeof(mask) * 8 + 1, 0);
+  }
+  mapped_ += n;
+  mapped_bytes_.add(n);
+  if (h) {
+    hugetlb_ += n;
+  }
+  return p;
+}
+
+////////
+/// operator<< (arena)
+////////
+template <class T>
+T& operator<<(T& out, const arena& in) {
+
+  static const char* pages[] = { "normal", "transparent", "hugetlb" };
+  return out << "Arena: pages "
+             << pages[static_cast<int>(in.policy_.pages)]
+             << ", node "
+             << in.policy_.node
+             << ", mapped "
+             << in.mapped_
+             << ", hugetlb "
+             << in.hugetlb_
+             << std::endl;
+}
+
+////////
+/// arena_allocator constructor
+////////
+template <class T>
+inline
+arena_allocator<T>::
+arena_allocator(arena* a) noexcept :
+  arena_(a) {
+}
+
+////////
+/// arena_allocator converting constructor
+////////
+template <class T>
+template <class U>
+inline
+arena_allocator<T>::
+arena_allocator(const arena_allocator<U>& o) noexcept :
+  arena_(o.get()) {
+}
+
+////////
+/// arena_allocator allocate
+////////
+template <class T>
+inline T*
+arena_allocator<T>::
+allocate(size_t n) {
+  if (!arena_) {
+    return static_cast<T*>(::operator new(n * sizeof(T)));
+  }
+  return static_cast<T*>(arena_->allocate(n * sizeof(T)));
+}
+
+////////
+/// arena_allocator deallocate
+////////
+template <class T>
+inline void
+arena_allocator<T>::
+deallocate(T* p,
+           size_t n) {
+  if (!arena_) {
+    ::operator delete(p);
+    return;
+  }
+  arena_->deallocate(p, n * sizeof(T));
+}
+
+////////
+/// arena_allocator get
+////////
+template <class T>
+inline arena*
+arena_allocator<T>::
+get() const noexcept {
+  return arena_;
+}
+
+////////
+/// arena_allocator equality
+////////
+template <class T, class U>
+inline bool
+operator==(const arena_allocator<T>& l,
+           const arena_allocator<U>& r) {
+  return l.get() == r.get();
+}
+
+template <class T, class U>
+inline bool
+operator!=(const arena_allocator<T>& l,
+           const arena_allocator<U>& r) {
+  return l.get() != r.get();
+}
+
+}
@@ -0,0 +1,131 @@
+#ifndef __EXP_ALLOCATIONS_HPP__
+#define __EXP_ALLOCATIONS_HPP__
+
+#include <atomic>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+namespace support {
+
+////////
+/// heap allocations attributed to tagged scopes
+/// - opt in at build time w/ -DEXP_TRACK_ALLOCATIONS; without it
+///   scopes are empty and nothing is counted
+/// - counting needs the global operator new/delete replaced [see
+///   ah.hpp]; util::heap_allocator goes through operator new[] so it
+///   is covered as well
+/// - every block carries a small header w/ its size and tag so a
+///   free is charged to the scope that allocated it, whichever scope
+///   frees it
+/// - counts are process wide relaxed atomics per tag
+////////
+class allocations {
+public:
+
+  ////////
+  /// tags; other is whatever runs outside a scope
+  ////////
+  enum tag_t {
+    other,
+    parse,
+    handle_new,
+    handle_cancel,
+    handle_modify,
+    handle_trade,
+    resolve,
+    tracing,
+    errors,
+    tags_
+  };
+
+  ////////
+  /// charges allocations on this thread to a tag until destroyed
+  /// - nests; the previous tag is restored
+  ////////
+  class scope {
+  public:
+    scope(tag_t tag);
+    ~scope();
+
+    scope(const scope&) = delete;
+    scope& operator=(const scope&) = delete;
+
+#ifdef EXP_TRACK_ALLOCATIONS
+  private:
+    tag_t  prev_;
+#endif
+  };
+
+  ////////
+  /// semantics ->
+  /// - true if built w/ EXP_TRACK_ALLOCATIONS
+  ////////
+  static constexpr bool enabled() {
+#ifdef EXP_TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  ////////
+  /// allocate semantics ->
+  /// - malloc w/ a header, charged to the running tag
+  /// - null on failure; align is a power of two
+  ////////
+  static void* allocate(size_t n, size_t align = alignof(std::max_align_t));
+
+  ////////
+  /// release semantics ->
+  /// - frees a block from allocate, credited to its tag; null ok
+  ////////
+  static void release(void* p);
+
+  ////////
+  /// semantics ->
+  /// - allocations and bytes charged to tag so far
+  ////////
+  static uint64_t allocs(tag_t tag);
+  static uint64_t bytes(tag_t tag);
+
+  ////////
+  /// for tracing allocations, bytes, live bytes and high water mark
+  /// per tag
+  ////////
+  template <class T>
+  friend T& operator<<(T& out, const allocations& in);
+
+private:
+
+  ////////
+  /// per tag counts
+  ////////
+  struct counts {
+    std::atomic<uint64_t>  allocs;
+    std::atomic<uint64_t>  frees;
+    std::atomic<uint64_t>  bytes;
+    std::atomic<int64_t>   live;
+    std::atomic<int64_t>   peak;
+  };
+
+  ////////
+  /// in front of every block; a multiple of 16 bytes so the block
+  /// keeps operator new's alignment
+  ////////
+  struct alignas(16) header {
+    size_t    size;
+    uint32_t  tag;
+    uint32_t  offset;   /// header start to block start
+  };
+
+  static counts            counts_[tags_];
+  static thread_local int  tag_;
+};
+
+}
+
+#include <at.ipp>
+
+#endif
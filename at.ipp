@@ -0,0 +1,145 @@
+namespace support {
+
+inline allocations::counts  allocations::counts_[allocations::tags_];
+inline thread_local int     allocations::tag_ = allocations::other;
+
+////////
+/// scope constructor
+////////
+inline
+allocations::
+scope::
+scope(tag_t tag) {
+#ifdef EXP_TRACK_ALLOCATIONS
+  prev_ = static_cast<tag_t>(tag_);
+  tag_  = tag;
+#else
+  (void) tag;
+#endif
+}
+
+////////
+/// scope destructor
+////////
+inline
+allocations::
+scope::
+~scope() {
+#ifdef EXP_TRACK_ALLOCATIONS
+  tag_ = prev_;
+#endif
+}
+
+////////
+/// allocate
+/// - header sits right before the block; over aligned blocks pad in
+///   front of it
+////////
+inline void*
+allocations::
+allocate(size_t n,
+         size_t align) {
+
+  if (align < alignof(header)) {
+    align = alignof(header);
+  }
+  const size_t offset = (sizeof(header) + align - 1) / align * align;
+  void* p = align > alignof(std::max_align_t) ?
+    std::aligned_alloc(align, (offset + n + align - 1) / align * align) :
+    std::malloc(offset + n);
+  if (!p) {
+    return nullptr;
+  }
+  char* block = static_cast<char*>(p) + offset;
+  header* h   = reinterpret_cast<header*>(block) - 1;
+  h->size     = n;
+  h->tag      = tag_;
+  h->offset   = offset;
+
+  counts& c = counts_[h->tag];
+  c.allocs.fetch_add(1, std::memory_order_relaxed);
+  c.bytes.fetch_add(n, std::memory_order_relaxed);
+  const int64_t live =
+    c.live.fetch_add(n, std::memory_order_relaxed) + int64_t(n);
+  int64_t peak = c.peak.load(std::memory_order_relaxed);
+  while (live > peak &&
+         !c.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+  }
+  return block;
+}
+
+////////
+/// release
+/// - the header is found from the char* block as allocate placed it
+////////
+inline void
+allocations::
+release(void* p) {
+
+  if (!p) {
+    return;
+  }
+  char* block = static_cast<char*>(p);
+  header* h   = reinterpret_cast<header*>(block) - 1;
+  counts& c   = counts_[h->tag];
+  c.frees.fetch_add(1, std::memory_order_relaxed);
+  c.live.fetch_sub(h->size, std::memory_order_relaxed);
+  std::free(block - h->offset);
+}
+
+////////
+/// allocs
+////////
+inline uint64_t
+allocations::
+allocs(tag_t tag) {
+  return counts_[tag].allocs.load(std::memory_order_relaxed);
+}
+
+////////
+/// bytes
+////////
+inline uint64_t
+allocations::
+bytes(tag_t tag) {
+  return counts_[tag].bytes.load(std::memory_order_relaxed);
+}
+
+////////
+/// operator<< (allocations)
+/// - live bytes still held at the time of the trace; peak is per tag,
+///   not the process high water mark
+////////
+template <class T>
+T& operator<<(T& out, const allocations&) {
+
+  static const char* names[] = {
+    "other", "parse", "handle_new", "handle_cancel", "handle_modify",
+    "handle_trade", "resolve", "tracing", "errors"
+  };
+
+  if (!allocations::enabled()) {
+    return out << "Allocations: not tracked [build w/ "
+               << "-DEXP_TRACK_ALLOCATIONS]" << std::endl;
+  }
+  out << "Allocations: tag, allocs, frees, bytes, live, peak" << std::endl;
+  for (size_t i = 0; i < allocations::tags_; ++i) {
+    const allocations::counts& c = allocations::counts_[i];
+    out << "  "
+        << names[i]
+        << ", "
+        << c.allocs.load(std::memory_order_relaxed)
+        << ", "
+        << c.frees.load(std::memory_order_relaxed)
+        << ", "
+        << c.bytes.load(std::memory_order_relaxed)
+        << ", "
+        << c.live.load(std::memory_order_relaxed)
+        << ", "
+        << c.peak.load(std::memory_order_relaxed)
+        << std::endl;
+  }
+  return out;
+}
+
+}
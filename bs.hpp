@@ -0,0 +1,406 @@
+#ifndef __EXP_BOOK_SNAPSHOTS_HPP__
+#define __EXP_BOOK_SNAPSHOTS_HPP__
+
+#include <new>
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+#include <ep.hpp>
+
+namespace trade {
+
+////////
+/// point in time views of the order book for concurrent readers
+/// - a view is two immutable two level tables: products -> books of
+///   price level pages, and ids -> levels; each splits into blocks of
+///   slots that views share until a publish touches them
+/// - the ingest thread records each book change as it happens
+///   [add, update, remove]; a publish copies the pages, books and id
+///   shards the changes hit, the blocks holding them and the two top
+///   level arrays, and shares everything else w/ the previous view,
+///   so its cost follows the changes, not the book
+/// - views are swapped through an atomic pointer; whatever a publish
+///   replaced is reclaimed by epoch, so readers never lock and never
+///   block ingest
+/// - sr.cpp measures ingest w/ and w/o readers
+////////
+class book_snapshots {
+public:
+
+  ////////
+  /// a resting order as seen by readers
+  ////////
+  struct order_view {
+    int   id;
+    int   prod;
+    char  side;      /// 'B' or 'S'
+    int   quantity;
+    int   price;
+  };
+
+  typedef std::vector<order_view> order_views;
+
+  ////////
+  /// one price level's resting orders in queue order; the orders
+  /// follow the struct
+  ////////
+  struct page {
+    int       prod;
+    char      side;
+    int       price;
+    uint32_t  size;
+
+    const order_view* begin() const;
+    const order_view* end() const;
+
+    static void operator delete(void* p);
+  };
+
+  ////////
+  /// one product's levels, bids best first, then asks best first; the
+  /// pages follow the struct
+  ////////
+  struct alignas(void*) book {
+    int       prod;
+    uint32_t  bids;
+    uint32_t  size;
+
+    const page* const* begin() const;
+    const page* const* end() const;
+
+    static void operator delete(void* p);
+  };
+
+  ////////
+  /// books of the products hashing to one slot, by product; the books
+  /// follow the struct
+  ////////
+  struct alignas(void*) bucket {
+    uint32_t  size;
+
+    const book* const* begin() const;
+    const book* const* end() const;
+
+    static void operator delete(void* p);
+  };
+
+  ////////
+  /// level of a resting order
+  ////////
+  struct location {
+    int   id;
+    int   prod;
+    char  side;
+    int   price;
+  };
+
+  ////////
+  /// locations of the ids hashing to one slot, by id; the entries
+  /// follow the struct
+  ////////
+  struct shard {
+    uint32_t  size;
+
+    const location* begin() const;
+    const location* end() const;
+
+    static void operator delete(void* p);
+  };
+
+  ////////
+  /// slots per block and blocks per table; a power of two
+  ////////
+  static constexpr size_t fanout_ = 1 << 7;
+
+  ////////
+  /// slots per table
+  ////////
+  static constexpr size_t slots_ = fanout_ * fanout_;
+
+  ////////
+  /// fanout_ slots, null if empty
+  ////////
+  template <class T>
+  struct block {
+    const T* slots[fanout_];
+  };
+
+  ////////
+  /// slots_ slots in fanout_ blocks; a block is null until one of its
+  /// slots is set
+  ////////
+  template <class T>
+  struct table {
+
+    ////////
+    /// semantics ->
+    /// - slot i, null if empty
+    ////////
+    const T* operator[](uint32_t i) const;
+
+    const block<T>* blocks[fanout_];
+  };
+
+  ////////
+  /// a published view
+  /// - products by slot of product, ids by slot of id
+  ////////
+  struct view {
+
+    ////////
+    /// semantics ->
+    /// - prod's book or nullptr if nothing rests
+    ////////
+    const book* find_book(int prod) const;
+
+    ////////
+    /// semantics ->
+    /// - appends prod's orders to out in book order
+    ////////
+    void product(int prod, order_views& out) const;
+
+    ////////
+    /// semantics ->
+    /// - order by id or nullptr; one shard, one book, one page lookup
+    ////////
+    const order_view* find(int id) const;
+
+    ////////
+    /// semantics ->
+    /// - per product, appends orders priced through the best
+    ///   opposite price [bids >= best ask, asks <= best bid]
+    /// - products in table order
+    ////////
+    void crossed(order_views& out) const;
+
+    uint64_t       version;   /// publication count
+    size_t         messages;  /// messages applied
+    table<bucket>  products;
+    table<shard>   ids;
+  };
+
+  ////////
+  /// a reader thread's handle
+  ////////
+  class reader {
+  public:
+
+    ////////
+    /// semantics ->
+    /// - registers w/ the snapshots' epoch domain
+    /// - throws std::length_error if every epoch slot is taken
+    ////////
+    reader(book_snapshots& s);
+
+    ////////
+    /// read semantics ->
+    /// - calls f(const view&) inside an epoch guard
+    /// - everything f sees is from one point in time
+    ////////
+    template <class F>
+    void read(F f);
+
+    ////////
+    /// semantics ->
+    /// - copies prod's orders into out, returns the count
+    ////////
+    size_t product(int prod, order_views& out);
+
+    ////////
+    /// semantics ->
+    /// - copies order id into out, false if not resting
+    ////////
+    bool find(int id, order_view& out);
+
+    ////////
+    /// semantics ->
+    /// - copies every crossed order into out, returns the count
+    ////////
+    size_t crossed(order_views& out);
+
+  private:
+    book_snapshots&        snapshots_;
+    support::epoch::reader reader_;
+  };
+
+  ////////
+  /// semantics ->
+  /// - publishes an empty view
+  ////////
+  book_snapshots();
+
+  ////////
+  /// semantics ->
+  /// - deletes the current view w/ everything it holds [readers must
+  ///   be gone]
+  ////////
+  ~book_snapshots();
+
+  book_snapshots(const book_snapshots&) = delete;
+  book_snapshots& operator=(const book_snapshots&) = delete;
+
+  ////////
+  /// semantics -> [ingest thread]
+  /// - add: id joins the tail of its level
+  /// - update: id's quantity changes in place, keeps its priority
+  /// - remove: id leaves its level
+  /// - changes are seen by readers w/ the next publish, in the order
+  ///   they were made
+  ////////
+  void add(int prod, char side, int price, int id, int quantity);
+  void update(int prod, char side, int price, int id, int quantity);
+  void remove(int prod, char side, int price, int id);
+
+  ////////
+  /// publish semantics -> [ingest thread]
+  /// - noop if nothing changed
+  /// - applies the changes to copies of the pages, books, buckets,
+  ///   shards and blocks they hit; the rest are shared w/ the current
+  ///   view
+  /// - swaps the new view in and retires the old one w/ whatever it
+  ///   no longer shares
+  ////////
+  void publish(size_t messages);
+
+private:
+
+  ////////
+  /// page ordering - product, side, best price first
+  ////////
+  struct key {
+    int   prod;
+    char  side;
+    int   price;
+  };
+
+  ////////
+  /// a recorded book change; seq keeps ingest order within a level
+  ////////
+  enum class change_t : uint8_t { add, update, remove };
+
+  struct change {
+    key       level;
+    int       id;
+    int       quantity;
+    uint32_t  seq;
+    change_t  type;
+  };
+
+  ////////
+  /// an id map change, from applying a level's changes
+  ////////
+  struct move {
+    uint32_t  shard;
+    uint32_t  seq;
+    location  at;
+    bool      erase;
+  };
+
+  ////////
+  /// a product's new book [null once empty], from applying its changes
+  ////////
+  struct rebook {
+    uint32_t     bucket;
+    int          prod;
+    const book*  next;
+  };
+
+  ////////
+  /// a change's place in publish order as two words: product and side,
+  /// then price best first and seq; the low half of second is the
+  /// change's index
+  ////////
+  typedef std::pair<uint64_t, uint64_t> rank;
+
+  ////////
+  /// semantics ->
+  /// - strict weak order on keys
+  ////////
+  static bool before(const key& l, const key& r);
+
+  ////////
+  /// semantics ->
+  /// - rank of c; ranks sort like before() on levels, then by seq
+  ////////
+  static rank rank_of(const change& c);
+
+  ////////
+  /// semantics ->
+  /// - key of page p
+  ////////
+  static key key_of(const page& p);
+
+  ////////
+  /// semantics ->
+  /// - table slot of id / product - their low bits; both are mostly
+  ///   sequential, so a publish's new ids share a few blocks and small
+  ///   products share one
+  ////////
+  static uint32_t slot_of(int id);
+
+  ////////
+  /// semantics ->
+  /// - new T w/ head's fields followed by a copy of entries
+  ////////
+  template <class T, class E>
+  static const T* make(const T& head, const std::vector<E>& entries);
+
+  ////////
+  /// semantics ->
+  /// - sets slot i of next, which started as a copy of old; a block
+  ///   still shared w/ old is copied first and the original deferred
+  ////////
+  template <class T>
+  void assign(table<T>& next,
+              const table<T>& old,
+              uint32_t i,
+              const T* p);
+
+  ////////
+  /// semantics ->
+  /// - deletes every block of t and what its slots hold
+  ////////
+  template <class T>
+  static void destroy(const table<T>& t);
+  static void destroy(const bucket* b);
+  static void destroy(const shard* s);
+
+  ////////
+  /// semantics ->
+  /// - applies one product's changes [first, last) to a copy of old;
+  ///   records its new book in rebooks_ and id map changes in moves_
+  ////////
+  void apply_book(const book* old,
+                  std::vector<change>::const_iterator first,
+                  std::vector<change>::const_iterator last);
+
+  ////////
+  /// semantics ->
+  /// - applies one level's changes [first, last) to a copy of old
+  ///   into levels_; records id map changes in moves_
+  ////////
+  void apply(const page* old,
+             std::vector<change>::const_iterator first,
+             std::vector<change>::const_iterator last);
+
+  std::atomic<const view*>  current_;
+  support::epoch            epoch_;
+  std::vector<change>       changes_;
+  std::vector<rank>         ranks_;
+  std::vector<change>       sorted_;
+  std::vector<move>         moves_;
+  std::vector<rebook>       rebooks_;
+  order_views               scratch_;
+  std::vector<const page*>  levels_;
+  std::vector<const book*>  books_;
+  std::vector<location>     locations_;
+};
+
+}
+
+#include <bs.ipp>
+
+#endif
@@ -0,0 +1,721 @@
+namespace trade {
+
+////////
+/// page begin
+////////
+inline const book_snapshots::order_view*
+book_snapshots::
+page::
+begin() const {
+  return reinterpret_cast<const order_view*>(this + 1);
+}
+
+////////
+/// page end
+////////
+inline const book_snapshots::order_view*
+book_snapshots::
+page::
+end() const {
+  return begin() + size;
+}
+
+////////
+/// page delete - pages are allocated w/ their orders
+////////
+inline void
+book_snapshots::
+page::
+operator delete(void* p) {
+  ::operator delete(p);
+}
+
+////////
+/// book begin
+////////
+inline const book_snapshots::page* const*
+book_snapshots::
+book::
+begin() const {
+  return reinterpret_cast<const page* const*>(this + 1);
+}
+
+////////
+/// book end
+////////
+inline const book_snapshots::page* const*
+book_snapshots::
+book::
+end() const {
+  return begin() + size;
+}
+
+////////
+/// book delete - books are allocated w/ their page pointers
+////////
+inline void
+book_snapshots::
+book::
+operator delete(void* p) {
+  ::operator delete(p);
+}
+
+////////
+/// bucket begin
+////////
+inline const book_snapshots::book* const*
+book_snapshots::
+bucket::
+begin() const {
+  return reinterpret_cast<const book* const*>(this + 1);
+}
+
+////////
+/// bucket end
+////////
+inline const book_snapshots::book* const*
+book_snapshots::
+bucket::
+end() const {
+  return begin() + size;
+}
+
+////////
+/// bucket delete - buckets are allocated w/ their book pointers
+////////
+inline void
+book_snapshots::
+bucket::
+operator delete(void* p) {
+  ::operator delete(p);
+}
+
+////////
+/// shard begin
+////////
+inline const book_snapshots::location*
+book_snapshots::
+shard::
+begin() const {
+  return reinterpret_cast<const location*>(this + 1);
+}
+
+////////
+/// shard end
+////////
+inline const book_snapshots::location*
+book_snapshots::
+shard::
+end() const {
+  return begin() + size;
+}
+
+////////
+/// shard delete - shards are allocated w/ their entries
+////////
+inline void
+book_snapshots::
+shard::
+operator delete(void* p) {
+  ::operator delete(p);
+}
+
+////////
+/// table operator[]
+////////
+template <class T>
+inline const T*
+book_snapshots::
+table<T>::
+operator[](uint32_t i) const {
+  const block<T>* b = blocks[i / fanout_];
+  return b ? b->slots[i % fanout_] : nullptr;
+}
+
+////////
+/// view find book
+////////
+inline const book_snapshots::book*
+book_snapshots::
+view::
+find_book(int prod) const {
+
+  const bucket* b = products[slot_of(prod)];
+  if (!b) {
+    return nullptr;
+  }
+  const book* const* p = std::lower_bound(b->begin(), b->end(), prod,
+    [](const book* e, int r) { return e->prod < r; });
+  return p == b->end() || (*p)->prod != prod ? nullptr : *p;
+}
+
+////////
+/// view product
+////////
+inline void
+book_snapshots::
+view::
+product(int prod,
+        order_views& out) const {
+
+  const book* b = find_book(prod);
+  if (!b) {
+    return;
+  }
+  for (const page* p : *b) {
+    out.insert(out.end(), p->begin(), p->end());
+  }
+}
+
+////////
+/// view find
+////////
+inline const book_snapshots::order_view*
+book_snapshots::
+view::
+find(int id) const {
+
+  const shard* s = ids[slot_of(id)];
+  if (!s) {
+    return nullptr;
+  }
+  const location* l = std::lower_bound(s->begin(), s->end(), id,
+    [](const location& e, int i) { return e.id < i; });
+  if (l == s->end() || l->id != id) {
+    return nullptr;
+  }
+  const book* b = find_book(l->prod);
+  if (!b) {
+    return nullptr;
+  }
+  const key k{l->prod, l->side, l->price};
+  const page* const* p = std::lower_bound(b->begin(), b->end(), k,
+    [](const page* e, const key& r) { return before(key_of(*e), r); });
+  if (p == b->end() || before(k, key_of(**p))) {
+    return nullptr;
+  }
+  const order_view* o = std::find_if((*p)->begin(), (*p)->end(),
+    [id](const order_view& e) { return e.id == id; });
+  return o == (*p)->end() ? nullptr : o;
+}
+
+////////
+/// view crossed
+////////
+inline void
+book_snapshots::
+view::
+crossed(order_views& out) const {
+
+  for (size_t i = 0; i < fanout_; ++i) {
+    const block<bucket>* k = products.blocks[i];
+    for (size_t j = 0; k && j < fanout_; ++j) {
+      if (!k->slots[j]) {
+        continue;
+      }
+      for (const book* b : *k->slots[j]) {
+
+        ////////
+        /// bids come first, best first, then asks
+        ////////
+        const page* const* bids = b->begin();
+        const page* const* asks = bids + b->bids;
+        if (asks == bids || asks == b->end() ||
+            (*bids)->price < (*asks)->price) {
+          continue;
+        }
+        const int bid = (*bids)->price;
+        const int ask = (*asks)->price;
+        for (const page* const* p = bids; p != asks && (*p)->price >= ask;
+             ++p) {
+          out.insert(out.end(), (*p)->begin(), (*p)->end());
+        }
+        for (const page* const* p = asks; p != b->end() && (*p)->price <= bid;
+             ++p) {
+          out.insert(out.end(), (*p)->begin(), (*p)->end());
+        }
+      }
+    }
+  }
+}
+
+////////
+/// reader constructor
+////////
+inline
+book_snapshots::
+reader::
+reader(book_snapshots& s) :
+  snapshots_(s),
+  reader_(s.epoch_) {
+}
+
+////////
+/// reader read
+////////
+template <class F>
+inline void
+book_snapshots::
+reader::
+read(F f) {
+  support::epoch::guard g(reader_);
+  f(*snapshots_.current_.load());
+}
+
+////////
+/// reader product
+////////
+inline size_t
+book_snapshots::
+reader::
+product(int prod,
+        order_views& out) {
+
+  out.clear();
+  read([prod, &out](const view& v) { v.product(prod, out); });
+  return out.size();
+}
+
+////////
+/// reader find
+////////
+inline bool
+book_snapshots::
+reader::
+find(int id,
+     order_view& out) {
+
+  bool found = false;
+  read([id, &out, &found](const view& v) {
+    const order_view* o = v.find(id);
+    if (o) {
+      out = *o;
+      found = true;
+    }
+  });
+  return found;
+}
+
+////////
+/// reader crossed
+////////
+inline size_t
+book_snapshots::
+reader::
+crossed(order_views& out) {
+
+  out.clear();
+  read([&out](const view& v) { v.crossed(out); });
+  return out.size();
+}
+
+////////
+/// constructor
+////////
+inline
+book_snapshots::
+book_snapshots() :
+  current_(new view()) {
+}
+
+////////
+/// destructor
+////////
+inline
+book_snapshots::
+~book_snapshots() {
+
+  const view* v = current_.load();
+  destroy(v->products);
+  destroy(v->ids);
+  delete v;
+}
+
+////////
+/// add
+////////
+inline void
+book_snapshots::
+add(int prod,
+    char side,
+    int price,
+    int id,
+    int quantity) {
+  changes_.push_back(change{key{prod, side, price}, id, quantity,
+                            uint32_t(changes_.size()), change_t::add});
+}
+
+////////
+/// update
+////////
+inline void
+book_snapshots::
+update(int prod,
+       char side,
+       int price,
+       int id,
+       int quantity) {
+  changes_.push_back(change{key{prod, side, price}, id, quantity,
+                            uint32_t(changes_.size()), change_t::update});
+}
+
+////////
+/// remove
+////////
+inline void
+book_snapshots::
+remove(int prod,
+       char side,
+       int price,
+       int id) {
+  changes_.push_back(change{key{prod, side, price}, id, 0,
+                            uint32_t(changes_.size()), change_t::remove});
+}
+
+////////
+/// publish
+/// - whatever the new view replaces is deferred as it's replaced; the
+///   retire of the old view below reclaims it all w/ that epoch
+////////
+inline void
+book_snapshots::
+publish(size_t messages) {
+
+  if (changes_.empty()) {
+    return;
+  }
+
+  ////////
+  /// changes by level, in ingest order within one; sorting two word
+  /// ranks is much cheaper than comparing levels field by field
+  ////////
+  ranks_.clear();
+  for (size_t i = 0; i < changes_.size(); ++i) {
+    ranks_.push_back(rank_of(changes_[i]));
+  }
+  std::sort(ranks_.begin(), ranks_.end());
+  sorted_.clear();
+  for (size_t i = 0; i < ranks_.size(); ++i) {
+    sorted_.push_back(changes_[uint32_t(ranks_[i].second)]);
+  }
+  changes_.clear();
+
+  ////////
+  /// the new view starts as a copy of the old one's top level arrays
+  ////////
+  const view* old = current_.load(std::memory_order_relaxed);
+  view* v = new view(*old);
+  v->version  = old->version + 1;
+  v->messages = messages;
+  moves_.clear();
+  rebooks_.clear();
+
+  ////////
+  /// rebuild the books of the changed products
+  ////////
+  std::vector<change>::const_iterator c = sorted_.begin();
+  while (c != sorted_.end()) {
+    std::vector<change>::const_iterator e = c + 1;
+    while (e != sorted_.end() && e->level.prod == c->level.prod) {
+      ++e;
+    }
+    apply_book(old->find_book(c->level.prod), c, e);
+    c = e;
+  }
+
+  ////////
+  /// then the buckets holding them, one copy per bucket
+  ////////
+  std::sort(rebooks_.begin(), rebooks_.end(),
+    [](const rebook& l, const rebook& r) {
+      return l.bucket < r.bucket || (l.bucket == r.bucket && l.prod < r.prod);
+    });
+  std::vector<rebook>::const_iterator r = rebooks_.begin();
+  while (r != rebooks_.end()) {
+    const uint32_t n = r->bucket;
+    const bucket* b = old->products[n];
+    books_.clear();
+    if (b) {
+      books_.assign(b->begin(), b->end());
+      epoch_.defer(b);
+    }
+    for (; r != rebooks_.end() && r->bucket == n; ++r) {
+      std::vector<const book*>::iterator p = std::lower_bound(
+        books_.begin(), books_.end(), r->prod,
+        [](const book* e, int prod) { return e->prod < prod; });
+      const bool found = p != books_.end() && (*p)->prod == r->prod;
+      if (!r->next) {
+        if (found) books_.erase(p);
+      }
+      else if (found) {
+        *p = r->next;
+      }
+      else {
+        books_.insert(p, r->next);
+      }
+    }
+    assign(v->products, old->products, n,
+           books_.empty() ? nullptr :
+           make(bucket{uint32_t(books_.size())}, books_));
+  }
+
+  ////////
+  /// same for the id shards the moves hit, in ingest order per shard
+  ////////
+  std::sort(moves_.begin(), moves_.end(),
+    [](const move& l, const move& r) {
+      return l.shard < r.shard || (l.shard == r.shard && l.seq < r.seq);
+    });
+  std::vector<move>::const_iterator m = moves_.begin();
+  while (m != moves_.end()) {
+    const uint32_t n = m->shard;
+    const shard* s = old->ids[n];
+    locations_.clear();
+    if (s) {
+      locations_.assign(s->begin(), s->end());
+      epoch_.defer(s);
+    }
+    for (; m != moves_.end() && m->shard == n; ++m) {
+      std::vector<location>::iterator l = std::lower_bound(
+        locations_.begin(), locations_.end(), m->at.id,
+        [](const location& e, int id) { return e.id < id; });
+      const bool found = l != locations_.end() && l->id == m->at.id;
+      if (m->erase) {
+        if (found) locations_.erase(l);
+      }
+      else if (found) {
+        *l = m->at;
+      }
+      else {
+        locations_.insert(l, m->at);
+      }
+    }
+    assign(v->ids, old->ids, n,
+           locations_.empty() ? nullptr :
+           make(shard{uint32_t(locations_.size())}, locations_));
+  }
+
+  current_.store(v);
+  epoch_.retire(old);
+}
+
+////////
+/// apply book
+/// - merges old's pages w/ the changed levels; a changed level's page
+///   is replaced [or dropped once empty]
+////////
+inline void
+book_snapshots::
+apply_book(const book* old,
+           std::vector<change>::const_iterator first,
+           std::vector<change>::const_iterator last) {
+
+  const int prod = first->level.prod;
+  const page* const* p = old ? old->begin() : nullptr;
+  const page* const* q = old ? old->end() : nullptr;
+  levels_.clear();
+  while (first != last) {
+    std::vector<change>::const_iterator e = first + 1;
+    while (e != last && !before(first->level, e->level)) {
+      ++e;
+    }
+    for (; p != q && before(key_of(**p), first->level); ++p) {
+      levels_.push_back(*p);
+    }
+    const page* level = nullptr;
+    if (p != q && !before(first->level, key_of(**p))) {
+      level = *p++;
+      epoch_.defer(level);
+    }
+    apply(level, first, e);
+    first = e;
+  }
+  levels_.insert(levels_.end(), p, q);
+  if (old) {
+    epoch_.defer(old);
+  }
+
+  uint32_t bids = 0;
+  while (bids < levels_.size() && levels_[bids]->side == 'B') {
+    ++bids;
+  }
+  rebooks_.push_back(rebook{
+    slot_of(prod), prod,
+    levels_.empty() ? nullptr :
+    make(book{prod, bids, uint32_t(levels_.size())}, levels_)});
+}
+
+////////
+/// apply
+////////
+inline void
+book_snapshots::
+apply(const page* old,
+      std::vector<change>::const_iterator first,
+      std::vector<change>::const_iterator last) {
+
+  const key& k = first->level;
+  scratch_.clear();
+  if (old) {
+    scratch_.assign(old->begin(), old->end());
+  }
+  for (; first != last; ++first) {
+    const change& c = *first;
+    if (c.type == change_t::add) {
+      scratch_.push_back(order_view{c.id, k.prod, k.side, c.quantity, k.price});
+      moves_.push_back(move{slot_of(c.id), c.seq,
+                            location{c.id, k.prod, k.side, k.price}, false});
+      continue;
+    }
+    order_views::iterator o = std::find_if(scratch_.begin(), scratch_.end(),
+      [&c](const order_view& e) { return e.id == c.id; });
+    if (o == scratch_.end()) {
+      continue;
+    }
+    if (c.type == change_t::update) {
+      o->quantity = c.quantity;
+    }
+    else {
+      scratch_.erase(o);
+      moves_.push_back(move{slot_of(c.id), c.seq,
+                            location{c.id, k.prod, k.side, k.price}, true});
+    }
+  }
+  if (!scratch_.empty()) {
+    levels_.push_back(
+      make(page{k.prod, k.side, k.price, uint32_t(scratch_.size())}, scratch_));
+  }
+}
+
+////////
+/// make
+////////
+template <class T, class E>
+inline const T*
+book_snapshots::
+make(const T& head,
+     const std::vector<E>& entries) {
+
+  void* m = ::operator new(sizeof(T) + entries.size() * sizeof(E));
+  T* p = new (m) T(head);
+  std::memcpy(static_cast<void*>(p + 1), entries.data(),
+              entries.size() * sizeof(E));
+  return p;
+}
+
+////////
+/// assign
+////////
+template <class T>
+inline void
+book_snapshots::
+assign(table<T>& next,
+       const table<T>& old,
+       uint32_t i,
+       const T* p) {
+
+  const block<T>*& b = next.blocks[i / fanout_];
+  if (!b || b == old.blocks[i / fanout_]) {
+    block<T>* copy = b ? new block<T>(*b) : new block<T>();
+    epoch_.defer(b);
+    b = copy;
+  }
+  const_cast<block<T>*>(b)->slots[i % fanout_] = p;
+}
+
+////////
+/// destroy (table)
+////////
+template <class T>
+inline void
+book_snapshots::
+destroy(const table<T>& t) {
+
+  for (size_t i = 0; i < fanout_; ++i) {
+    const block<T>* b = t.blocks[i];
+    for (size_t j = 0; b && j < fanout_; ++j) {
+      destroy(b->slots[j]);
+    }
+    delete b;
+  }
+}
+
+////////
+/// destroy (bucket)
+////////
+inline void
+book_snapshots::
+destroy(const bucket* b) {
+
+  if (!b) {
+    return;
+  }
+  for (const book* k : *b) {
+    for (const page* p : *k) {
+      delete p;
+    }
+    delete k;
+  }
+  delete b;
+}
+
+////////
+/// destroy (shard)
+////////
+inline void
+book_snapshots::
+destroy(const shard* s) {
+  delete s;
+}
+
+////////
+/// before
+////////
+inline bool
+book_snapshots::
+before(const key& l,
+       const key& r) {
+
+  if (l.prod != r.prod) return l.prod < r.prod;
+  if (l.side != r.side) return l.side < r.side;
+  return l.side == 'B' ? l.price > r.price : l.price < r.price;
+}
+
+////////
+/// rank of
+/// - signed fields flip their sign bit so they sort as unsigned; bid
+///   prices are inverted, best is highest
+////////
+inline book_snapshots::rank
+book_snapshots::
+rank_of(const change& c) {
+
+  uint32_t price = uint32_t(c.level.price) ^ 0x80000000u;
+  if (c.level.side == 'B') {
+    price = ~price;
+  }
+  return rank(
+    uint64_t(uint32_t(c.level.prod) ^ 0x80000000u) << 8 |
+      uint8_t(c.level.side),
+    uint64_t(price) << 32 | c.seq);
+}
+
+////////
+/// key of
+////////
+inline book_snapshots::key
+book_snapshots::
+key_of(const page& p) {
+  return key{p.prod, p.side, p.price};
+}
+
+////////
+/// slot of - low bits
+////////
+inline uint32_t
+book_snapshots::
+slot_of(int id) {
+  return uint32_t(id) & (slots_ - 1);
+}
+
+}
@@ -1,10 +1,14 @@
 #include <config.hpp>
 #include <iostream>
 
+EXP_CONFIG_KEY(foo_count, int, "foo.count", 1);
+
 int main() {
   support::config& c = support::config::instance();
   c.insert_or_assign<bool>("foo", true);
   bool b = c.find<bool>("foo");
   std::string s = c.as_string<bool>("foo");
   std::cout << s << std::endl;
+  c.insert_or_assign<int>("foo.count", 2);
+  std::cout << c.get(foo_count) << std::endl;
 }
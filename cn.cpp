@@ -0,0 +1,239 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <condition_variable>
+#include <unistd.h>
+#include <config.hpp>
+
+EXP_CONFIG_KEY(gen, int, "t.gen", -1);
+
+////////
+/// counts a failed expectation
+////////
+static int failed = 0;
+
+static void
+expect(bool ok,
+       const std::string& what) {
+  if (!ok) {
+    std::cout << "failed: " << what << std::endl;
+    ++failed;
+  }
+}
+
+////////
+/// writes generation g and renames it over file, as editors do
+////////
+static void
+write(const std::string& file,
+      int g) {
+
+  const std::string tmp = file + ".tmp";
+  {
+    std::ofstream out(tmp);
+    out << "{\"t\":{\"gen\":" << g << ",\"name\":\"gen" << g << "\"}}";
+  }
+  std::rename(tmp.c_str(), file.c_str());
+}
+
+////////
+/// delivery rules on one thread: key and prefix matches, equal values
+/// aren't changes, unsubscribe, a queued executor w/ a callback that
+/// writes back
+////////
+static void
+rules(support::config& c,
+      const std::string& file) {
+
+  std::vector<std::string> seen;
+  auto log = [&seen](const char* tag) {
+    return [&seen, tag](const support::config::change& ch) {
+      seen.push_back(std::string(tag) + ":" + ch.key);
+    };
+  };
+  int cached = c.get(gen);
+  const uint64_t key = c.subscribe("t.gen",
+    [&c, &cached](const support::config::change&) { cached = c.get(gen); });
+  const uint64_t pre = c.subscribe("t.", log("pre"),
+                                   support::config::match_t::prefix);
+  c.insert_or_assign<int>("t.gen", 20);
+  c.insert_or_assign<int>("t.gen", 20);
+  c.insert_or_assign<int>("u.other", 1);
+  c.insert_or_assign<std::string_view>("t.name", "x");
+  expect(cached == 20, "key subscriber sees its write");
+  expect(seen == std::vector<std::string>({ "pre:t.gen", "pre:t.name" }),
+         "prefix match, equal value and other keys not delivered");
+
+  {
+    std::ofstream out(file);
+    out << "{\"t\":{\"gen\":30,\"name\":\"x\",\"new\":true}}";
+  }
+  support::error_code err;
+  expect(c.init(err, file), "init");
+  expect(cached == 30, "key subscriber sees init");
+  std::sort(seen.begin() + 2, seen.end());
+  expect(seen == std::vector<std::string>({ "pre:t.gen", "pre:t.name",
+                                            "pre:t.gen", "pre:t.new" }),
+         "init delivers only what changed");
+  expect(c.unsubscribe(pre) && !c.unsubscribe(pre), "unsubscribe once");
+
+  std::deque<std::function<void()>> q;
+  c.set_executor([&q](std::function<void()> f) { q.push_back(std::move(f)); });
+  const uint64_t derived = c.subscribe("t.gen",
+    [&c](const support::config::change&) {
+      c.insert_or_assign<int>("t.derived", c.get(gen) * 2);
+    });
+  c.insert_or_assign<int>("t.gen", 40);
+  expect(cached == 30 && q.size() == 2, "executor holds deliveries");
+  while (!q.empty()) {
+    std::function<void()> f = q.front();
+    q.pop_front();
+    f();
+  }
+  expect(cached == 40 && c.find<int>("t.derived") == 80,
+         "queued deliveries run and write back");
+  expect(seen.size() == 4, "unsubscribed prefix stays quiet");
+  c.set_executor(support::config::executor());
+  c.unsubscribe(key);
+  c.unsubscribe(derived);
+}
+
+int main(int argc, char** argv) {
+
+  ////////
+  /// -r n -> reader threads during the stress run
+  /// -g n -> generations written while they read
+  /// -w n -> watcher poll interval in milliseconds
+  /// -d d -> work directory
+  ///
+  /// checks the delivery rules, then stresses subscriptions: a
+  /// subscriber refreshes a cached value on a worker thread executor
+  /// while the watcher reloads, readers read and another thread keeps
+  /// subscribing and unsubscribing. The cached value must end on the
+  /// last generation. Meant to be built w/ -fsanitize=thread too.
+  ////////
+  size_t readers = 3;
+  int generations = 40;
+  int interval = 5;
+  std::string dir = "/tmp";
+  int c;
+  while ((c = ::getopt(argc, argv, "r:g:w:d:")) != -1) {
+    if (c == 'r')      readers = ::atol(optarg);
+    else if (c == 'g') generations = ::atoi(optarg);
+    else if (c == 'w') interval = ::atoi(optarg);
+    else if (c == 'd') dir = optarg;
+    else {
+      std::cout << "Usage: <" << argv[0] << "> [-r readers] "
+                << "[-g generations] [-w interval] [-d dir]" << std::endl;
+      return -1;
+    }
+  }
+  support::config& config = support::config::instance();
+  const std::string file = dir + "/cn.json";
+  rules(config, file);
+
+  ////////
+  /// worker thread executor
+  ////////
+  std::mutex m;
+  std::condition_variable cv;
+  std::deque<std::function<void()>> q;
+  bool done = false;
+  std::thread worker([&m, &cv, &q, &done]() {
+    std::unique_lock<std::mutex> lock(m);
+    for (;;) {
+      cv.wait(lock, [&q, &done]() { return done || !q.empty(); });
+      if (q.empty()) {
+        return;
+      }
+      std::function<void()> f = std::move(q.front());
+      q.pop_front();
+      lock.unlock();
+      f();
+      lock.lock();
+    }
+  });
+  config.set_executor([&m, &cv, &q](std::function<void()> f) {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      q.push_back(std::move(f));
+    }
+    cv.notify_one();
+  });
+
+  std::atomic<int> cached(config.get(gen));
+  std::atomic<int> notes(0);
+  config.subscribe("t.gen",
+    [&config, &cached, &notes](const support::config::change&) {
+      ++notes;
+      cached = config.get(gen);
+    });
+
+  write(file, 0);
+  support::error_code err;
+  expect(config.init(err, file), "init before stress");
+  std::atomic<bool> stop(false);
+  std::atomic<long> reads(0), churn(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < readers; ++t) {
+    threads.emplace_back([&config, &stop, &reads]() {
+      long r = 0;
+      while (!stop.load()) {
+        r += config.get(gen) >= 0;
+        r += !config.as_string(gen).empty();
+      }
+      reads += r;
+    });
+  }
+  threads.emplace_back([&config, &stop, &churn]() {
+    long n = 0;
+    while (!stop.load()) {
+      const uint64_t id = config.subscribe("t.",
+        [](const support::config::change&) {},
+        support::config::match_t::prefix);
+      std::this_thread::yield();
+      n += config.unsubscribe(id);
+    }
+    churn += n;
+  });
+  std::atomic<int> reloads(0);
+  {
+    support::config::watcher w(
+      config, std::chrono::milliseconds(interval),
+      [&reloads](const support::error_code& e) { reloads += bool(e); });
+    for (int g = 1; g <= generations; ++g) {
+      write(file, g);
+      std::this_thread::sleep_for(std::chrono::milliseconds(3 * interval));
+    }
+  }
+  stop = true;
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  config.set_executor(support::config::executor());
+  {
+    std::lock_guard<std::mutex> lock(m);
+    done = true;
+  }
+  cv.notify_one();
+  worker.join();
+
+  expect(cached == generations, "cached value ends on the last generation");
+  expect(notes >= 1 && notes <= reloads + 1, "one delivery per change");
+  std::cout << "readers " << readers
+            << ", reads " << reads.load()
+            << ", reloads " << reloads.load()
+            << ", notes " << notes.load()
+            << ", subscribe churn " << churn.load()
+            << ", cached " << cached.load()
+            << (failed ? ", FAILED" : ", ok") << std::endl;
+  return failed ? 1 : 0;
+}
@@ -1,21 +1,121 @@
 #pragma once
 
-#include <map>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <type_traits>
 #include <fstream>
 #include <iterator>
+#include <charconv>
+#include <string_view>
+#include <cstdint>
+#include <cmath>
+#include <cerrno>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <optional>
+#include <functional>
+#include <memory>
+#include <condition_variable>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <ec.hpp>
+#include <ep.hpp>
+#include <fs.hpp>
 
 namespace support {
 
-class error_code {};
-
 /**-----------------------------------------------------------------------------
  * Configuration Holder
+ *
+ * - Values live in an immutable flat_store snapshot published through
+ *   an atomic pointer.
+ * - Readers [find, as_string, read] pin the current snapshot w/ an
+ *   epoch guard: no lock, never blocked by a writer. A thread takes
+ *   an epoch slot only while it is pinned.
+ * - get keeps a per thread reference to the last snapshot it read and
+ *   checks it against the published version: one load while nothing
+ *   was written, a pin only to pick up a new snapshot.
+ * - Writers [init, reload, insert_or_assign, declare] serialize on a
+ *   mutex, change a copy of the snapshot and swap it in; the old one
+ *   is deleted once no reader can still see it.
+ * - Views point into a snapshot. find<std::string_view> views are
+ *   valid until the next write; get views until the calling thread's
+ *   next get sees a newer snapshot. Across a concurrent write use
+ *   read(), std::string or as_string(handle).
+ * - Subscribers hear about entries a write added or changed, after
+ *   the write is published [see subscribe].
  */
 class config {
 public:
 
+  /**---------------------------------------------------------------------------
+   * Subscription Match [whole key or key prefix]
+   */
+  enum class match_t { key, prefix };
+
+  /**---------------------------------------------------------------------------
+   * Change [an entry added or given a new value by one publication]
+   */
+  struct change {
+    std::string         key;
+    flat_store::type_t  type;
+    uint64_t            version;   /// publication that made it
+  };
+
+  using callback = std::function<void(const change&)>;
+
+  /**---------------------------------------------------------------------------
+   * Executor [runs a delivery; e.g. posts it to a worker's queue]
+   */
+  using executor = std::function<void(std::function<void()>)>;
+
+  /**---------------------------------------------------------------------------
+   * File Watcher
+   *
+   * - Polls the init file's inode, size and mtime every interval and
+   *   calls reload when they change [editors that rename over the file
+   *   are caught by the inode].
+   * - report, if set, gets every reload's result on the watcher thread.
+   */
+  class watcher {
+  public:
+
+    watcher(config& c,
+            std::chrono::milliseconds interval,
+            std::function<void(const support::error_code&)> report = {});
+
+    /**-------------------------------------------------------------------------
+     * Destructor [stops and joins the thread]
+     */
+    ~watcher();
+
+    watcher(const watcher&) = delete;
+    watcher& operator=(const watcher&) = delete;
+
+  private:
+
+    std::string stamp() const;
+    void run();
+
+    config&                                          config_;
+    std::chrono::milliseconds                        interval_;
+    std::function<void(const support::error_code&)>  report_;
+    std::string                                      stamp_;
+    std::mutex                                       mutex_;
+    std::condition_variable                          cond_;
+    bool                                             stop_;
+    std::thread                                      thread_;
+  };
+
+  /**---------------------------------------------------------------------------
+   * Destructor [readers and watchers must be gone]
+   */
+  ~config();
+
   /**---------------------------------------------------------------------------
    * Instance
    *
@@ -28,20 +128,52 @@ public:
    *
    * - Opens json configuration file.
    * - Loads json configuration file into json string.
-   * - Uses [some kind of] json parser to parse json string.
-   * - Iterates over json children and adds values.
+   * - Parses the string in place [no tree] and inserts every value as
+   *   it is read; nested keys are joined with '.', array elements are
+   *   keyed by index, e.g. {"a": {"b": [1]}} -> "a.b.0".
+   * - true/false -> bool, integers in int range -> int, any other
+   *   number -> float, strings -> string; null is skipped.
+   * - Values before a syntax error stay applied; err has the line and
+   *   column of the error.
+   * - Values are loaded over a copy of the current snapshot, which is
+   *   then published in one swap.
+   * - With cache, a clean parse is also saved as a binary image at
+   *   <file>.cache [see flat_store::save]; later loads map the image
+   *   instead of parsing while it was built from the file as it is
+   *   now [same inode, size and mtime], and parse [and rewrite it]
+   *   otherwise. Into an empty config the mapped image is used as is.
    *
-   * @param[inout]  err   contains any errors
-   * @param[in]     file  json configuration file
-   * @return              true if successful
+   * @param[inout]  err    contains any errors
+   * @param[in]     file   json configuration file
+   * @param[in]     cache  use and maintain <file>.cache
+   * @return               true if successful
    */
-  bool init(support::error_code& err, const std::string& file = "config.json");
+  bool init(support::error_code& err,
+            const std::string& file = "config.json",
+            bool cache = false);
+
+  /**---------------------------------------------------------------------------
+   * Reload
+   *
+   * - Loads init's file again [w/ init's cache setting] over a copy
+   *   of the current snapshot.
+   * - Publishes only if the whole file parsed; on error readers keep
+   *   the old snapshot.
+   * - Keys missing from the file keep their values, so handles stay
+   *   valid.
+   *
+   * @param[inout]  err  contains any errors
+   * @return             true if successful
+   */
+  bool reload(support::error_code& err);
 
   /**---------------------------------------------------------------------------
    * Insert or Assign
    *
    * - Uses static if to determine template type.
-   * - Calls insert_or_assign on relevant map.
+   * - Inserts or overwrites k's T entry in the store.
+   * - T may be std::string_view for string values; k and v are copied
+   *   into the store, no temporary strings are built.
    * - Returns true if inserted, false if assigned.
    *
    * @param[in]  k  key
@@ -49,40 +181,176 @@ public:
    * @return        true if inserted, false if assigned
    */
   template <class T>
-  bool insert_or_assign(const std::string& k, const T& v);
+  bool insert_or_assign(std::string_view k, const T& v);
 
   /**---------------------------------------------------------------------------
    * Find
    *
    * - Uses static if to determine template type.
-   * - Tries to locate k in relevant map.
+   * - Tries to locate k's T entry in the store.
+   * - k may be a std::string, literal or view; nothing is allocated.
+   * - T = std::string_view returns a view of the stored string w/o a
+   *   copy [valid until the next write; see class notes].
    * - Returns value or default for T [throw exception??].
    *
    * @param[in]  k  key
    * @return        value if found or default for T
    */
   template <class T>
-  auto find(const std::string& s) const;
+  auto find(std::string_view k) const;
+
+  /**---------------------------------------------------------------------------
+   * Find with Default
+   *
+   * - Same as find but returns def when k has no T entry.
+   *
+   * @param[in]  k    key
+   * @param[in]  def  value if not found
+   * @return          value if found or def
+   */
+  template <class T>
+  T find(std::string_view k, const T& def) const;
 
   /**---------------------------------------------------------------------------
    * As String
    *
    * - Uses static if to determine template type.
-   * - Tries to locate k in relevant map.
+   * - Tries to locate k's T entry in the store.
    * - Returns value as string or '' if not found [throw exception??].
    *
    * @param[in]  k  key
    * @return        value if found or ''
    */
   template <class T>
-  std::string as_string(const std::string& k) const;
+  std::string as_string(std::string_view k) const;
+
+  /**---------------------------------------------------------------------------
+   * Key Handle
+   *
+   * - Stable index of a declared key's entry [see EXP_CONFIG_KEY].
+   * - Only declare makes one, so every handle names a key that exists
+   *   w/ type T.
+   */
+  template <class T>
+  class handle {
+  public:
+    using type = T;
+  private:
+    friend class config;
+    explicit handle(uint32_t index) : index_(index) {}
+    uint32_t  index_;
+  };
+
+  /**---------------------------------------------------------------------------
+   * Declare
+   *
+   * - Inserts k w/ def unless k already has a T entry.
+   * - hash is k's constexpr hash, computed where the key is declared.
+   * - Use EXP_CONFIG_KEY rather than calling this directly.
+   *
+   * @param[in]  k     key
+   * @param[in]  hash  flat_store::hash of T's type and k
+   * @param[in]  def   value if k isn't configured
+   * @return           handle to k's T entry
+   */
+  template <class T>
+  handle<T> declare(std::string_view k, uint64_t hash, const T& def);
+
+  /**---------------------------------------------------------------------------
+   * Get
+   *
+   * - One indexed load from the thread's cached snapshot; no pin,
+   *   no hashing, no string compare unless a write was published
+   *   since this thread's last get.
+   * - T must match the handle's type [get<bool>(int key) won't
+   *   compile]; string keys return views into the cached snapshot,
+   *   valid until this thread's next get after a write.
+   *
+   * @param[in]  h  declared key
+   * @return        current value
+   */
+  template <class T>
+  T get(handle<T> h) const;
+
+  /**---------------------------------------------------------------------------
+   * As String
+   *
+   * - Same as get but returns an owned copy [bool -> 'true'/'false'],
+   *   safe to keep across writes.
+   *
+   * @param[in]  h  declared key
+   * @return        current value as string
+   */
+  template <class T>
+  std::string as_string(handle<T> h) const;
+
+  /**---------------------------------------------------------------------------
+   * Read
+   *
+   * - Calls f(const flat_store&) on the current snapshot, pinned for
+   *   the whole call; several values read in f come from one load and
+   *   views stay valid until f returns.
+   *
+   * @param[in]  f  reader
+   * @return        f's result
+   */
+  template <class F>
+  auto read(F f) const;
+
+  /**---------------------------------------------------------------------------
+   * Subscribe
+   *
+   * - f is called once per entry w/ key name [match_t::key] or a key
+   *   starting w/ name [match_t::prefix, "" for all] that a write
+   *   [insert_or_assign, declare, init, reload] adds or changes;
+   *   assigning an equal value is not a change.
+   * - Deliveries go to the executor once the writing call has
+   *   published and released the write lock [inline on the writing
+   *   thread by default, the watcher's thread for reloads], in
+   *   publication order; f may read or write the config.
+   * - f reads the new value itself; by then a later write may have
+   *   replaced it [its own change follows].
+   *
+   * @param[in]  name   key or prefix
+   * @param[in]  f      callback
+   * @param[in]  match  whole key or prefix
+   * @return            id for unsubscribe
+   */
+  uint64_t subscribe(std::string_view name,
+                     callback f,
+                     match_t match = match_t::key);
+
+  /**---------------------------------------------------------------------------
+   * Unsubscribe
+   *
+   * - No new deliveries for id; ones already handed to the executor
+   *   still run.
+   *
+   * @param[in]  id  subscribe's id
+   * @return         true if id was subscribed
+   */
+  bool unsubscribe(uint64_t id);
+
+  /**---------------------------------------------------------------------------
+   * Set Executor
+   *
+   * @param[in]  e  runs deliveries; empty runs them inline
+   */
+  void set_executor(executor e);
 
   /**---------------------------------------------------------------------------
    * Serialize
    *
-   * - Builds json tree using each type map.
-   * - Opens config file for write [losing old contents].
-   * - Serializes json tree into file.
+   * - Does nothing if no write was published since the last serialize
+   *   [or since init loaded the file into an empty config].
+   * - Formats the current snapshot as json into one buffer, reserved
+   *   up front and kept between calls; dotted keys nest again, keys
+   *   0..n-1 become arrays, so init reads back the same entries.
+   * - A name w/ values of several types [or a value and members] is
+   *   written once per type; init reads duplicates back the same way.
+   * - Writes the buffer to <file>.tmp, fsyncs it, renames it over the
+   *   init file [config.json if none] and fsyncs the directory; a
+   *   crash leaves the old file or the new one, never a partial one.
    *
    * @param[in]  err  contains any errors
    * @return          true if successful, false otherwise
@@ -116,22 +384,159 @@ private:
    */
   config& operator=(config&&) = delete;
 
+  /**---------------------------------------------------------------------------
+   * JSON Loader [see init]
+   */
+  class loader;
+
+  /**---------------------------------------------------------------------------
+   * JSON Emitter [see serialize]
+   */
+  class emitter;
+
+  /**---------------------------------------------------------------------------
+   * Read Pin
+   *
+   * - Epoch guard of the calling thread; nests, only the outermost pin
+   *   claims a reader slot and announces, and it gives the slot back
+   *   on the way out [waits for one if all are taken].
+   */
+  class pin {
+  public:
+    pin(const config& c);
+    ~pin();
+  private:
+    struct state {
+      state(support::epoch& e) : epoch(e), depth(0) {}
+      support::epoch&                        epoch;
+      size_t                                 depth;
+      std::optional<support::epoch::reader>  reader;
+      std::optional<support::epoch::guard>   guard;
+    };
+    static state& local(const config& c);
+    state&  local_;
+  };
+
+  /**---------------------------------------------------------------------------
+   * Snapshot
+   *
+   * - A published store and its version; the store is shared w/ the
+   *   thread caches, so it lives until the last one moves on.
+   */
+  struct snapshot {
+    std::shared_ptr<const flat_store>  store;
+    uint64_t                           version;
+  };
+
+  /**---------------------------------------------------------------------------
+   * Cached [get's snapshot]
+   *
+   * - The calling thread's last snapshot, replaced under a pin once
+   *   a newer version was published.
+   *
+   * @return  snapshot store
+   */
+  const flat_store& cached() const;
+
+  /**---------------------------------------------------------------------------
+   * Value
+   *
+   * @param[in]  store  snapshot
+   * @param[in]  s      slot of T's type
+   * @return            s's value as T
+   */
+  template <class T>
+  static T value(const flat_store& store, const flat_store::slot& s);
+
+  /**---------------------------------------------------------------------------
+   * Load
+   *
+   * @param[inout]  err      contains any errors
+   * @param[in]     partial  publish values read before an error
+   * @return                 true if successful
+   */
+  bool load(support::error_code& err, bool partial);
+
+  /**---------------------------------------------------------------------------
+   * Publish [write_ held]
+   *
+   * - Queues deliveries for what changed if anyone subscribed.
+   *
+   * @param[in]  next  snapshot replacing the current one
+   */
+  void publish(const flat_store* next);
+
+  /**---------------------------------------------------------------------------
+   * Changes [write_ held]
+   *
+   * - Queues a delivery per subscriber for every entry of next that
+   *   old lacks or holds w/ another value.
+   */
+  void changes(const flat_store& old, const flat_store& next);
+
+  /**---------------------------------------------------------------------------
+   * Notify [write_ not held]
+   *
+   * - Hands queued deliveries to the executor.
+   */
+  void notify();
+
+  struct subscriber {
+    uint64_t     id;
+    std::string  name;
+    match_t      match;
+    callback     f;
+  };
+
+  using delivery = std::pair<std::shared_ptr<const subscriber>, change>;
+
+  using subscribers = std::vector<std::shared_ptr<const subscriber>>;
+
+  std::string                     file_;
+  bool                            cache_;
+
   ////////
-  /// is there a way to have a generic map?
+  /// every type in one table [see fs.hpp]; keys are type + name, so
+  /// a name may still hold one value per type
   ////////
-  using bool_map   = std::map<std::string, bool>;
-  using int_map    = std::map<std::string, int>;
-  using float_map  = std::map<std::string, float>;
-  using string_map = std::map<std::string, std::string>;
-
-  std::string  file_;
-  bool_map     bool_map_;
-  int_map      int_map_;
-  float_map    float_map_;
-  string_map   string_map_;
+  std::atomic<const snapshot*>    current_;
+  std::atomic<uint64_t>           published_;  /// current_'s version
+  mutable support::epoch          epoch_;
+  mutable std::mutex              write_;
+  uint64_t                        version_;    /// publications
+  uint64_t                        saved_;      /// version_ on file
+  std::string                     buffer_;     /// serialize output
+  uint64_t                        subscriber_id_;
+  subscribers                     subscribers_;
+  std::vector<delivery>           pending_;    /// published, not delivered
+  executor                        executor_;
 
 };
 
 }
 
+/**-----------------------------------------------------------------------------
+ * Declare Config Key
+ *
+ * - Declares id as a handle to config key name of type T, inserting def
+ *   unless the key is already configured.
+ * - name is hashed at compile time; T must be bool, int, float or
+ *   std::string_view.
+ * - Reading through an undeclared id or as another type doesn't compile.
+ *
+ *   EXP_CONFIG_KEY(trace_interval, int, "order_tracker.trace_interval", 0);
+ *   int i = support::config::instance().get(trace_interval);
+ */
+#define EXP_CONFIG_KEY(id, T, name, def)                                      \
+  static_assert(support::flat_store::type_of<T>() !=                          \
+                support::flat_store::type_t::none &&                          \
+                !std::is_same_v<T, std::string>,                              \
+                "config keys are bool, int, float or std::string_view");      \
+  inline const support::config::handle<T> id =                                \
+    support::config::instance().declare<T>(                                   \
+      name,                                                                   \
+      std::integral_constant<uint64_t, support::flat_store::hash(             \
+        support::flat_store::type_of<T>(), name)>::value,                     \
+      def)
+
 #include <config.ipp>
@@ -15,43 +15,702 @@ instance() {
  */
 inline
 config::
-config()
-{}
+config() :
+  file_   ("config.json"),
+  cache_  (false),
+  current_(new snapshot{std::make_shared<flat_store>(), 0}),
+  published_(0),
+  version_(0),
+  saved_  (0),
+  subscriber_id_(0) {
+}
 
 /**-----------------------------------------------------------------------------
- * Initialize
+ * Destructor
  */
-inline bool
+inline
 config::
-init(support::error_code& err,
-     const std::string& file) {
+~config() {
+  delete current_.load();
+}
 
-  ////////
-  /// open config file
-  ////////
-  file_ = file;
-  std::ifstream ifs(file_, std::ifstream::in);
+/**-----------------------------------------------------------------------------
+ * JSON Loader
+ *
+ * - Recursive descent over [begin, end); keys and string values are
+ *   views into the buffer unless they carry escapes.
+ * - key_ holds the dotted path of the value being read; members push
+ *   their name and pop it when done.
+ */
+class config::loader {
+public:
+
+  loader(flat_store& s, const char* begin, const char* end) :
+    store_ (s),
+    begin_ (begin),
+    p_     (begin),
+    end_   (end),
+    depth_ (0),
+    what_  (nullptr) {
+  }
 
-  if (!ifs) {
-    /// build up error code
+  /**---------------------------------------------------------------------------
+   * Run
+   *
+   * @param[inout]  err   contains the error w/ line and column
+   * @param[in]     file  for the error text
+   * @return              true if the whole buffer is one json value
+   */
+  bool run(support::error_code& err, const std::string& file) {
+
+    ws();
+    bool ok = value();
+    if (ok) {
+      ws();
+      if (p_ != end_) {
+        ok = fail("end of input");
+      }
+    }
+    if (!ok) {
+      ////////
+      /// line and column are only worked out on failure
+      ////////
+      size_t line = 1, column = 1;
+      for (const char* q = begin_; q < p_; ++q) {
+        if (*q == '\n') {
+          ++line;
+          column = 1;
+        }
+        else {
+          ++column;
+        }
+      }
+      err = support::error_code(-1, "Bad config file: <:" + file +
+                                ">, line " + std::to_string(line) +
+                                ", column " + std::to_string(column) +
+                                ": expected " + what_);
+    }
+    return ok;
+  }
+
+private:
+
+  static const size_t max_depth_ = 64;
+
+  bool fail(const char* what) {
+    what_ = what;
     return false;
   }
 
-  ////////
-  /// slurp contents into string
-  ////////
-  std::string contents(std::istreambuf_iterator<char>(ifs),
-                       std::istreambuf_iterator<char>());
-  
-  ////////
-  /// parse into json root
-  ////////
+  void ws() {
+    while (p_ != end_ &&
+           (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r')) {
+      ++p_;
+    }
+  }
 
-  ////////
-  /// iterate over children and insert_or_assign into maps
-  ////////
+  bool literal(const char* word) {
+    const size_t n = std::char_traits<char>::length(word);
+    if (size_t(end_ - p_) < n || std::char_traits<char>::compare(p_, word, n)) {
+      return fail(word);
+    }
+    p_ += n;
+    return true;
+  }
 
-  return true;
+  bool value() {
+
+    if (p_ == end_) {
+      return fail("a value");
+    }
+    switch (*p_) {
+    case '{':
+      return object();
+    case '[':
+      return array();
+    case '"': {
+      std::string_view v;
+      if (!string(v)) {
+        return false;
+      }
+      store_.assign<std::string_view>(key_, v);
+      return true;
+    }
+    case 't':
+      if (!literal("true")) return false;
+      store_.assign<bool>(key_, true);
+      return true;
+    case 'f':
+      if (!literal("false")) return false;
+      store_.assign<bool>(key_, false);
+      return true;
+    case 'n':
+      return literal("null");
+    default:
+      return number();
+    }
+  }
+
+  bool object() {
+
+    if (++depth_ > max_depth_) {
+      return fail("less nesting");
+    }
+    ++p_;
+    ws();
+    if (p_ != end_ && *p_ == '}') {
+      ++p_;
+      --depth_;
+      return true;
+    }
+    const size_t mark = key_.size();
+    for (;;) {
+      std::string_view k;
+      if (p_ == end_ || *p_ != '"') {
+        return fail("a member name");
+      }
+      if (!string(k)) {
+        return false;
+      }
+      ws();
+      if (p_ == end_ || *p_ != ':') {
+        return fail("':'");
+      }
+      ++p_;
+      ws();
+      if (mark) {
+        key_ += '.';
+      }
+      key_ += k;
+      if (!value()) {
+        return false;
+      }
+      key_.resize(mark);
+      ws();
+      if (p_ != end_ && *p_ == ',') {
+        ++p_;
+        ws();
+        continue;
+      }
+      if (p_ != end_ && *p_ == '}') {
+        ++p_;
+        --depth_;
+        return true;
+      }
+      return fail("',' or '}'");
+    }
+  }
+
+  bool array() {
+
+    if (++depth_ > max_depth_) {
+      return fail("less nesting");
+    }
+    ++p_;
+    ws();
+    if (p_ != end_ && *p_ == ']') {
+      ++p_;
+      --depth_;
+      return true;
+    }
+    const size_t mark = key_.size();
+    for (size_t i = 0;; ++i) {
+      if (mark) {
+        key_ += '.';
+      }
+      key_ += std::to_string(i);
+      if (!value()) {
+        return false;
+      }
+      key_.resize(mark);
+      ws();
+      if (p_ != end_ && *p_ == ',') {
+        ++p_;
+        ws();
+        continue;
+      }
+      if (p_ != end_ && *p_ == ']') {
+        ++p_;
+        --depth_;
+        return true;
+      }
+      return fail("',' or ']'");
+    }
+  }
+
+  /**---------------------------------------------------------------------------
+   * String
+   *
+   * - out views the buffer when there are no escapes, scratch_ otherwise.
+   */
+  bool string(std::string_view& out) {
+
+    const char* b = ++p_;
+    while (p_ != end_ && *p_ != '"' && *p_ != '\\') {
+      if (static_cast<unsigned char>(*p_) < 0x20) {
+        return fail("no control characters in a string");
+      }
+      ++p_;
+    }
+    if (p_ == end_) {
+      return fail("'\"'");
+    }
+    if (*p_ == '"') {
+      out = std::string_view(b, p_ - b);
+      ++p_;
+      return true;
+    }
+    scratch_.assign(b, p_);
+    while (p_ != end_ && *p_ != '"') {
+      if (static_cast<unsigned char>(*p_) < 0x20) {
+        return fail("no control characters in a string");
+      }
+      if (*p_ != '\\') {
+        scratch_ += *p_++;
+        continue;
+      }
+      if (++p_ == end_) {
+        break;
+      }
+      switch (*p_++) {
+      case '"':  scratch_ += '"';  break;
+      case '\\': scratch_ += '\\'; break;
+      case '/':  scratch_ += '/';  break;
+      case 'b':  scratch_ += '\b'; break;
+      case 'f':  scratch_ += '\f'; break;
+      case 'n':  scratch_ += '\n'; break;
+      case 'r':  scratch_ += '\r'; break;
+      case 't':  scratch_ += '\t'; break;
+      case 'u': {
+        uint32_t c;
+        if (!hex4(c)) {
+          return false;
+        }
+        if (c >= 0xd800 && c < 0xdc00) {
+          uint32_t d;
+          if (end_ - p_ < 2 || p_[0] != '\\' || p_[1] != 'u') {
+            return fail("a low surrogate");
+          }
+          p_ += 2;
+          if (!hex4(d)) {
+            return false;
+          }
+          if (d < 0xdc00 || d >= 0xe000) {
+            return fail("a low surrogate");
+          }
+          c = 0x10000 + ((c - 0xd800) << 10) + (d - 0xdc00);
+        }
+        utf8(c);
+        break;
+      }
+      default:
+        --p_;
+        return fail("a valid escape");
+      }
+    }
+    if (p_ == end_) {
+      return fail("'\"'");
+    }
+    ++p_;
+    out = scratch_;
+    return true;
+  }
+
+  bool hex4(uint32_t& c) {
+    c = 0;
+    for (int i = 0; i < 4; ++i, ++p_) {
+      if (p_ == end_) {
+        return fail("4 hex digits");
+      }
+      const char h = *p_;
+      c <<= 4;
+      if      (h >= '0' && h <= '9') c |= h - '0';
+      else if (h >= 'a' && h <= 'f') c |= h - 'a' + 10;
+      else if (h >= 'A' && h <= 'F') c |= h - 'A' + 10;
+      else return fail("4 hex digits");
+    }
+    return true;
+  }
+
+  void utf8(uint32_t c) {
+    if (c < 0x80) {
+      scratch_ += char(c);
+    }
+    else if (c < 0x800) {
+      scratch_ += char(0xc0 | (c >> 6));
+      scratch_ += char(0x80 | (c & 0x3f));
+    }
+    else if (c < 0x10000) {
+      scratch_ += char(0xe0 | (c >> 12));
+      scratch_ += char(0x80 | ((c >> 6) & 0x3f));
+      scratch_ += char(0x80 | (c & 0x3f));
+    }
+    else {
+      scratch_ += char(0xf0 | (c >> 18));
+      scratch_ += char(0x80 | ((c >> 12) & 0x3f));
+      scratch_ += char(0x80 | ((c >> 6) & 0x3f));
+      scratch_ += char(0x80 | (c & 0x3f));
+    }
+  }
+
+  /**---------------------------------------------------------------------------
+   * Number
+   *
+   * - json grammar checked by hand, converted w/ from_chars.
+   */
+  bool number() {
+
+    const char* b = p_;
+    bool integral = true;
+    if (p_ != end_ && *p_ == '-') {
+      ++p_;
+    }
+    if (p_ == end_ || *p_ < '0' || *p_ > '9') {
+      p_ = b;
+      return fail("a value");
+    }
+    if (*p_ == '0') {
+      ++p_;
+    }
+    else {
+      while (p_ != end_ && *p_ >= '0' && *p_ <= '9') ++p_;
+    }
+    if (p_ != end_ && *p_ == '.') {
+      integral = false;
+      if (++p_ == end_ || *p_ < '0' || *p_ > '9') {
+        return fail("a digit");
+      }
+      while (p_ != end_ && *p_ >= '0' && *p_ <= '9') ++p_;
+    }
+    if (p_ != end_ && (*p_ == 'e' || *p_ == 'E')) {
+      integral = false;
+      if (++p_ != end_ && (*p_ == '+' || *p_ == '-')) {
+        ++p_;
+      }
+      if (p_ == end_ || *p_ < '0' || *p_ > '9') {
+        return fail("a digit");
+      }
+      while (p_ != end_ && *p_ >= '0' && *p_ <= '9') ++p_;
+    }
+    if (integral) {
+      int i;
+      const std::from_chars_result r = std::from_chars(b, p_, i);
+      if (r.ec == std::errc()) {
+        store_.assign<int>(key_, i);
+        return true;
+      }
+    }
+    float f;
+    const std::from_chars_result r = std::from_chars(b, p_, f);
+    if (r.ec != std::errc()) {
+      p_ = b;
+      return fail("a number in float range");
+    }
+    store_.assign<float>(key_, f);
+    return true;
+  }
+
+  flat_store&  store_;
+  const char*  begin_;
+  const char*  p_;
+  const char*  end_;
+  size_t       depth_;
+  const char*  what_;
+  std::string  key_;
+  std::string  scratch_;
+};
+
+/**-----------------------------------------------------------------------------
+ * JSON Emitter
+ *
+ * - Sorts the snapshot's entries by key, '.' before any other char, so
+ *   every name's value and members sit together.
+ * - Each name at a level is a group; a group holds the name's values
+ *   [one per type] then its members' entries.
+ * - A level whose groups are exactly 0..n-1, each one value or only
+ *   members, is written as an array; the root is always an object.
+ */
+class config::emitter {
+public:
+
+  emitter(const flat_store& s, std::string& out) :
+    store_(s),
+    out_  (out) {
+  }
+
+  /**---------------------------------------------------------------------------
+   * Run
+   *
+   * - Replaces out w/ the snapshot's json.
+   */
+  void run() {
+
+    entries_.clear();
+    entries_.reserve(store_.size());
+    size_t bytes = 16;
+    store_.for_each([this, &bytes](const flat_store::slot& s) {
+      entries_.push_back(&s);
+      bytes += s.key_size + 16;
+      if (s.type == flat_store::type_t::string) {
+        bytes += store_.text(s).size();
+      }
+    });
+    std::sort(entries_.begin(), entries_.end(),
+              [this](const flat_store::slot* l, const flat_store::slot* r) {
+      const std::string_view a = store_.key(*l), b = store_.key(*r);
+      const size_t n = std::min(a.size(), b.size());
+      for (size_t i = 0; i < n; ++i) {
+        if (a[i] != b[i]) {
+          return rank(a[i]) < rank(b[i]);
+        }
+      }
+      return a.size() != b.size() ? a.size() < b.size() : l->type < r->type;
+    });
+
+    ////////
+    /// one allocation in the common case [escapes and nesting aside]
+    ////////
+    out_.clear();
+    out_.reserve(bytes + bytes / 2);
+    level(0, entries_.size(), 0, 0, false);
+    out_ += '\n';
+  }
+
+private:
+
+  /**---------------------------------------------------------------------------
+   * Group [one name at a level]
+   */
+  struct group {
+    std::string_view  name;
+    size_t            lo;      /// first entry
+    size_t            mid;     /// first member entry [values before]
+    size_t            hi;
+  };
+
+  static int rank(char c) {
+    return c == '.' ? -1 : static_cast<unsigned char>(c);
+  }
+
+  /**---------------------------------------------------------------------------
+   * Level
+   *
+   * - Writes entries [lo, hi), which share offset bytes of key prefix,
+   *   as an object or array.
+   */
+  void level(size_t lo, size_t hi, size_t offset, size_t indent, bool array) {
+
+    std::vector<group> groups;
+    for (size_t i = lo; i < hi;) {
+      const std::string_view key = store_.key(*entries_[i]);
+      const size_t dot = key.find('.', offset);
+      const std::string_view name =
+        key.substr(offset, dot == key.npos ? key.npos : dot - offset);
+      group g{name, i, i, i};
+      for (; g.hi < hi; ++g.hi) {
+        const std::string_view k = store_.key(*entries_[g.hi]);
+        const size_t end = offset + name.size();
+        if (k.size() < end || k.compare(offset, name.size(), name) ||
+            (k.size() > end && k[end] != '.')) {
+          break;
+        }
+        if (k.size() == end) {
+          g.mid = g.hi + 1;
+        }
+      }
+      groups.push_back(g);
+      i = g.hi;
+    }
+
+    if (array && indexes(groups)) {
+      out_ += '[';
+      for (size_t i = 0; i < groups.size(); ++i) {
+        out_ += i ? ",\n" : "\n";
+        pad(indent + 1);
+        const group& g = groups[i];
+        if (g.mid > g.lo) {
+          value(*entries_[g.lo]);
+        }
+        else {
+          nested(g, offset, indent + 1);
+        }
+      }
+      out_ += '\n';
+      pad(indent);
+      out_ += ']';
+      return;
+    }
+
+    out_ += '{';
+    bool first = true;
+    for (const group& g : groups) {
+      for (size_t i = g.lo; i < g.mid; ++i) {
+        member(g.name, indent + 1, first);
+        value(*entries_[i]);
+      }
+      if (g.hi > g.mid) {
+        member(g.name, indent + 1, first);
+        nested(g, offset, indent + 1);
+      }
+    }
+    if (!first) {
+      out_ += '\n';
+      pad(indent);
+    }
+    out_ += '}';
+  }
+
+  /**---------------------------------------------------------------------------
+   * Nested [a group's members]
+   */
+  void nested(const group& g, size_t offset, size_t indent) {
+    level(g.mid, g.hi, offset + g.name.size() + 1, indent, true);
+  }
+
+  /**---------------------------------------------------------------------------
+   * Indexes
+   *
+   * - true if groups are named 0..n-1 and each is one value or only
+   *   members; sorts them by index if so.
+   */
+  static bool indexes(std::vector<group>& groups) {
+
+    std::vector<group> sorted(groups.size());
+    for (const group& g : groups) {
+      size_t i = 0;
+      const char* end = g.name.data() + g.name.size();
+      auto r = std::from_chars(g.name.data(), end, i);
+      if (g.name.empty() || r.ptr != end || r.ec != std::errc() ||
+          (g.name.size() > 1 && g.name[0] == '0') ||
+          i >= groups.size() || sorted[i].hi ||
+          (g.mid > g.lo && (g.mid - g.lo > 1 || g.hi > g.mid))) {
+        return false;
+      }
+      sorted[i] = g;
+    }
+    groups.swap(sorted);
+    return true;
+  }
+
+  void member(std::string_view name, size_t indent, bool& first) {
+    out_ += first ? "\n" : ",\n";
+    first = false;
+    pad(indent);
+    string(name);
+    out_ += ": ";
+  }
+
+  void pad(size_t indent) {
+    out_.append(indent * 2, ' ');
+  }
+
+  /**---------------------------------------------------------------------------
+   * Value
+   *
+   * - Floats always carry a '.' or exponent so they load as floats;
+   *   non finite ones become null [skipped on load].
+   */
+  void value(const flat_store::slot& s) {
+
+    char buf[32];
+    switch (s.type) {
+    case flat_store::type_t::boolean:
+      out_ += store_.boolean(s) ? "true" : "false";
+      break;
+    case flat_store::type_t::integer: {
+      auto r = std::to_chars(buf, buf + sizeof(buf), store_.integer(s));
+      out_.append(buf, r.ptr);
+      break;
+    }
+    case flat_store::type_t::real: {
+      const float f = store_.real(s);
+      if (!std::isfinite(f)) {
+        out_ += "null";
+        break;
+      }
+      auto r = std::to_chars(buf, buf + sizeof(buf), f);
+      out_.append(buf, r.ptr);
+      if (std::string_view(buf, r.ptr - buf).find_first_of(".e") ==
+          std::string_view::npos) {
+        out_ += ".0";
+      }
+      break;
+    }
+    case flat_store::type_t::string:
+      string(store_.text(s));
+      break;
+    default:
+      out_ += "null";
+      break;
+    }
+  }
+
+  void string(std::string_view v) {
+
+    static const char hex[] = "0123456789abcdef";
+    out_ += '"';
+    for (const char c : v) {
+      switch (c) {
+      case '"':  out_ += "\\\""; break;
+      case '\\': out_ += "\\\\"; break;
+      case '\b': out_ += "\\b"; break;
+      case '\f': out_ += "\\f"; break;
+      case '\n': out_ += "\\n"; break;
+      case '\r': out_ += "\\r"; break;
+      case '\t': out_ += "\\t"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          out_ += "\\u00";
+          out_ += hex[c >> 4];
+          out_ += hex[c & 15];
+        }
+        else {
+          out_ += c;
+        }
+      }
+    }
+    out_ += '"';
+  }
+
+  const flat_store&                     store_;
+  std::string&                          out_;
+  std::vector<const flat_store::slot*>  entries_;
+};
+
+/**-----------------------------------------------------------------------------
+ * Initialize
+ */
+inline bool
+config::
+init(support::error_code& err,
+     const std::string& file,
+     bool cache) {
+
+  bool ok;
+  {
+    std::lock_guard<std::mutex> lock(write_);
+    file_  = file;
+    cache_ = cache;
+    ok = load(err, true);
+  }
+  notify();
+  return ok;
+}
+
+/**-----------------------------------------------------------------------------
+ * Reload
+ */
+inline bool
+config::
+reload(support::error_code& err) {
+
+  bool ok;
+  {
+    std::lock_guard<std::mutex> lock(write_);
+    ok = load(err, false);
+  }
+  notify();
+  return ok;
 }
 
 /**-----------------------------------------------------------------------------
@@ -60,20 +719,19 @@ init(support::error_code& err,
 template <class T>
 inline bool
 config::
-insert_or_assign(const std::string& k,
+insert_or_assign(std::string_view k,
                  const T& v) {
 
-  if constexpr (std::is_same_v<T, bool>) {
-    return bool_map_.insert_or_assign(k, v).second;
-  }
-  else if constexpr (std::is_same_v<T, int>) {
-    return int_map_.insert_or_assign(k, v).second;
-  }
-  else if constexpr (std::is_same_v<T, int>) {
-    return float_map_.insert_or_assign(k, v).second;
-  }
-  else if constexpr (std::is_same_v<T, std::string>) {
-    return string_map_.insert_or_assign(k, v).second;
+  if constexpr (flat_store::type_of<T>() != flat_store::type_t::none) {
+    bool inserted;
+    {
+      std::lock_guard<std::mutex> lock(write_);
+      flat_store* next = new flat_store(*current_.load()->store);
+      inserted = next->assign(k, v);
+      publish(next);
+    }
+    notify();
+    return inserted;
   }
   return false;
 }
@@ -84,72 +742,576 @@ insert_or_assign(const std::string& k,
 template <class T>
 inline auto
 config::
-find(const std::string& k) const {
+find(std::string_view k) const {
 
+  if constexpr (flat_store::type_of<T>() != flat_store::type_t::none) {
+    return read([k](const flat_store& s) {
+      const flat_store::slot* p = s.find(flat_store::type_of<T>(), k);
+      return p ? value<T>(s, *p) : T();
+    });
+  }
+}
+
+/**-----------------------------------------------------------------------------
+ * Find with Default
+ */
+template <class T>
+inline T
+config::
+find(std::string_view k,
+     const T& def) const {
+
+  if constexpr (flat_store::type_of<T>() != flat_store::type_t::none) {
+    return read([k, &def](const flat_store& s) {
+      const flat_store::slot* p = s.find(flat_store::type_of<T>(), k);
+      return p ? value<T>(s, *p) : def;
+    });
+  }
+  return def;
+}
+
+/**-----------------------------------------------------------------------------
+ * As String
+ */
+template <class T>
+inline std::string
+config::
+as_string(std::string_view k) const {
+
+  if constexpr (flat_store::type_of<T>() != flat_store::type_t::none) {
+    return read([k](const flat_store& s) {
+      const flat_store::slot* p = s.find(flat_store::type_of<T>(), k);
+      if (!p) {
+        return std::string();
+      }
+      if constexpr (std::is_same_v<T, bool>) {
+        return std::string(s.boolean(*p) ? "true" : "false");
+      }
+      else if constexpr (flat_store::type_of<T>() ==
+                         flat_store::type_t::string) {
+        return std::string(s.text(*p));
+      }
+      else {
+        return std::to_string(value<T>(s, *p));
+      }
+    });
+  }
+  else {
+    return std::string();
+  }
+}
+
+/**-----------------------------------------------------------------------------
+ * Declare
+ */
+template <class T>
+inline config::handle<T>
+config::
+declare(std::string_view k,
+        uint64_t hash,
+        const T& def) {
+
+  constexpr flat_store::type_t type = flat_store::type_of<T>();
+  uint32_t index;
+  {
+    std::lock_guard<std::mutex> lock(write_);
+    const flat_store::slot* p = current_.load()->store->find(type, k, hash);
+    if (!p) {
+      flat_store* next = new flat_store(*current_.load()->store);
+      next->assign(k, def);
+      p = next->find(type, k, hash);
+      publish(next);
+    }
+    index = p->index;
+  }
+  notify();
+  return handle<T>(index);
+}
+
+/**-----------------------------------------------------------------------------
+ * Get
+ */
+template <class T>
+inline T
+config::
+get(handle<T> h) const {
+
+  const flat_store& s = cached();
+  const flat_store::value& v = s.at(h.index_);
   if constexpr (std::is_same_v<T, bool>) {
-    auto p = bool_map_.find(k);
-    return p == bool_map_.end() ? T() : p->second;
+    return v.boolean;
   }
   else if constexpr (std::is_same_v<T, int>) {
-    auto p = int_map_.find(k);
-    return p == int_map_.end() ? T() : p->second;
+    return v.integer;
   }
   else if constexpr (std::is_same_v<T, float>) {
-    auto p = float_map_.find(k);
-    return p == float_map_.end() ? T() : p->second;
+    return v.real;
   }
-  else if constexpr (std::is_same_v<T, std::string>) {
-    auto p = string_map_.find(k);
-    return p == string_map_.end() ? T() : p->second;
+  else {
+    return s.text(v);
   }
 }
 
 /**-----------------------------------------------------------------------------
- * As String
+ * As String [handle]
  */
 template <class T>
 inline std::string
 config::
-as_string(const std::string& k) const {
+as_string(handle<T> h) const {
 
-  static const std::string s;
+  if constexpr (std::is_same_v<T, bool>) {
+    return get(h) ? "true" : "false";
+  }
+  else if constexpr (flat_store::type_of<T>() == flat_store::type_t::string) {
+    return std::string(get(h));
+  }
+  else {
+    return std::to_string(get(h));
+  }
+}
+
+/**-----------------------------------------------------------------------------
+ * Read
+ */
+template <class F>
+inline auto
+config::
+read(F f) const {
+  pin p(*this);
+  return f(*current_.load(std::memory_order_acquire)->store);
+}
+
+/**-----------------------------------------------------------------------------
+ * Cached
+ *
+ * - The thread's reference keeps its store alive w/o a pin; the pin
+ *   only covers reading the snapshot that holds the new one.
+ */
+inline const flat_store&
+config::
+cached() const {
+
+  struct cache {
+    std::shared_ptr<const flat_store>  store;
+    uint64_t                           version;
+  };
+  static thread_local cache c{nullptr, 0};
+  if (!c.store || c.version != published_.load(std::memory_order_acquire)) {
+    pin p(*this);
+    const snapshot* s = current_.load(std::memory_order_acquire);
+    c.store   = s->store;
+    c.version = s->version;
+  }
+  return *c.store;
+}
+
+/**-----------------------------------------------------------------------------
+ * Value
+ */
+template <class T>
+inline T
+config::
+value(const flat_store& store,
+      const flat_store::slot& s) {
 
   if constexpr (std::is_same_v<T, bool>) {
-    auto p = bool_map_.find(k);
-    return p == bool_map_.end() ? s : p->second ? "true" : "false";
+    return store.boolean(s);
   }
   else if constexpr (std::is_same_v<T, int>) {
-    auto p = int_map_.find(k);
-    return p == int_map_.end() ? s : std::to_string(p->second);
+    return store.integer(s);
   }
   else if constexpr (std::is_same_v<T, float>) {
-    auto p = float_map_.find(k);
-    return p == float_map_.end() ? s : std::to_string(p->second);
+    return store.real(s);
   }
-  else if constexpr (std::is_same_v<T, std::string>) {
-    auto p = string_map_.find(k);
-    return p == string_map_.end() ? s : p->second;
+  else {
+    return T(store.text(s));
   }
 }
 
 /**-----------------------------------------------------------------------------
- * Serialize
+ * Load
  */
 inline bool
 config::
-serialize(support::error_code& err) {
+load(support::error_code& err,
+     bool partial) {
 
   ////////
-  /// populate json root w/ all the type maps
+  /// stamp of the file as it is now; an image must carry the same
   ////////
+  uint64_t source = 0;
+  struct stat st;
+  if (cache_ && !::stat(file_.c_str(), &st)) {
+    const std::string s = std::to_string(st.st_ino) + ":" +
+                          std::to_string(st.st_size) + ":" +
+                          std::to_string(st.st_mtim.tv_sec) + "." +
+                          std::to_string(st.st_mtim.tv_nsec);
+    source = flat_store::hash(flat_store::type_t::none, s);
+  }
+  const std::string image = file_ + ".cache";
+
+  flat_store* loaded = new flat_store();
+  support::error_code ignored;
+  bool ok = source && loaded->map(ignored, image, source);
+  if (!ok) {
+
+    ////////
+    /// open config file
+    ////////
+    std::ifstream ifs(file_, std::ifstream::in | std::ifstream::binary);
+
+    if (!ifs) {
+      delete loaded;
+      err = support::error_code(-1, "Bad config file: <:" + file_ + ">");
+      return false;
+    }
+
+    ////////
+    /// slurp contents into string; one read when the size is known
+    ////////
+    std::string contents;
+    ifs.seekg(0, std::ios::end);
+    const std::streamoff size = ifs.tellg();
+    ifs.seekg(0, std::ios::beg);
+    if (size > 0) {
+      contents.resize(size);
+      ifs.read(&contents[0], size);
+      contents.resize(ifs.gcount());
+    }
+    else {
+      contents.assign(std::istreambuf_iterator<char>(ifs),
+                      std::istreambuf_iterator<char>());
+    }
+
+    ////////
+    /// parse in place; only a clean parse is worth caching [a failed
+    /// image write just means parsing again next time]
+    ////////
+    loader l(*loaded, contents.data(), contents.data() + contents.size());
+    ok = l.run(err, file_);
+    if (ok && source) {
+      loaded->save(ignored, image, source);
+    }
+    if (!ok && !partial) {
+      delete loaded;
+      return false;
+    }
+  }
 
   ////////
-  /// open config file for writing
+  /// over a copy of the current snapshot, so entries [and handles]
+  /// survive and readers never see a half load
   ////////
+  const flat_store* current =
+    current_.load(std::memory_order_relaxed)->store.get();
+  const bool clean = ok && !current->size() && saved_ == version_;
+  if (current->size()) {
+    flat_store* next = new flat_store(*current);
+    next->merge(*loaded);
+    delete loaded;
+    loaded = next;
+  }
+  publish(loaded);
 
   ////////
-  /// stream json root into config file stream
+  /// the file already holds exactly this snapshot
   ////////
+  if (clean) {
+    saved_ = version_;
+  }
+  return ok;
+}
+
+/**-----------------------------------------------------------------------------
+ * Publish
+ */
+inline void
+config::
+publish(const flat_store* next) {
+  const snapshot* old = current_.load(std::memory_order_relaxed);
+  ++version_;
+  if (!subscribers_.empty()) {
+    changes(*old->store, *next);
+  }
+  current_.store(new snapshot{std::shared_ptr<const flat_store>(next),
+                              version_});
+  published_.store(version_, std::memory_order_release);
+  epoch_.retire(old);
+}
+
+/**-----------------------------------------------------------------------------
+ * Subscribe
+ */
+inline uint64_t
+config::
+subscribe(std::string_view name,
+          callback f,
+          match_t match) {
+
+  std::lock_guard<std::mutex> lock(write_);
+  subscribers_.push_back(std::make_shared<const subscriber>(
+    subscriber{++subscriber_id_, std::string(name), match, std::move(f)}));
+  return subscriber_id_;
+}
+
+/**-----------------------------------------------------------------------------
+ * Unsubscribe
+ */
+inline bool
+config::
+unsubscribe(uint64_t id) {
+
+  std::lock_guard<std::mutex> lock(write_);
+  for (size_t i = 0; i < subscribers_.size(); ++i) {
+    if (subscribers_[i]->id == id) {
+      subscribers_.erase(subscribers_.begin() + i);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**-----------------------------------------------------------------------------
+ * Set Executor
+ */
+inline void
+config::
+set_executor(executor e) {
+
+  std::lock_guard<std::mutex> lock(write_);
+  executor_ = std::move(e);
+}
+
+/**-----------------------------------------------------------------------------
+ * Changes
+ */
+inline void
+config::
+changes(const flat_store& old,
+        const flat_store& next) {
+
+  next.for_each([&](const flat_store::slot& s) {
+    const std::string_view key = next.key(s);
+    const flat_store::slot* o = old.find(s.type, key, s.hash);
+    if (o) {
+      const flat_store::value& a = old.at(o->index);
+      const flat_store::value& b = next.at(s.index);
+      const bool same = s.type == flat_store::type_t::string ?
+                        old.text(a) == next.text(b) :
+                        !std::memcmp(&a, &b, sizeof(uint32_t));
+      if (same) {
+        return;
+      }
+    }
+    for (const auto& sub : subscribers_) {
+      if (sub->match == match_t::key ? key == sub->name :
+          key.substr(0, sub->name.size()) == sub->name) {
+        pending_.push_back({sub, change{std::string(key), s.type, version_}});
+      }
+    }
+  });
+}
+
+/**-----------------------------------------------------------------------------
+ * Notify
+ */
+inline void
+config::
+notify() {
+
+  std::vector<delivery> pending;
+  executor e;
+  {
+    std::lock_guard<std::mutex> lock(write_);
+    if (pending_.empty()) {
+      return;
+    }
+    pending.swap(pending_);
+    e = executor_;
+  }
+  for (delivery& d : pending) {
+    if (e) {
+      e([d]() { d.first->f(d.second); });
+    }
+    else {
+      d.first->f(d.second);
+    }
+  }
+}
+
+/**-----------------------------------------------------------------------------
+ * Pin Constructor
+ */
+inline
+config::
+pin::
+pin(const config& c) :
+  local_(local(c)) {
+  if (!local_.depth++) {
+    local_.reader.emplace(local_.epoch, support::epoch::full_t::wait);
+    local_.guard.emplace(*local_.reader);
+  }
+}
+
+/**-----------------------------------------------------------------------------
+ * Pin Destructor
+ */
+inline
+config::
+pin::
+~pin() {
+  if (!--local_.depth) {
+    local_.guard.reset();
+    local_.reader.reset();
+  }
+}
+
+/**-----------------------------------------------------------------------------
+ * Pin Local
+ */
+inline config::pin::state&
+config::
+pin::
+local(const config& c) {
+  static thread_local state s(c.epoch_);
+  return s;
+}
+
+/**-----------------------------------------------------------------------------
+ * Watcher Constructor
+ */
+inline
+config::
+watcher::
+watcher(config& c,
+        std::chrono::milliseconds interval,
+        std::function<void(const support::error_code&)> report) :
+  config_  (c),
+  interval_(interval),
+  report_  (std::move(report)),
+  stamp_   (stamp()),
+  stop_    (false),
+  thread_  (&watcher::run, this) {
+}
+
+/**-----------------------------------------------------------------------------
+ * Watcher Destructor
+ */
+inline
+config::
+watcher::
+~watcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_.notify_all();
+  thread_.join();
+}
+
+/**-----------------------------------------------------------------------------
+ * Watcher Stamp
+ */
+inline std::string
+config::
+watcher::
+stamp() const {
+
+  std::string file;
+  {
+    std::lock_guard<std::mutex> lock(config_.write_);
+    file = config_.file_;
+  }
+  struct stat st;
+  if (::stat(file.c_str(), &st)) {
+    return std::string();
+  }
+  return std::to_string(st.st_ino) + ":" + std::to_string(st.st_size) + ":" +
+         std::to_string(st.st_mtim.tv_sec) + "." +
+         std::to_string(st.st_mtim.tv_nsec);
+}
+
+/**-----------------------------------------------------------------------------
+ * Watcher Run
+ */
+inline void
+config::
+watcher::
+run() {
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!cond_.wait_for(lock, interval_, [this] { return stop_; })) {
+    lock.unlock();
+    const std::string s = stamp();
+    if (!s.empty() && s != stamp_) {
+      stamp_ = s;
+      support::error_code err;
+      config_.reload(err);
+      if (report_) {
+        report_(err);
+      }
+    }
+    lock.lock();
+  }
+}
+
+/**-----------------------------------------------------------------------------
+ * Serialize
+ */
+inline bool
+config::
+serialize(support::error_code& err) {
+
+  std::lock_guard<std::mutex> lock(write_);
+  if (saved_ == version_) {
+    return true;
+  }
+
+  ////////
+  /// format the current snapshot [write_ keeps it from being retired]
+  ////////
+  const flat_store& store = *current_.load(std::memory_order_relaxed)->store;
+  emitter e(store, buffer_);
+  e.run();
+
+  ////////
+  /// temp file, fsync, rename, fsync the directory
+  ////////
+  const std::string tmp = file_ + ".tmp";
+  const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    err.append(-1, "Failed to open config file: <:" + tmp + ">");
+    return false;
+  }
+  size_t done = 0;
+  while (done < buffer_.size()) {
+    const ssize_t n = ::write(fd, buffer_.data() + done,
+                              buffer_.size() - done);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+  }
+  const bool synced = done == buffer_.size() && !::fsync(fd);
+  ::close(fd);
+  if (!synced || std::rename(tmp.c_str(), file_.c_str())) {
+    ::unlink(tmp.c_str());
+    err.append(-1, "Failed to write config file: <:" + file_ + ">");
+    return false;
+  }
+  const size_t slash = file_.rfind('/');
+  const std::string dir = slash == std::string::npos ? "." :
+                          slash ? file_.substr(0, slash) : "/";
+  const int dfd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dfd != -1) {
+    ::fsync(dfd);
+    ::close(dfd);
+  }
+  saved_ = version_;
   return true;
 }
 
@@ -0,0 +1,346 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <config.hpp>
+
+////////
+/// every entry of the current snapshot as type|key=value, sorted;
+/// floats in hex so nothing is lost to rounding
+////////
+static std::vector<std::string>
+dump(support::config& c,
+     bool& mapped) {
+
+  std::vector<std::string> out;
+  mapped = c.read([&out](const support::flat_store& s) {
+    s.for_each([&out, &s](const support::flat_store::slot& x) {
+      std::string v;
+      if (x.type == support::flat_store::type_t::boolean) {
+        v = s.boolean(x) ? "true" : "false";
+      }
+      else if (x.type == support::flat_store::type_t::integer) {
+        v = std::to_string(s.integer(x));
+      }
+      else if (x.type == support::flat_store::type_t::real) {
+        char b[64];
+        std::snprintf(b, sizeof(b), "%a", s.real(x));
+        v = b;
+      }
+      else {
+        v = std::string(s.text(x));
+      }
+      out.push_back(std::to_string(int(x.type)) + "|" +
+                    std::string(s.key(x)) + "=" + v);
+    });
+    return s.mapped();
+  });
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+////////
+/// dump to file, one entry per line
+////////
+static bool
+save(support::config& c,
+     const std::string& file,
+     bool& mapped) {
+
+  const std::vector<std::string> d = dump(c, mapped);
+  std::ofstream out(file);
+  for (size_t i = 0; i < d.size(); ++i) {
+    out << d[i] << '\n';
+  }
+  return bool(out);
+}
+
+////////
+/// a json file w/ n keys of every type, nested objects, arrays and
+/// escaped strings
+////////
+static void
+generate(const std::string& file,
+         size_t n) {
+
+  std::ofstream out(file);
+  out << "{\n  \"order_tracker\": {\n";
+  for (size_t i = 0; i < n; ++i) {
+    out << "    \"key_" << i << "\": ";
+    switch (i % 5) {
+    case 0:  out << i; break;
+    case 1:  out << "\"value \\\"" << i << "\\\"\\n\\t\\u0001\""; break;
+    case 2:  out << (i / 5 & 1 ? "true" : "false"); break;
+    case 3:  out << i << ".25e-3"; break;
+    default: out << "{ \"list\": [" << i << ", \"x\", 1.5, false] }"; break;
+    }
+    out << (i + 1 < n ? ",\n" : "\n");
+  }
+  out << "  }\n}\n";
+}
+
+////////
+/// copies from to file
+////////
+static bool
+copy(const std::string& from,
+     const std::string& file) {
+
+  std::ifstream in(from);
+  std::ofstream out(file);
+  return in && (out << in.rdbuf());
+}
+
+////////
+/// runs f in a fresh process [config is a singleton]; true if it
+/// exited 0
+////////
+template <class F>
+static bool
+child(F f) {
+  std::cout.flush();
+  const pid_t pid = ::fork();
+  if (pid == 0) {
+    const bool ok = f();
+    std::cout.flush();
+    ::_exit(ok ? 0 : 1);
+  }
+  int status = 0;
+  ::waitpid(pid, &status, 0);
+  return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+////////
+/// true if the dumps in a and b hold the same lines; counts them
+////////
+static bool
+same(const std::string& a,
+     const std::string& b,
+     size_t& entries) {
+
+  std::ifstream fa(a), fb(b);
+  std::string x, y;
+  entries = 0;
+  for (;;) {
+    const bool ha = bool(std::getline(fa, x));
+    const bool hb = bool(std::getline(fb, y));
+    if (!ha || !hb) {
+      return ha == hb;
+    }
+    ++entries;
+    if (x != y) {
+      std::cout << "differs: <" << x << "> vs <" << y << ">" << std::endl;
+      return false;
+    }
+  }
+}
+
+////////
+/// one init w/ cache, timed; the store must be mapped iff map
+////////
+static bool
+load(const std::string& json,
+     const std::string& file,
+     bool map) {
+
+  support::config& c = support::config::instance();
+  support::error_code err;
+  const std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  if (!c.init(err, json, true)) {
+    std::cout << err;
+    return false;
+  }
+  const std::chrono::steady_clock::time_point end =
+    std::chrono::steady_clock::now();
+  bool mapped = false;
+  if (!save(c, file, mapped)) {
+    return false;
+  }
+  std::cout << (map ? "mapped " : "parse ")
+            << std::chrono::duration_cast<std::chrono::microseconds>(
+                 end - start).count() << "us"
+            << (mapped == map ? "" : map ? " [not mapped]" : " [mapped]")
+            << std::endl;
+  return mapped == map;
+}
+
+////////
+/// image check: the first init parses and writes the image, the
+/// second must map it and read back the same entries
+////////
+static bool
+image(const std::string& json,
+      const std::string& dir) {
+
+  std::remove((json + ".cache").c_str());
+  const std::string a = dir + "/cr-parse.txt";
+  const std::string b = dir + "/cr-map.txt";
+  size_t entries = 0;
+  const bool ok = child([&json, &a]() { return load(json, a, false); }) &&
+                  child([&json, &b]() { return load(json, b, true); }) &&
+                  same(a, b, entries);
+  std::cout << "image: entries " << entries << (ok ? ", same" : ", FAILED")
+            << std::endl;
+  return ok;
+}
+
+////////
+/// inode and mtime, to tell whether serialize rewrote the file
+////////
+static std::string
+stamp(const std::string& file) {
+  struct stat st;
+  if (::stat(file.c_str(), &st)) {
+    return std::string();
+  }
+  return std::to_string(st.st_ino) + ":" +
+         std::to_string(st.st_mtim.tv_sec) + "." +
+         std::to_string(st.st_mtim.tv_nsec);
+}
+
+////////
+/// writer side: load, add the awkward cases, serialize, dump
+/// - a name w/ several types, and a value next to members
+/// - whole and tiny floats, escapes in keys and values
+/// - a level that is almost an array [0, 1, 2.x and 10]
+/// - '.' next to keys that sort around it
+////////
+static bool
+write(const std::string& json,
+      const std::string& file) {
+
+  support::config& c = support::config::instance();
+  support::error_code err;
+  if (!c.init(err, json)) {
+    std::cout << err;
+    return false;
+  }
+  std::string before = stamp(json);
+  if (!c.serialize(err) || stamp(json) != before) {
+    std::cout << "clean config was rewritten" << std::endl;
+    return false;
+  }
+  c.insert_or_assign<bool>("order_tracker.matching", true);
+  c.insert_or_assign<int>("order_tracker.matching", 3);
+  c.insert_or_assign<std::string_view>("weird \"key\"\n", "tab\there\x01");
+  c.insert_or_assign<float>("f.whole", 3.0f);
+  c.insert_or_assign<float>("f.small", 1e-20f);
+  c.insert_or_assign<float>("arr.0", 1.5f);
+  c.insert_or_assign<int>("arr.1", 2);
+  c.insert_or_assign<int>("arr.2.x", 2);
+  c.insert_or_assign<int>("arr.10", 10);
+  c.insert_or_assign<int>("a-b", 1);
+  c.insert_or_assign<int>("a.b", 2);
+  c.insert_or_assign<int>("a", 3);
+
+  const std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  if (!c.serialize(err)) {
+    std::cout << err;
+    return false;
+  }
+  const std::chrono::steady_clock::time_point end =
+    std::chrono::steady_clock::now();
+  before = stamp(json);
+  if (!c.serialize(err) || stamp(json) != before) {
+    std::cout << "unchanged config was rewritten" << std::endl;
+    return false;
+  }
+  std::cout << "serialize "
+            << std::chrono::duration<double, std::milli>(end - start).count()
+            << "ms" << std::endl;
+  bool mapped = false;
+  return save(c, file, mapped);
+}
+
+////////
+/// reader side: load what serialize wrote, dump
+////////
+static bool
+read(const std::string& json,
+     const std::string& file) {
+
+  support::config& c = support::config::instance();
+  support::error_code err;
+  if (!c.init(err, json)) {
+    std::cout << err;
+    return false;
+  }
+  bool mapped = false;
+  return save(c, file, mapped);
+}
+
+////////
+/// serialize check: serialize must skip the clean file, write the
+/// changed snapshot, then skip again; loading what it wrote must give
+/// back the same entries
+////////
+static bool
+serialize(const std::string& json,
+          const std::string& dir) {
+
+  const std::string a = dir + "/cr-written.txt";
+  const std::string b = dir + "/cr-read.txt";
+  size_t entries = 0;
+  const bool ok = child([&json, &a]() { return write(json, a); }) &&
+                  child([&json, &b]() { return read(json, b); }) &&
+                  same(a, b, entries);
+  std::cout << "serialize: entries " << entries
+            << (ok ? ", same" : ", FAILED") << std::endl;
+  return ok;
+}
+
+int main(int argc, char** argv) {
+
+  ////////
+  /// -n n -> keys in the generated config [no file given]
+  /// -d d -> work directory
+  /// -m m -> image|serialize, both if not given
+  ///
+  /// [file] is copied into the work directory and put through the
+  /// image and serialize round trips; each dumps every entry before
+  /// and after and they must match. Exits 0 if they all do.
+  ////////
+  size_t n = 5000;
+  std::string dir = "/tmp";
+  std::string mode;
+  int c;
+  while ((c = ::getopt(argc, argv, "n:d:m:")) != -1) {
+    if (c == 'n')      n = ::atol(optarg);
+    else if (c == 'd') dir = optarg;
+    else if (c == 'm') mode = optarg;
+    else {
+      std::cout << "Usage: <" << argv[0] << "> [-n keys] [-d dir] "
+                << "[-m image|serialize] [file]" << std::endl;
+      return -1;
+    }
+  }
+  const std::string json = dir + "/cr.json";
+  if (optind < argc) {
+    if (!copy(argv[optind], json)) {
+      std::cout << "Bad config file: <:" << argv[optind] << ">" << std::endl;
+      return -1;
+    }
+  }
+  else {
+    generate(json, n);
+  }
+  bool ok = true;
+  if (mode.empty() || mode == "image") {
+    const std::string file = dir + "/cr-image.json";
+    ok = copy(json, file) && image(file, dir) && ok;
+  }
+  if (mode.empty() || mode == "serialize") {
+    const std::string file = dir + "/cr-serialize.json";
+    ok = copy(json, file) && serialize(file, dir) && ok;
+  }
+  return ok ? 0 : 1;
+}
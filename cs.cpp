@@ -0,0 +1,189 @@
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include <config.hpp>
+
+EXP_CONFIG_KEY(gen, int, "t.gen", -1);
+EXP_CONFIG_KEY(name, std::string_view, "t.name", "none");
+
+////////
+/// writes generation g [gen, mirror and name agree] and renames it
+/// over file, as editors do
+////////
+static void
+write(const std::string& file,
+      int g) {
+
+  const std::string tmp = file + ".tmp";
+  {
+    std::ofstream out(tmp);
+    out << "{\"t\":{\"gen\":" << g << ",\"mirror\":" << g
+        << ",\"name\":\"gen" << g << "\"}}";
+  }
+  std::rename(tmp.c_str(), file.c_str());
+}
+
+////////
+/// nanoseconds per get of an int handle, w/ and w/o an enclosing read
+////////
+static void
+timing(support::config& c,
+       size_t n) {
+
+  long sum = 0;
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; ++i) {
+    sum += c.get(gen);
+  }
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  c.read([&c, &sum, n](const support::flat_store&) {
+    for (size_t i = 0; i < n; ++i) {
+      sum += c.get(gen);
+    }
+    return 0;
+  });
+  std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; ++i) {
+    sum += c.find<int>("t.gen");
+  }
+  std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+  auto ns = [n](std::chrono::steady_clock::time_point a,
+                std::chrono::steady_clock::time_point b) {
+    return std::chrono::duration<double, std::nano>(b - a).count() / n;
+  };
+  std::cout << "get " << ns(t0, t1) << "ns, get in read " << ns(t1, t2)
+            << "ns, find " << ns(t2, t3) << "ns [" << sum % 7 << "]"
+            << std::endl;
+}
+
+int main(int argc, char** argv) {
+
+  ////////
+  /// -r n -> reader threads [may exceed support::epoch::slots_]
+  /// -g n -> generations written while they read
+  /// -w n -> watcher poll interval in milliseconds
+  /// -f f -> config file to rewrite
+  /// -n n -> gets per timing loop
+  ///
+  /// readers check that one read never mixes two generations, that a
+  /// get view still holds its generation's name after later writes,
+  /// and that as_string copies agree w/ get; a truncated file at the
+  /// end must leave the last generation in place. Meant to be built
+  /// w/ -fsanitize=thread too.
+  ////////
+  size_t readers = 3;
+  int generations = 40;
+  int interval = 5;
+  std::string file = "/tmp/cs.json";
+  size_t n = 10000000;
+  int c;
+  while ((c = ::getopt(argc, argv, "r:g:w:f:n:")) != -1) {
+    if (c == 'r')      readers = ::atol(optarg);
+    else if (c == 'g') generations = ::atoi(optarg);
+    else if (c == 'w') interval = ::atoi(optarg);
+    else if (c == 'f') file = optarg;
+    else if (c == 'n') n = ::atol(optarg);
+    else {
+      std::cout << "Usage: <" << argv[0] << "> [-r readers] "
+                << "[-g generations] [-w interval] [-f file] [-n gets]"
+                << std::endl;
+      return -1;
+    }
+  }
+  support::config& config = support::config::instance();
+  write(file, 0);
+  {
+    support::error_code err;
+    if (!config.init(err, file)) {
+      std::cout << err;
+      return -1;
+    }
+  }
+  timing(config, n);
+
+  std::atomic<bool> stop(false);
+  std::atomic<long> reads(0), torn(0), stale(0);
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < readers; ++t) {
+    threads.emplace_back([&config, &stop, &reads, &torn, &stale]() {
+      long r = 0;
+      while (!stop.load()) {
+        config.read([&torn](const support::flat_store& s) {
+          const support::flat_store::slot* a =
+            s.find(support::flat_store::type_t::integer, "t.gen");
+          const support::flat_store::slot* b =
+            s.find(support::flat_store::type_t::integer, "t.mirror");
+          const support::flat_store::slot* x =
+            s.find(support::flat_store::type_t::string, "t.name");
+          if (!a || !b || !x || s.integer(*a) != s.integer(*b) ||
+              s.text(*x) != "gen" + std::to_string(s.integer(*a))) {
+            ++torn;
+          }
+          return 0;
+        });
+        ////////
+        /// the view stays put until this thread's next get
+        ////////
+        const std::string_view v = config.get(name);
+        const std::string copy(v);
+        std::this_thread::yield();
+        if (v != copy || config.as_string(gen).empty()) {
+          ++stale;
+        }
+        r += 2;
+      }
+      reads += r;
+    });
+  }
+  std::atomic<int> reloads(0), failures(0), notes(0);
+  config.subscribe("t.gen", [&notes, &config](const support::config::change&) {
+    ++notes;
+    config.get(gen);
+  });
+  {
+    support::config::watcher w(
+      config, std::chrono::milliseconds(interval),
+      [&reloads, &failures](const support::error_code& e) {
+        e ? ++reloads : ++failures;
+      });
+    for (int g = 1; g <= generations; ++g) {
+      write(file, g);
+      if (g % 10 == 0) {
+        config.insert_or_assign<int>("t.extra", g);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(3 * interval));
+    }
+    {
+      std::ofstream out(file + ".tmp");
+      out << "{\"t\":{\"gen\":";
+    }
+    std::rename((file + ".tmp").c_str(), file.c_str());
+    std::this_thread::sleep_for(std::chrono::milliseconds(6 * interval));
+  }
+  stop = true;
+  for (size_t t = 0; t < threads.size(); ++t) {
+    threads[t].join();
+  }
+  timing(config, n);
+
+  const bool ok = !torn && !stale && failures == 1 &&
+                  config.get(gen) == generations &&
+                  config.as_string(name) == "gen" + std::to_string(generations);
+  std::cout << "readers " << readers
+            << ", reads " << reads.load()
+            << ", torn " << torn.load()
+            << ", stale views " << stale.load()
+            << ", reloads " << reloads.load()
+            << ", failures " << failures.load()
+            << ", notes " << notes.load()
+            << ", gen " << config.get(gen)
+            << ", name " << config.as_string(name)
+            << (ok ? ", ok" : ", FAILED") << std::endl;
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <unistd.h>
+#include <ec.hpp>
+#include <ah.hpp>
+
+////////
+/// the error_code layout before the inline text and arena: the first
+/// error's text in a std::string, the rest in a vector
+////////
+struct legacy_error {
+  int                        code;
+  std::string                text;
+  std::vector<legacy_error>  chain;
+
+  legacy_error() : code(0) {}
+  legacy_error(int c, const std::string& t) : code(c), text(t) {}
+
+  void append(int c, const std::string& t) {
+    if (!code) {
+      code = c;
+      text = t;
+    }
+    else {
+      chain.push_back(legacy_error(c, t));
+    }
+  }
+};
+
+static const support::error_category cancel_not_found(
+  -1, "Failed to cancel order - not found; order id <{}>");
+
+////////
+/// the message a handler used to build for a failed cancel
+////////
+static std::string
+message(int id) {
+  return "Failed to cancel order - not found; order id <" +
+         std::to_string(id) + ">";
+}
+
+////////
+/// an asm barrier on x, so the optimizer can't drop an object a loop
+/// only builds
+////////
+template <class T>
+static void
+keep(const T& x) {
+  asm volatile("" : : "r"(&x) : "memory");
+}
+
+////////
+/// runs f n times inside the errors scope; prints allocations,
+/// bytes and time per error
+////////
+template <class F>
+static void
+measure(const char* name,
+        size_t n,
+        F f) {
+
+  const uint64_t a = support::allocations::allocs(support::allocations::errors);
+  const uint64_t b = support::allocations::bytes(support::allocations::errors);
+  const std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  {
+    support::allocations::scope s(support::allocations::errors);
+    f(n);
+  }
+  const double ns = std::chrono::duration<double, std::nano>(
+    std::chrono::steady_clock::now() - start).count() / n;
+  const uint64_t allocs =
+    support::allocations::allocs(support::allocations::errors) - a;
+  const uint64_t bytes =
+    support::allocations::bytes(support::allocations::errors) - b;
+  std::cout << name
+            << ": allocs " << allocs
+            << ", bytes " << bytes
+            << ", per error " << double(allocs) / n << " allocs, "
+            << double(bytes) / n << " bytes, " << ns << "ns" << std::endl;
+}
+
+int main(int argc, char** argv) {
+
+  ////////
+  /// -n n -> errors per case
+  ///
+  /// needs -DEXP_TRACK_ALLOCATIONS; every case runs in the errors
+  /// scope, so the counts are exactly what it allocated
+  /// - run: one error_code collecting n failures, as exec's does
+  /// - each: a fresh error_code per failure
+  /// - copy: a copy of a 3 deep chain plus one append per failure
+  /// - long: 200 byte texts, past the inline buffer
+  /// legacy_ cases are the same w/ the old string + vector layout;
+  /// string cases build the message like the handlers used to,
+  /// category cases defer it like they do now
+  ////////
+  size_t n = 1000000;
+  int c;
+  while ((c = ::getopt(argc, argv, "n:")) != -1) {
+    if (c == 'n') {
+      n = ::atol(optarg);
+    }
+    else {
+      std::cout << "Usage: <" << argv[0] << "> [-n errors]" << std::endl;
+      return -1;
+    }
+  }
+  if (!support::allocations::enabled()) {
+    std::cout << "Allocations: not tracked [build w/ "
+              << "-DEXP_TRACK_ALLOCATIONS]" << std::endl;
+    return -1;
+  }
+  const std::string text(200, 'x');
+
+  measure("legacy run", n, [](size_t n) {
+    legacy_error e;
+    for (size_t i = 0; i < n; ++i) e.append(-1, message(int(i)));
+    keep(e);
+  });
+  measure("string run", n, [](size_t n) {
+    support::error_code e;
+    for (size_t i = 0; i < n; ++i) e.append(-1, message(int(i)));
+    keep(e);
+  });
+  measure("category run", n, [](size_t n) {
+    support::error_code e;
+    for (size_t i = 0; i < n; ++i) e.append(cancel_not_found, int(i));
+    keep(e);
+  });
+  measure("legacy each", n, [](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      legacy_error e;
+      e.append(-1, message(int(i)));
+      keep(e);
+    }
+  });
+  measure("string each", n, [](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      support::error_code e;
+      e.append(-1, message(int(i)));
+      keep(e);
+    }
+  });
+  measure("category each", n, [](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      support::error_code e;
+      e.append(cancel_not_found, int(i));
+      keep(e);
+    }
+  });
+  measure("legacy copy", n, [](size_t n) {
+    legacy_error base(-1, "one");
+    base.append(-2, "two");
+    base.append(-3, "three");
+    for (size_t i = 0; i < n; ++i) {
+      legacy_error e(base);
+      e.append(-4, "four");
+      keep(e);
+    }
+  });
+  measure("error_code copy", n, [](size_t n) {
+    support::error_code base(-1, "one");
+    base.append(-2, "two");
+    base.append(-3, "three");
+    for (size_t i = 0; i < n; ++i) {
+      support::error_code e(base);
+      e.append(-4, "four");
+      keep(e);
+    }
+  });
+  measure("legacy long", n, [&text](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      legacy_error e(-1, text);
+      keep(e);
+    }
+  });
+  measure("error_code long", n, [&text](size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      support::error_code e(-1, text);
+      keep(e);
+    }
+  });
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <unistd.h>
+#include <me.hpp>
+#include <sl.hpp>
+
+using op = trade::synthetic_load::op;
+
+int main(int argc, char** argv) {
+
+  ////////
+  /// -n n -> operations per run
+  /// -p n -> products
+  /// -b n -> price band in ticks
+  /// -r n -> runs
+  /// -s n -> seed
+  ///
+  /// prints the engine only rate per run; ids of filled or cancelled
+  /// orders make later R/M fail, as they would from a feed
+  ////////
+  size_t n = 1000000;
+  int products = 16;
+  int band = 40;
+  int runs = 3;
+  unsigned seed = 1;
+  int c;
+  while ((c = ::getopt(argc, argv, "n:p:b:r:s:")) != -1) {
+    if (c == 'n')      n = ::atol(optarg);
+    else if (c == 'p') products = ::atoi(optarg);
+    else if (c == 'b') band = ::atoi(optarg);
+    else if (c == 'r') runs = ::atoi(optarg);
+    else if (c == 's') seed = ::atoi(optarg);
+    else {
+      std::cout << "Usage: <" << argv[0] << "> [-n ops] [-p products] "
+                << "[-b band] [-r runs] [-s seed]" << std::endl;
+      return -1;
+    }
+  }
+  const std::vector<op> ops =
+    trade::synthetic_load::generate(n, products, band, seed);
+
+  for (int r = 0; r < runs; ++r) {
+    trade::matching_engine me(n);
+    size_t fills = 0;
+    const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+    for (size_t i = 0; i < ops.size(); ++i) {
+      const op& o = ops[i];
+      if (o.action == 'N') {
+        me.add(o.id, o.prod,
+               o.buy ? trade::matching_engine::side_t::buy :
+                       trade::matching_engine::side_t::sell,
+               o.quantity, o.price);
+      }
+      else if (o.action == 'R') {
+        me.cancel(o.id);
+      }
+      else {
+        me.modify(o.id, o.quantity, o.price);
+      }
+      fills += me.tape().size();
+    }
+    const double s = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+    std::cout << "run " << r
+              << ": ops " << ops.size()
+              << ", fills " << fills
+              << ", resting " << me.size()
+              << ", " << s * 1e3 << "ms, "
+              << static_cast<uint64_t>(ops.size() / s) << " ops/s"
+              << std::endl;
+    std::cout << me.latencies();
+  }
+  return 0;
+}
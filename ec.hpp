@@ -2,16 +2,159 @@
 #define __EXP_ERROR_CODE_HPP__
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <charconv>
 #include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <at.hpp>
 
 namespace support {
 
+////////
+/// registered error kind: a code and a message template
+/// - categories are defined once, typically as statics; the template's
+///   {} are replaced by an error's arguments in order
+/// - an error raised w/ a category keeps the category id and its raw
+///   arguments [integers, or text copied as is]; nothing is formatted
+///   until the error is traced
+/// - at most capacity_ categories per process
+////////
+class error_category {
+public:
+
+  ////////
+  /// semantics ->
+  /// - registers format for errors w/ code [non zero]
+  ////////
+  error_category(int code, std::string_view format);
+
+  error_category(const error_category&) = delete;
+  error_category& operator=(const error_category&) = delete;
+
+  ////////
+  /// semantics ->
+  /// - id, 0 is reserved for plain text errors
+  ////////
+  uint32_t id() const;
+  int code() const;
+
+  ////////
+  /// format semantics ->
+  /// - appends category id's template to out w/ its {} replaced by
+  ///   the packed args
+  ////////
+  static void format(std::string& out, uint32_t id, std::string_view args);
+
+private:
+
+  static constexpr size_t capacity_ = 256;
+
+  ////////
+  /// templates by id - 1; an id is handed out only after its template
+  /// is written, so readers need no lock
+  ////////
+  struct registry {
+    std::mutex             lock;
+    std::atomic<uint32_t>  size{0};
+    std::string            formats[capacity_];
+  };
+
+  static registry& instance();
+
+  uint32_t  id_;
+  int       code_;
+};
+
+////////
+/// per thread storage for chained errors and long texts
+/// - entries are bump allocated in blocks that never move and are
+///   only ever written by the owning thread
+/// - every error_code pointing into an arena holds a reference, as
+///   does the owning thread; once only the owner is left the next
+///   error rewinds the blocks instead of allocating
+/// - the last reference deletes the arena, so errors may outlive or
+///   leave the thread that made them
+////////
+class error_arena {
+public:
+
+  ////////
+  /// one error; its bytes follow the struct - text, or packed
+  /// arguments if it has a category
+  ////////
+  struct entry {
+    entry*    next;
+    int       code;
+    uint32_t  size;
+    uint32_t  category;
+
+    char* data();
+    std::string_view text() const;
+  };
+
+  ////////
+  /// semantics ->
+  /// - calling thread's arena
+  ////////
+  static error_arena& local();
+
+  ////////
+  /// make semantics ->
+  /// - entry w/ room for size bytes [owning thread only]
+  ////////
+  entry* make(int code, uint32_t category, size_t size);
+
+  ////////
+  /// semantics ->
+  /// - references; acquire rewinds an arena only its owner refers to
+  ////////
+  void acquire();
+  void release();
+
+private:
+
+  static constexpr size_t block_ = 64 * 1024;
+
+  ////////
+  /// owns the thread's reference
+  ////////
+  struct holder {
+    holder();
+    ~holder();
+    error_arena*  arena;
+  };
+
+  error_arena();
+
+  std::vector<std::pair<std::unique_ptr<char[]>, size_t>>  blocks_;
+  size_t                                                   current_;
+  size_t                                                   used_;
+  std::atomic<size_t>                                      refs_;
+};
+
 ////////
 /// basic error container
+/// - the first error's bytes are kept inline when they fit; chained
+///   errors and longer ones live in the thread's error_arena
+/// - an error is either plain text or an error_category w/ packed
+///   arguments, formatted only when traced
+/// - a success is code zero and nothing else: construction sets four
+///   words, copies skip the text and pointers, checks read code
 ////////
 struct error_code {
 
+  ////////
+  /// inline text capacity
+  ////////
+  static constexpr size_t inline_ = 96;
+
   ////////
   /// default constructor
   ////////
@@ -20,40 +163,348 @@ struct error_code {
   ////////
   /// constructor
   ////////
-  error_code(int code, const std::string& text);
+  error_code(int code, std::string_view text);
+
+  ////////
+  /// constructor
+  /// - args are integers or strings, one per {} in the template
+  ////////
+  template <class... A>
+  error_code(const error_category& category, const A&... args);
+
+  ////////
+  /// copy / move share arena entries
+  ////////
+  error_code(const error_code& o);
+  error_code(error_code&& o);
+  error_code& operator=(const error_code& o);
+  error_code& operator=(error_code&& o);
+  ~error_code();
 
   ////////
   /// append
+  /// - first error if there is none, else chained
   ////////
-  void append(int code, const std::string& text);
+  void append(int code, std::string_view text);
+
+  ////////
+  /// append
+  /// - as above; copies the args, formats nothing
+  ////////
+  template <class... A>
+  void append(const error_category& category, const A&... args);
 
   ////////
   /// boolean operator
   ////////
   operator bool() const;
 
-  typedef std::vector<error_code>  chain_t;
+  ////////
+  /// semantics ->
+  /// - first error's text, formatted
+  ////////
+  std::string text() const;
+
+  ////////
+  /// semantics ->
+  /// - errors held, first plus chained
+  ////////
+  size_t size() const;
+
+  ////////
+  /// for_each semantics ->
+  /// - f(code, text) for every error, first to last; text is
+  ///   formatted into a buffer valid for the call only
+  ////////
+  template <class F>
+  void for_each(F f) const;
 
-  int         code;
-  std::string text;
-  chain_t     chain;
+  int  code;
 
   ////////
   /// operator<<
-  /// - traces no error if code is zero and chain empty
-  /// - traces its code and text
+  /// - traces no error if code is zero
+  /// - traces its code and text, formatting categorized errors
   /// - traces chain
   ////////
   template <class T>
   friend T& operator<<(T& out, const error_code& ec);
+
+private:
+
+  ////////
+  /// semantics ->
+  /// - drops the arena reference
+  ////////
+  void reset();
+
+  ////////
+  /// semantics ->
+  /// - room for the next error's n bytes, inline or in the arena
+  ////////
+  char* reserve(int code, uint32_t category, size_t n);
+
+  ////////
+  /// semantics ->
+  /// - packed size of an arg; tag + 8 bytes for integers, tag + 4
+  ///   byte length + bytes for strings
+  ////////
+  template <class T>
+  static size_t packed(const T& v);
+
+  ////////
+  /// semantics ->
+  /// - packs an arg at p, returns the end
+  ////////
+  template <class T>
+  static char* pack(char* p, const T& v);
+
+  ////////
+  /// semantics ->
+  /// - f(code, text) for one error's bytes
+  ////////
+  template <class F>
+  static void render(F& f,
+                     std::string& buf,
+                     int code,
+                     uint32_t category,
+                     std::string_view bytes);
+
+  ////////
+  /// semantics ->
+  /// - makes the chain appendable from this thread: copies it into
+  ///   the local arena if it lives elsewhere or a copy appended past
+  ///   its tail
+  ////////
+  void own();
+
+  uint32_t              size_;      /// first error's bytes
+  uint32_t              count_;     /// chained errors
+  uint32_t              category_;  /// first error's category
+  error_arena::entry*   long_;      /// first error if longer than inline_
+  error_arena::entry*   head_;
+  error_arena::entry*   tail_;
+  error_arena*          arena_;
+  char                  text_[inline_];
 };
 
+////////
+/// category constructor
+////////
+inline
+error_category::
+error_category(int code,
+               std::string_view format) :
+  code_(code) {
+
+  registry& r = instance();
+  std::lock_guard<std::mutex> lock(r.lock);
+  const uint32_t n = r.size.load(std::memory_order_relaxed);
+  if (n == capacity_) {
+    throw std::length_error("too many error categories");
+  }
+  r.formats[n] = format;
+  r.size.store(n + 1, std::memory_order_release);
+  id_ = n + 1;
+}
+
+////////
+/// id
+////////
+inline uint32_t
+error_category::
+id() const {
+  return id_;
+}
+
+////////
+/// code
+////////
+inline int
+error_category::
+code() const {
+  return code_;
+}
+
+////////
+/// instance
+////////
+inline error_category::registry&
+error_category::
+instance() {
+  static registry r;
+  return r;
+}
+
+////////
+/// format
+////////
+inline void
+error_category::
+format(std::string& out,
+       uint32_t id,
+       std::string_view args) {
+
+  const std::string& f = instance().formats[id - 1];
+  size_t i = 0;
+  for (size_t p = f.find("{}"); p != std::string::npos; p = f.find("{}", i)) {
+    out.append(f, i, p - i);
+    i = p + 2;
+
+    ////////
+    /// a missing arg leaves its {} in place
+    ////////
+    if (args.empty()) {
+      out.append("{}");
+    }
+    else if (args[0] == 'i') {
+      int64_t v;
+      std::memcpy(&v, args.data() + 1, sizeof(v));
+      char buf[24];
+      const std::to_chars_result r = std::to_chars(buf, buf + sizeof(buf), v);
+      out.append(buf, r.ptr);
+      args.remove_prefix(1 + sizeof(v));
+    }
+    else {
+      uint32_t n;
+      std::memcpy(&n, args.data() + 1, sizeof(n));
+      out.append(args.data() + 1 + sizeof(n), n);
+      args.remove_prefix(1 + sizeof(n) + n);
+    }
+  }
+  out.append(f, i, std::string::npos);
+}
+
+////////
+/// entry data
+////////
+inline char*
+error_arena::
+entry::
+data() {
+  return reinterpret_cast<char*>(this + 1);
+}
+
+////////
+/// entry text
+////////
+inline std::string_view
+error_arena::
+entry::
+text() const {
+  return std::string_view(reinterpret_cast<const char*>(this + 1), size);
+}
+
+////////
+/// arena constructor
+////////
+inline
+error_arena::
+error_arena() :
+  current_(0),
+  used_   (0),
+  refs_   (1) {
+}
+
+////////
+/// holder constructor
+////////
+inline
+error_arena::
+holder::
+holder() :
+  arena(new error_arena()) {
+}
+
+////////
+/// holder destructor
+////////
+inline
+error_arena::
+holder::
+~holder() {
+  arena->release();
+}
+
+////////
+/// local
+////////
+inline error_arena&
+error_arena::
+local() {
+  static thread_local holder h;
+  return *h.arena;
+}
+
+////////
+/// make
+////////
+inline error_arena::entry*
+error_arena::
+make(int code,
+     uint32_t category,
+     size_t size) {
+
+  const size_t n = (sizeof(entry) + size + 7) & ~size_t(7);
+  while (current_ < blocks_.size() &&
+         used_ + n > blocks_[current_].second) {
+    ++current_;
+    used_ = 0;
+  }
+  if (current_ == blocks_.size()) {
+    const size_t size = std::max(block_, n);
+    blocks_.emplace_back(std::unique_ptr<char[]>(new char[size]), size);
+    used_ = 0;
+  }
+  entry* e = reinterpret_cast<entry*>(blocks_[current_].first.get() + used_);
+  used_ += n;
+  e->next     = nullptr;
+  e->code     = code;
+  e->size     = size;
+  e->category = category;
+  return e;
+}
+
+////////
+/// acquire
+////////
+inline void
+error_arena::
+acquire() {
+
+  ////////
+  /// only the owner was left, so nothing points into the blocks [and
+  /// nobody else can be copying an error that does]
+  ////////
+  if (refs_.fetch_add(1, std::memory_order_acq_rel) == 1) {
+    current_ = 0;
+    used_    = 0;
+  }
+}
+
+////////
+/// release
+////////
+inline void
+error_arena::
+release() {
+  if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    delete this;
+  }
+}
+
 ////////
 /// default constructor
 ////////
 inline
 error_code::
-error_code() : code(0) {}
+error_code() :
+  code     (0),
+  size_    (0),
+  count_   (0),
+  category_(0),
+  arena_   (nullptr) {
+}
 
 ////////
 /// constructor
@@ -61,35 +512,360 @@ error_code() : code(0) {}
 inline
 error_code::
 error_code(int code,
-           const std::string& text) :
-  code(code),
-  text(text) {
+           std::string_view text) :
+  error_code() {
+  append(code, text);
+}
+
+////////
+/// constructor
+////////
+template <class... A>
+inline
+error_code::
+error_code(const error_category& category,
+           const A&... args) :
+  error_code() {
+  append(category, args...);
+}
+
+////////
+/// copy constructor
+////////
+inline
+error_code::
+error_code(const error_code& o) :
+  code     (o.code),
+  size_    (o.size_),
+  count_   (o.count_),
+  category_(o.category_),
+  long_    (size_ > inline_ ? o.long_ : nullptr),
+  head_    (count_ ? o.head_ : nullptr),
+  tail_    (count_ ? o.tail_ : nullptr),
+  arena_   (o.arena_) {
+
+  if (size_ <= inline_) {
+    std::memcpy(text_, o.text_, size_);
+  }
+  if (arena_) {
+    arena_->acquire();
+  }
+}
+
+////////
+/// move constructor
+////////
+inline
+error_code::
+error_code(error_code&& o) :
+  code     (o.code),
+  size_    (o.size_),
+  count_   (o.count_),
+  category_(o.category_),
+  long_    (size_ > inline_ ? o.long_ : nullptr),
+  head_    (count_ ? o.head_ : nullptr),
+  tail_    (count_ ? o.tail_ : nullptr),
+  arena_   (o.arena_) {
+
+  if (size_ <= inline_) {
+    std::memcpy(text_, o.text_, size_);
+  }
+  o.arena_ = nullptr;
+  o.code   = 0;
+  o.size_  = 0;
+  o.count_ = 0;
+}
+
+////////
+/// copy assignment
+////////
+inline error_code&
+error_code::
+operator=(const error_code& o) {
+  if (this != &o) {
+    error_code c(o);
+    *this = std::move(c);
+  }
+  return *this;
+}
+
+////////
+/// move assignment
+////////
+inline error_code&
+error_code::
+operator=(error_code&& o) {
+
+  if (this != &o) {
+    reset();
+    code      = o.code;
+    size_     = o.size_;
+    count_    = o.count_;
+    category_ = o.category_;
+    long_     = size_ > inline_ ? o.long_ : nullptr;
+    head_     = count_ ? o.head_ : nullptr;
+    tail_     = count_ ? o.tail_ : nullptr;
+    arena_    = o.arena_;
+    if (size_ <= inline_) {
+      std::memcpy(text_, o.text_, size_);
+    }
+    o.arena_ = nullptr;
+    o.code   = 0;
+    o.size_  = 0;
+    o.count_ = 0;
+  }
+  return *this;
+}
+
+////////
+/// destructor
+////////
+inline
+error_code::
+~error_code() {
+  reset();
 }
 
 ////////
 /// append
 ////////
-void
+inline void
 error_code::
 append(int cod,
-       const std::string& txt) {
+       std::string_view txt) {
+
+  allocations::scope scope(allocations::errors);
+  std::memcpy(reserve(cod, 0, txt.size()), txt.data(), txt.size());
+}
+
+////////
+/// append
+////////
+template <class... A>
+inline void
+error_code::
+append(const error_category& category,
+       const A&... args) {
+
+  allocations::scope scope(allocations::errors);
+  char* p = reserve(category.code(), category.id(),
+                    (size_t(0) + ... + packed(args)));
+  ((p = pack(p, args)), ...);
+  (void) p;
+}
+
+////////
+/// boolean operator
+////////
+inline
+error_code::
+operator bool() const {
+  return code == 0;
+}
+
+////////
+/// text
+////////
+inline std::string
+error_code::
+text() const {
+  std::string out;
+  for_each([&out](int, std::string_view text) {
+    if (out.empty()) out = text;
+  });
+  return out;
+}
+
+////////
+/// size
+////////
+inline size_t
+error_code::
+size() const {
+  return (code ? 1 : 0) + count_;
+}
+
+////////
+/// for each
+////////
+template <class F>
+inline void
+error_code::
+for_each(F f) const {
+
+  if (!code) {
+    return;
+  }
+  std::string buf;
+  render(f, buf, code, category_,
+         size_ <= inline_ ? std::string_view(text_, size_) : long_->text());
+
+  ////////
+  /// count bounds the walk; the tail's next may belong to a copy
+  ////////
+  const error_arena::entry* e = head_;
+  for (uint32_t i = 0; i < count_; ++i) {
+    if (i) {
+      e = e->next;
+    }
+    render(f, buf, e->code, e->category, e->text());
+  }
+}
+
+////////
+/// render
+////////
+template <class F>
+inline void
+error_code::
+render(F& f,
+       std::string& buf,
+       int code,
+       uint32_t category,
+       std::string_view bytes) {
+
+  if (!category) {
+    f(code, bytes);
+    return;
+  }
+  buf.clear();
+  error_category::format(buf, category, bytes);
+  f(code, std::string_view(buf));
+}
+
+////////
+/// reset
+////////
+inline void
+error_code::
+reset() {
+  if (arena_) {
+    arena_->release();
+    arena_ = nullptr;
+  }
+}
+
+////////
+/// reserve
+////////
+inline char*
+error_code::
+reserve(int cod,
+        uint32_t category,
+        size_t n) {
 
   if ( !code) {
-    code = cod;
-    text = txt;
+    code      = cod;
+    category_ = category;
+    size_     = n;
+    if (n <= inline_) {
+      return text_;
+    }
+    own();
+    long_ = arena_->make(cod, category, n);
+    return long_->data();
+  }
+  own();
+  error_arena::entry* e = arena_->make(cod, category, n);
+  if (count_) {
+    tail_->next = e;
   }
   else {
-    chain.push_back(error_code(cod, txt));
+    head_ = e;
   }
+  tail_ = e;
+  ++count_;
+  return e->data();
 }
 
 ////////
-/// boolean operator
+/// packed
 ////////
-inline
+template <class T>
+inline size_t
 error_code::
-operator bool() const {
-  return code == 0 && chain.empty();
+packed(const T& v) {
+  if constexpr (std::is_integral<T>::value) {
+    return 1 + sizeof(int64_t);
+  }
+  else {
+    return 1 + sizeof(uint32_t) + std::string_view(v).size();
+  }
+}
+
+////////
+/// pack
+////////
+template <class T>
+inline char*
+error_code::
+pack(char* p,
+     const T& v) {
+  if constexpr (std::is_integral<T>::value) {
+    const int64_t i = v;
+    *p = 'i';
+    std::memcpy(p + 1, &i, sizeof(i));
+    return p + 1 + sizeof(i);
+  }
+  else {
+    const std::string_view s(v);
+    const uint32_t n = s.size();
+    *p = 's';
+    std::memcpy(p + 1, &n, sizeof(n));
+    std::memcpy(p + 1 + sizeof(n), s.data(), n);
+    return p + 1 + sizeof(n) + n;
+  }
+}
+
+////////
+/// own
+////////
+inline void
+error_code::
+own() {
+
+  error_arena& local = error_arena::local();
+  if (arena_ == &local && (!count_ || !tail_->next)) {
+    return;
+  }
+  if (!arena_ && !count_) {
+    local.acquire();
+    arena_ = &local;
+    return;
+  }
+
+  ////////
+  /// copy what this error holds; the local reference is taken first
+  /// so the copies can't be rewound away
+  ////////
+  local.acquire();
+  auto copy = [&local](const error_arena::entry* e) {
+    error_arena::entry* c = local.make(e->code, e->category, e->size);
+    std::memcpy(c->data(), e->text().data(), e->size);
+    return c;
+  };
+  error_arena::entry* first = size_ > inline_ ? copy(long_) : nullptr;
+  error_arena::entry* head = nullptr;
+  error_arena::entry* tail = nullptr;
+  const error_arena::entry* e = head_;
+  for (uint32_t i = 0; i < count_; ++i) {
+    if (i) {
+      e = e->next;
+    }
+    error_arena::entry* c = copy(e);
+    if (tail) {
+      tail->next = c;
+    }
+    else {
+      head = c;
+    }
+    tail = c;
+  }
+  reset();
+  arena_ = &local;
+  long_  = first;
+  head_  = head;
+  tail_  = tail;
 }
 
 ////////
@@ -99,23 +875,16 @@ template <class T>
 inline T&
 operator<<(T& out, const error_code& ec) {
 
-  if (!ec.code && ec.chain.empty()) {
+  if (!ec.code) {
     return out << "no errors" << std::endl;
   }
-
-  out << "code: "
-      << ec.code
-      << ", text: "
-      << ec.text
-      << std::endl;
-
-  for (size_t i = 0; i < ec.chain.size(); ++i) {
+  ec.for_each([&out](int code, std::string_view text) {
     out << "code: "
-        << ec.chain[i].code
+        << code
         << ", text: "
-        << ec.chain[i].text
+        << text
         << std::endl;
-  }
+  });
   return out;
 }
 
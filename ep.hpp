@@ -0,0 +1,163 @@
+#ifndef __EXP_EPOCH_HPP__
+#define __EXP_EPOCH_HPP__
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+namespace support {
+
+////////
+/// epoch based reclamation
+/// - readers announce the epoch they read under and never block
+/// - a writer retires objects it unpublished; they are deleted once
+///   every reader announced a later epoch or went quiescent
+/// - retire/reclaim must be serialized by the caller [one writer at
+///   a time]; readers may be on any thread
+////////
+class epoch {
+public:
+
+  ////////
+  /// readers supported at once
+  ////////
+  static const size_t slots_ = 64;
+
+  class guard;
+
+  ////////
+  /// what a reader does when every slot is taken
+  ////////
+  enum class full_t { fail, wait };
+
+  ////////
+  /// a registered reader - owns one announcement slot
+  ////////
+  class reader {
+  public:
+
+    ////////
+    /// semantics ->
+    /// - claims a free slot
+    /// - all slots_ taken -> throws std::length_error [fail] or yields
+    ///   until one is released [wait; for readers that only hold a
+    ///   slot for the length of a read]
+    ////////
+    reader(epoch& e, full_t full = full_t::fail);
+
+    ////////
+    /// semantics ->
+    /// - releases the slot
+    ////////
+    ~reader();
+
+    reader(const reader&) = delete;
+    reader& operator=(const reader&) = delete;
+
+  private:
+    friend class guard;
+    epoch&  epoch_;
+    size_t  slot_;
+  };
+
+  ////////
+  /// read side critical section
+  ////////
+  class guard {
+  public:
+
+    ////////
+    /// semantics ->
+    /// - announces current epoch in the reader's slot
+    ////////
+    guard(reader& r);
+
+    ////////
+    /// semantics ->
+    /// - marks the slot quiescent
+    ////////
+    ~guard();
+
+    guard(const guard&) = delete;
+    guard& operator=(const guard&) = delete;
+
+  private:
+    std::atomic<uint64_t>&  slot_;
+  };
+
+  ////////
+  /// semantics ->
+  /// - epoch starts at one, all slots free
+  ////////
+  epoch();
+
+  ////////
+  /// semantics ->
+  /// - deletes everything still retired [no readers may remain]
+  ////////
+  ~epoch();
+
+  epoch(const epoch&) = delete;
+  epoch& operator=(const epoch&) = delete;
+
+  ////////
+  /// retire semantics ->
+  /// - queues p w/ the current epoch
+  /// - advances the epoch
+  /// - reclaims what no reader can still see
+  ////////
+  template <class T>
+  void retire(const T* p);
+
+  ////////
+  /// defer semantics ->
+  /// - queues p w/ the current epoch, like retire, but neither
+  ///   advances nor reclaims; the next retire does both for the batch
+  ////////
+  template <class T>
+  void defer(const T* p);
+
+  ////////
+  /// reclaim semantics ->
+  /// - finds the oldest announced epoch
+  /// - deletes retired objects older than it
+  ////////
+  void reclaim();
+
+  ////////
+  /// retired objects not yet deleted
+  ////////
+  size_t pending() const;
+
+private:
+
+  ////////
+  /// retired object w/ its type erased deleter
+  ////////
+  struct retired {
+    uint64_t     epoch;
+    const void*  p;
+    void       (*deleter)(const void*);
+  };
+
+  ////////
+  /// cache line per slot; 0 quiescent, ~0 free, else announced epoch
+  ////////
+  struct alignas(64) slot {
+    std::atomic<uint64_t>  value;
+  };
+
+  static const uint64_t free_ = ~uint64_t(0);
+
+  std::atomic<uint64_t>  epoch_;
+  slot                   slot_[slots_];
+  std::vector<retired>   retired_;
+};
+
+}
+
+#include <ep.ipp>
+
+#endif
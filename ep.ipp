@@ -0,0 +1,159 @@
+namespace support {
+
+////////
+/// reader constructor
+////////
+inline
+epoch::
+reader::
+reader(epoch& e,
+       full_t full) :
+  epoch_(e),
+  slot_(0) {
+
+  for (;;) {
+    for (size_t i = 0; i < slots_; ++i) {
+      uint64_t expected = free_;
+      if (e.slot_[i].value.compare_exchange_strong(expected, 0)) {
+        slot_ = i;
+        return;
+      }
+    }
+    if (full == full_t::fail) {
+      throw std::length_error("no free epoch reader slot");
+    }
+    std::this_thread::yield();
+  }
+}
+
+////////
+/// reader destructor
+////////
+inline
+epoch::
+reader::
+~reader() {
+  epoch_.slot_[slot_].value.store(free_, std::memory_order_release);
+}
+
+////////
+/// guard constructor
+////////
+inline
+epoch::
+guard::
+guard(reader& r) :
+  slot_(r.epoch_.slot_[r.slot_].value) {
+
+  ////////
+  /// seq_cst so the announcement is ordered before any pointer load
+  ////////
+  slot_.store(r.epoch_.epoch_.load(std::memory_order_acquire));
+}
+
+////////
+/// guard destructor
+////////
+inline
+epoch::
+guard::
+~guard() {
+  slot_.store(0, std::memory_order_release);
+}
+
+////////
+/// constructor
+////////
+inline
+epoch::
+epoch() :
+  epoch_(1) {
+  for (size_t i = 0; i < slots_; ++i) {
+    slot_[i].value.store(free_, std::memory_order_relaxed);
+  }
+}
+
+////////
+/// destructor
+////////
+inline
+epoch::
+~epoch() {
+  for (size_t i = 0; i < retired_.size(); ++i) {
+    retired_[i].deleter(retired_[i].p);
+  }
+}
+
+////////
+/// retire
+////////
+template <class T>
+inline void
+epoch::
+retire(const T* p) {
+
+  if (!p) {
+    return;
+  }
+  defer(p);
+  epoch_.fetch_add(1);
+  reclaim();
+}
+
+////////
+/// defer
+////////
+template <class T>
+inline void
+epoch::
+defer(const T* p) {
+
+  if (!p) {
+    return;
+  }
+  retired_.push_back(retired{
+    epoch_.load(std::memory_order_relaxed),
+    p,
+    [](const void* q) { delete static_cast<const T*>(q); }
+  });
+}
+
+////////
+/// reclaim
+////////
+inline void
+epoch::
+reclaim() {
+
+  ////////
+  /// readers announcing e may hold anything retired at e or later
+  ////////
+  uint64_t oldest = epoch_.load();
+  for (size_t i = 0; i < slots_; ++i) {
+    const uint64_t v = slot_[i].value.load();
+    if (v && v != free_ && v < oldest) {
+      oldest = v;
+    }
+  }
+  size_t kept = 0;
+  for (size_t i = 0; i < retired_.size(); ++i) {
+    if (retired_[i].epoch < oldest) {
+      retired_[i].deleter(retired_[i].p);
+    }
+    else {
+      retired_[kept++] = retired_[i];
+    }
+  }
+  retired_.resize(kept);
+}
+
+////////
+/// pending
+////////
+inline size_t
+epoch::
+pending() const {
+  return retired_.size();
+}
+
+}
@@ -0,0 +1,168 @@
+#include <cstdlib>
+#include <chrono>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include <fs.hpp>
+#include <config.hpp>
+
+////////
+/// nanoseconds per op between two points
+////////
+static double
+per_op(std::chrono::steady_clock::time_point a,
+       std::chrono::steady_clock::time_point b,
+       double ops) {
+  return std::chrono::duration<double, std::nano>(b - a).count() / ops;
+}
+
+////////
+/// one key count: the std::map layout config used to have [one map
+/// per type] against flat_store, same keys, same random lookups
+////////
+static void
+lookups(size_t n,
+        size_t queries,
+        unsigned seed) {
+
+  std::vector<std::string> keys;
+  for (size_t i = 0; i < n; ++i) {
+    keys.push_back("order_tracker.section" + std::to_string(i % 17) +
+                   ".key_" + std::to_string(i));
+  }
+  std::mt19937 rng(seed);
+  std::vector<size_t> q(queries);
+  for (size_t i = 0; i < q.size(); ++i) {
+    q[i] = rng() % n;
+  }
+  std::map<std::string, int> ints;
+  std::map<std::string, std::string> strings;
+  support::flat_store store;
+  long sum = 0;
+
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; ++i) {
+    ints.insert_or_assign(keys[i], int(i));
+    strings.insert_or_assign(keys[i], keys[i]);
+  }
+  std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; ++i) {
+    store.assign(keys[i], int(i));
+    store.assign(keys[i], keys[i]);
+  }
+  std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < q.size(); ++i) {
+    std::map<std::string, int>::const_iterator p = ints.find(keys[q[i]]);
+    sum += p == ints.end() ? 0 : p->second;
+  }
+  std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < q.size(); ++i) {
+    const support::flat_store::slot* s =
+      store.find(support::flat_store::type_t::integer, keys[q[i]]);
+    sum += s ? store.integer(*s) : 0;
+  }
+  std::chrono::steady_clock::time_point t4 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < q.size(); ++i) {
+    std::map<std::string, std::string>::const_iterator p =
+      strings.find(keys[q[i]]);
+    sum += p == strings.end() ? 0 : std::string(p->second).size();
+  }
+  std::chrono::steady_clock::time_point t5 = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < q.size(); ++i) {
+    const support::flat_store::slot* s =
+      store.find(support::flat_store::type_t::string, keys[q[i]]);
+    sum += s ? std::string(store.text(*s)).size() : 0;
+  }
+  std::chrono::steady_clock::time_point t6 = std::chrono::steady_clock::now();
+
+  ////////
+  /// string finds copy out, as find<std::string> does
+  ////////
+  std::cout << n << " keys, ns/op map/flat: insert "
+            << per_op(t0, t1, 2 * n) << " / " << per_op(t1, t2, 2 * n)
+            << ", find<int> "
+            << per_op(t2, t3, q.size()) << " / " << per_op(t3, t4, q.size())
+            << ", find<string> "
+            << per_op(t4, t5, q.size()) << " / " << per_op(t5, t6, q.size())
+            << " [" << sum % 7 << "]" << std::endl;
+}
+
+////////
+/// config init of a generated n key json file
+////////
+static bool
+load(size_t n,
+     const std::string& file) {
+
+  {
+    std::ofstream out(file);
+    out << "{\n  \"order_tracker\": {\n";
+    for (size_t i = 0; i < n; ++i) {
+      out << "    \"key_" << i << "\": ";
+      if (i % 3 == 0)      out << i;
+      else if (i % 3 == 1) out << "\"value_" << i << "\"";
+      else                 out << (i & 1 ? "true" : "false");
+      out << (i + 1 < n ? ",\n" : "\n");
+    }
+    out << "  }\n}\n";
+  }
+  support::error_code err;
+  const std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  const bool ok = support::config::instance().init(err, file);
+  const std::chrono::steady_clock::time_point end =
+    std::chrono::steady_clock::now();
+  if (!ok) {
+    std::cout << err;
+    return false;
+  }
+  std::cout << "init " << n << " keys: "
+            << std::chrono::duration<double, std::milli>(end - start).count()
+            << "ms" << std::endl;
+  return true;
+}
+
+int main(int argc, char** argv) {
+
+  ////////
+  /// -k n -> key count [repeatable; replaces the default 32, 256, 5000]
+  /// -q n -> random lookups per key count
+  /// -j n -> also time config init of a generated n key json file
+  /// -d f -> where the json file goes
+  /// -s n -> seed
+  ////////
+  std::vector<size_t> counts;
+  size_t queries = 1000000;
+  size_t json = 5000;
+  std::string file = "/tmp/fb.json";
+  unsigned seed = 1;
+  int c;
+  while ((c = ::getopt(argc, argv, "k:q:j:d:s:")) != -1) {
+    if (c == 'k')      counts.push_back(::atol(optarg));
+    else if (c == 'q') queries = ::atol(optarg);
+    else if (c == 'j') json = ::atol(optarg);
+    else if (c == 'd') file = optarg;
+    else if (c == 's') seed = ::atoi(optarg);
+    else {
+      std::cout << "Usage: <" << argv[0] << "> [-k keys] [-q queries] "
+                << "[-j keys] [-d file] [-s seed]" << std::endl;
+      return -1;
+    }
+  }
+  if (counts.empty()) {
+    counts = { 32, 256, 5000 };
+  }
+  for (size_t i = 0; i < counts.size(); ++i) {
+    if (counts[i]) {
+      lookups(counts[i], queries, seed);
+    }
+  }
+  if (json && !load(json, file)) {
+    return -1;
+  }
+  return 0;
+}
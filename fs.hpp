@@ -0,0 +1,269 @@
+#ifndef __EXP_FLAT_STORE_HPP__
+#define __EXP_FLAT_STORE_HPP__
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+#include <memory>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ec.hpp>
+
+namespace support {
+
+////////
+/// open addressed store of typed values
+/// - one slot array [linear probing, power of two, at most half
+///   full], one value array in insertion order and one char array
+///   holding every key and string value
+/// - an entry's index into the value array is stable, so at(index)
+///   reads a value w/o hashing [see config::handle]
+/// - a slot is identified by type + key, so "k" may hold a bool and
+///   an int at the same time, as separate typed maps would
+/// - hashes are computed once per key and kept in the slot; probing
+///   compares hashes before bytes
+/// - no erase; a string value that outgrows its bytes is appended
+///   and the old bytes are left behind until the next rehash
+/// - the three arrays hold no pointers, so save writes them as one
+///   image and map uses a mapped image in place; the first assign
+///   copies a mapped store into its own arrays
+/// - not thread safe
+/// - fb.cpp times lookups against the std::map layout it replaced
+////////
+class flat_store {
+public:
+
+  ////////
+  /// value types; none marks an empty slot
+  ////////
+  enum class type_t : uint8_t { none, boolean, integer, real, string };
+
+  ////////
+  /// 8 bytes; strings are offset + size in chars
+  ////////
+  union value {
+    uint32_t  boolean;
+    int32_t   integer;
+    float     real;
+    struct {
+      uint32_t  offset;
+      uint32_t  size;
+    } string;
+  };
+
+  ////////
+  /// 24 bytes, no pointers; index is the entry's insertion order and
+  /// its value's position, neither changes on a rehash
+  ////////
+  struct slot {
+    uint64_t  hash;
+    uint32_t  key;        /// offset into chars
+    uint32_t  key_size;
+    type_t    type;
+    uint8_t   pad[3];
+    uint32_t  index;
+  };
+
+  ////////
+  /// semantics ->
+  /// - room for capacity entries w/o a rehash
+  ////////
+  flat_store(size_t capacity = 32);
+
+  ////////
+  /// semantics ->
+  /// - copies o's arrays; a mapped o's image is shared, not copied
+  ////////
+  flat_store(const flat_store& o);
+  flat_store& operator=(const flat_store&) = delete;
+
+  ////////
+  /// type semantics ->
+  /// - type_t for bool, int, float and std::string [or views]
+  ////////
+  template <class T>
+  static constexpr type_t type_of();
+
+  ////////
+  /// hash semantics ->
+  /// - 64 bit fnv-1a of key mixed w/ type; never zero
+  ////////
+  static constexpr uint64_t hash(type_t type, std::string_view key);
+
+  ////////
+  /// find semantics ->
+  /// - slot of type + key or null
+  ////////
+  const slot* find(type_t type, std::string_view key) const;
+  const slot* find(type_t type, std::string_view key, uint64_t hash) const;
+
+  ////////
+  /// assign semantics ->
+  /// - inserts or overwrites key's T value
+  /// - true if inserted, false if assigned
+  ////////
+  template <class T>
+  bool assign(std::string_view key, const T& v);
+
+  ////////
+  /// merge semantics ->
+  /// - assigns every entry of o, in o's insertion order
+  ////////
+  void merge(const flat_store& o);
+
+  ////////
+  /// semantics ->
+  /// - values and key of a slot; text views chars, valid until the
+  ///   next assign
+  ////////
+  bool boolean(const slot& s) const;
+  int integer(const slot& s) const;
+  float real(const slot& s) const;
+  std::string_view text(const slot& s) const;
+  std::string_view key(const slot& s) const;
+
+  ////////
+  /// at semantics ->
+  /// - value of the entry w/ index; no hashing, no compare
+  ////////
+  const value& at(uint32_t index) const;
+
+  ////////
+  /// semantics ->
+  /// - string value's view of chars
+  ////////
+  std::string_view text(const value& v) const;
+
+  ////////
+  /// semantics ->
+  /// - entries
+  ////////
+  size_t size() const;
+
+  ////////
+  /// for_each semantics ->
+  /// - f(slot) for every entry in slot order
+  ////////
+  template <class F>
+  void for_each(F f) const;
+
+  ////////
+  /// save semantics ->
+  /// - writes a versioned, checksummed image of the store to
+  ///   <file>.tmp and renames it over file
+  /// - source is the caller's stamp of what the store was built from
+  /// - false w/ err set if the file couldn't be written
+  ////////
+  bool save(support::error_code& err,
+            const std::string& file,
+            uint64_t source) const;
+
+  ////////
+  /// map semantics ->
+  /// - maps file read only and replaces the store's contents w/ it
+  /// - false w/ err set, store untouched, if the file is missing,
+  ///   has another version, layout or source, or fails its checksum
+  ////////
+  bool map(support::error_code& err,
+           const std::string& file,
+           uint64_t source);
+
+  ////////
+  /// semantics ->
+  /// - true if contents are a mapped image
+  ////////
+  bool mapped() const;
+
+private:
+
+  ////////
+  /// semantics ->
+  /// - slot for hash + key, empty if absent
+  ////////
+  size_t probe(type_t type, std::string_view key, uint64_t hash) const;
+
+  ////////
+  /// semantics ->
+  /// - offset of a copy of s in chars_
+  ////////
+  uint32_t intern(std::string_view s);
+
+  ////////
+  /// semantics ->
+  /// - doubles the slots and repacks chars_ w/o dead bytes
+  ////////
+  void rehash();
+
+  ////////
+  /// semantics ->
+  /// - copies a mapped image into the owned arrays
+  ////////
+  void own();
+
+  ////////
+  /// semantics ->
+  /// - points the read side at the owned arrays
+  ////////
+  void sync();
+
+  ////////
+  /// semantics ->
+  /// - 64 bit checksum of n bytes, 8 at a time
+  ////////
+  static uint64_t checksum(const char* p, size_t n);
+
+  ////////
+  /// image layout; arrays follow at 8 byte aligned offsets
+  ////////
+  struct header {
+    char      magic[8];
+    uint32_t  version;
+    uint32_t  slot_bytes;   /// sizeof(slot), catches layout changes
+    uint64_t  source;
+    uint64_t  slots;
+    uint64_t  values;
+    uint64_t  chars;
+    uint64_t  dead;
+    uint64_t  checksum;     /// of everything after the header
+  };
+
+  static const uint32_t version_ = 1;
+
+  ////////
+  /// a mapped image, unmapped w/ the last store sharing it
+  ////////
+  struct image {
+    ~image();
+    void*   p;
+    size_t  n;
+  };
+
+  ////////
+  /// reads go through the pointers; they view the owned arrays or
+  /// a mapped image
+  ////////
+  const slot*                   slot_;
+  const value*                  value_;
+  const char*                   char_;
+  size_t                        slot_count_;
+  size_t                        char_count_;
+  std::vector<slot>             slots_;
+  std::vector<value>            values_;   /// by slot index
+  std::vector<char>             chars_;
+  std::shared_ptr<const image>  image_;
+  size_t                        size_;
+  size_t                        dead_;     /// unreferenced bytes in chars
+};
+
+}
+
+#include <fs.ipp>
+
+#endif
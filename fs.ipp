@@ -0,0 +1,574 @@
+namespace support {
+
+////////
+/// constructor
+////////
+inline
+flat_store::
+flat_store(size_t capacity) :
+  size_(0),
+  dead_(0) {
+
+  size_t n = 16;
+  while (n < capacity * 2) {
+    n *= 2;
+  }
+  slots_.resize(n);
+  std::memset(slots_.data(), 0, n * sizeof(slot));
+  values_.reserve(capacity);
+  sync();
+}
+
+////////
+/// copy constructor
+////////
+inline
+flat_store::
+flat_store(const flat_store& o) :
+  slot_      (o.slot_),
+  value_     (o.value_),
+  char_      (o.char_),
+  slot_count_(o.slot_count_),
+  char_count_(o.char_count_),
+  slots_     (o.slots_),
+  values_    (o.values_),
+  chars_     (o.chars_),
+  image_     (o.image_),
+  size_      (o.size_),
+  dead_      (o.dead_) {
+
+  if (!image_) {
+    sync();
+  }
+}
+
+////////
+/// type of
+////////
+template <class T>
+inline constexpr flat_store::type_t
+flat_store::
+type_of() {
+
+  if constexpr (std::is_same_v<T, bool>) {
+    return type_t::boolean;
+  }
+  else if constexpr (std::is_same_v<T, int>) {
+    return type_t::integer;
+  }
+  else if constexpr (std::is_same_v<T, float>) {
+    return type_t::real;
+  }
+  else if constexpr (std::is_same_v<T, std::string> ||
+                     std::is_same_v<T, std::string_view>) {
+    return type_t::string;
+  }
+  else {
+    return type_t::none;
+  }
+}
+
+////////
+/// hash
+////////
+inline constexpr uint64_t
+flat_store::
+hash(type_t type,
+     std::string_view key) {
+
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < key.size(); ++i) {
+    h ^= static_cast<unsigned char>(key[i]);
+    h *= 0x100000001b3ULL;
+  }
+  h ^= static_cast<uint64_t>(type) * 0x9e3779b97f4a7c15ULL;
+  return h ? h : 1;
+}
+
+////////
+/// find
+////////
+inline const flat_store::slot*
+flat_store::
+find(type_t type,
+     std::string_view key) const {
+  return find(type, key, hash(type, key));
+}
+
+////////
+/// find [hashed]
+////////
+inline const flat_store::slot*
+flat_store::
+find(type_t type,
+     std::string_view key,
+     uint64_t h) const {
+  const slot& s = slot_[probe(type, key, h)];
+  return s.hash ? &s : nullptr;
+}
+
+////////
+/// assign
+////////
+template <class T>
+inline bool
+flat_store::
+assign(std::string_view key,
+       const T& v) {
+
+  constexpr type_t type = type_of<T>();
+  static_assert(type != type_t::none, "bool, int, float or string only");
+
+  own();
+  const uint64_t h = hash(type, key);
+  size_t i = probe(type, key, h);
+  const bool inserted = !slots_[i].hash;
+  if (inserted) {
+    if ((size_ + 1) * 2 > slots_.size()) {
+      rehash();
+      i = probe(type, key, h);
+    }
+    const uint32_t k = intern(key);
+    slot& s = slots_[i];
+    s.hash     = h;
+    s.key      = k;
+    s.key_size = key.size();
+    s.type     = type;
+    s.index    = size_++;
+    values_.push_back(value());
+    values_.back().string.offset = 0;
+    values_.back().string.size   = 0;
+  }
+  value& s = values_[slots_[i].index];
+  if constexpr (type == type_t::boolean) {
+    s.boolean = v;
+  }
+  else if constexpr (type == type_t::integer) {
+    s.integer = v;
+  }
+  else if constexpr (type == type_t::real) {
+    s.real = v;
+  }
+  else {
+    ////////
+    /// overwrite in place when the new value fits
+    ////////
+    const std::string_view t(v);
+    if (!inserted && t.size() <= s.string.size) {
+      std::memcpy(chars_.data() + s.string.offset, t.data(), t.size());
+      dead_ += s.string.size - t.size();
+    }
+    else {
+      dead_ += s.string.size;
+      s.string.offset = intern(t);
+    }
+    s.string.size = t.size();
+  }
+  sync();
+  return inserted;
+}
+
+////////
+/// merge
+////////
+inline void
+flat_store::
+merge(const flat_store& o) {
+
+  std::vector<const slot*> order(o.size_);
+  o.for_each([&order](const slot& s) { order[s.index] = &s; });
+  for (const slot* s : order) {
+    switch (s->type) {
+    case type_t::boolean:
+      assign<bool>(o.key(*s), o.boolean(*s));
+      break;
+    case type_t::integer:
+      assign<int>(o.key(*s), o.integer(*s));
+      break;
+    case type_t::real:
+      assign<float>(o.key(*s), o.real(*s));
+      break;
+    case type_t::string:
+      assign<std::string_view>(o.key(*s), o.text(*s));
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+////////
+/// boolean
+////////
+inline bool
+flat_store::
+boolean(const slot& s) const {
+  return value_[s.index].boolean;
+}
+
+////////
+/// integer
+////////
+inline int
+flat_store::
+integer(const slot& s) const {
+  return value_[s.index].integer;
+}
+
+////////
+/// real
+////////
+inline float
+flat_store::
+real(const slot& s) const {
+  return value_[s.index].real;
+}
+
+////////
+/// text
+////////
+inline std::string_view
+flat_store::
+text(const slot& s) const {
+  return text(value_[s.index]);
+}
+
+////////
+/// text [value]
+////////
+inline std::string_view
+flat_store::
+text(const value& v) const {
+  return std::string_view(char_ + v.string.offset, v.string.size);
+}
+
+////////
+/// at
+////////
+inline const flat_store::value&
+flat_store::
+at(uint32_t index) const {
+  return value_[index];
+}
+
+////////
+/// key
+////////
+inline std::string_view
+flat_store::
+key(const slot& s) const {
+  return std::string_view(char_ + s.key, s.key_size);
+}
+
+////////
+/// size
+////////
+inline size_t
+flat_store::
+size() const {
+  return size_;
+}
+
+////////
+/// for each
+////////
+template <class F>
+inline void
+flat_store::
+for_each(F f) const {
+  for (size_t i = 0; i < slot_count_; ++i) {
+    if (slot_[i].hash) {
+      f(slot_[i]);
+    }
+  }
+}
+
+////////
+/// save
+////////
+inline bool
+flat_store::
+save(support::error_code& err,
+     const std::string& file,
+     uint64_t source) const {
+
+  auto align = [](size_t n) { return (n + 7) & ~size_t(7); };
+
+  const size_t slots  = slot_count_ * sizeof(slot);
+  const size_t values = size_ * sizeof(value);
+  std::string body(align(slots) + align(values) + align(char_count_), '\0');
+  std::memcpy(&body[0], slot_, slots);
+  std::memcpy(&body[align(slots)], value_, values);
+  std::memcpy(&body[align(slots) + align(values)], char_, char_count_);
+
+  header h;
+  std::memcpy(h.magic, "EXPCFG\0\0", sizeof(h.magic));
+  h.version    = version_;
+  h.slot_bytes = sizeof(slot);
+  h.source     = source;
+  h.slots      = slot_count_;
+  h.values     = size_;
+  h.chars      = char_count_;
+  h.dead       = dead_;
+  h.checksum   = checksum(body.data(), body.size());
+
+  const std::string tmp = file + ".tmp";
+  const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    err.append(-1, "Failed to open config image: <:" + tmp + ">");
+    return false;
+  }
+  const char* parts[] = { reinterpret_cast<const char*>(&h), body.data() };
+  const size_t sizes[] = { sizeof(h), body.size() };
+  bool ok = true;
+  for (size_t i = 0; ok && i < 2; ++i) {
+    size_t done = 0;
+    while (done < sizes[i]) {
+      const ssize_t n = ::write(fd, parts[i] + done, sizes[i] - done);
+      if (n == -1 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        ok = false;
+        break;
+      }
+      done += n;
+    }
+  }
+  ::close(fd);
+  if (!ok || std::rename(tmp.c_str(), file.c_str())) {
+    ::unlink(tmp.c_str());
+    err.append(-1, "Failed to write config image: <:" + file + ">");
+    return false;
+  }
+  return true;
+}
+
+////////
+/// map
+////////
+inline bool
+flat_store::
+map(support::error_code& err,
+    const std::string& file,
+    uint64_t source) {
+
+  const int fd = ::open(file.c_str(), O_RDONLY);
+  if (fd == -1) {
+    err.append(-1, "No config image: <:" + file + ">");
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) || size_t(st.st_size) < sizeof(header)) {
+    ::close(fd);
+    err.append(-1, "Bad config image: <:" + file + ">");
+    return false;
+  }
+  void* p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    err.append(-1, "Failed to map config image: <:" + file + ">");
+    return false;
+  }
+  auto img = std::make_shared<image>();
+  img->p = p;
+  img->n = st.st_size;
+
+  ////////
+  /// validate before anything is pointed at the image
+  ////////
+  auto align = [](size_t n) { return (n + 7) & ~size_t(7); };
+  const header& h = *static_cast<const header*>(p);
+  const char* body = static_cast<const char*>(p) + sizeof(header);
+  const size_t size = st.st_size - sizeof(header);
+  if (std::memcmp(h.magic, "EXPCFG\0\0", sizeof(h.magic)) ||
+      h.version != version_ || h.slot_bytes != sizeof(slot)) {
+    err.append(-1, "Config image version mismatch: <:" + file + ">");
+    return false;
+  }
+  if (h.source != source) {
+    err.append(-1, "Stale config image: <:" + file + ">");
+    return false;
+  }
+  if (h.slots < 16 || (h.slots & (h.slots - 1)) || h.values > h.slots / 2 ||
+      h.chars > size ||
+      align(h.slots * sizeof(slot)) + align(h.values * sizeof(value)) +
+      align(h.chars) != size ||
+      checksum(body, size) != h.checksum) {
+    err.append(-1, "Corrupt config image: <:" + file + ">");
+    return false;
+  }
+
+  slot_       = reinterpret_cast<const slot*>(body);
+  value_      = reinterpret_cast<const value*>(
+                  body + align(h.slots * sizeof(slot)));
+  char_       = body + align(h.slots * sizeof(slot)) +
+                align(h.values * sizeof(value));
+  slot_count_ = h.slots;
+  char_count_ = h.chars;
+  size_       = h.values;
+  dead_       = h.dead;
+  image_      = img;
+  slots_.clear();
+  values_.clear();
+  chars_.clear();
+  return true;
+}
+
+////////
+/// mapped
+////////
+inline bool
+flat_store::
+mapped() const {
+  return static_cast<bool>(image_);
+}
+
+////////
+/// probe
+////////
+inline size_t
+flat_store::
+probe(type_t type,
+      std::string_view key,
+      uint64_t h) const {
+
+  const size_t mask = slot_count_ - 1;
+  for (size_t i = h & mask;; i = (i + 1) & mask) {
+    const slot& s = slot_[i];
+    if (!s.hash) {
+      return i;
+    }
+    if (s.hash == h && s.type == type && s.key_size == key.size() &&
+        !std::memcmp(char_ + s.key, key.data(), key.size())) {
+      return i;
+    }
+  }
+}
+
+////////
+/// intern
+/// - key may point into chars_ itself [rehash], so copy w/ care
+////////
+inline uint32_t
+flat_store::
+intern(std::string_view s) {
+
+  const size_t offset = chars_.size();
+  if (chars_.capacity() < offset + s.size()) {
+    std::vector<char> c;
+    c.reserve(std::max(chars_.capacity() * 2, offset + s.size() + 64));
+    c.assign(chars_.begin(), chars_.end());
+    c.insert(c.end(), s.begin(), s.end());
+    chars_.swap(c);
+  }
+  else {
+    chars_.insert(chars_.end(), s.begin(), s.end());
+  }
+  return offset;
+}
+
+////////
+/// rehash
+////////
+inline void
+flat_store::
+rehash() {
+
+  std::vector<slot> slots(slots_.size() * 2);
+  std::memset(slots.data(), 0, slots.size() * sizeof(slot));
+  std::vector<char> chars;
+  chars.reserve(chars_.size() - dead_ + 64);
+
+  const size_t mask = slots.size() - 1;
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    slot s = slots_[i];
+    if (!s.hash) {
+      continue;
+    }
+    const uint32_t k = chars.size();
+    chars.insert(chars.end(), chars_.begin() + s.key,
+                 chars_.begin() + s.key + s.key_size);
+    s.key = k;
+    if (s.type == type_t::string) {
+      value& v = values_[s.index];
+      const uint32_t o = chars.size();
+      chars.insert(chars.end(), chars_.begin() + v.string.offset,
+                   chars_.begin() + v.string.offset + v.string.size);
+      v.string.offset = o;
+    }
+    size_t j = s.hash & mask;
+    while (slots[j].hash) {
+      j = (j + 1) & mask;
+    }
+    slots[j] = s;
+  }
+  slots_.swap(slots);
+  chars_.swap(chars);
+  dead_ = 0;
+  sync();
+}
+
+////////
+/// own
+////////
+inline void
+flat_store::
+own() {
+
+  if (!image_) {
+    return;
+  }
+  slots_.assign(slot_, slot_ + slot_count_);
+  values_.assign(value_, value_ + size_);
+  chars_.assign(char_, char_ + char_count_);
+  image_.reset();
+  sync();
+}
+
+////////
+/// sync
+////////
+inline void
+flat_store::
+sync() {
+  slot_       = slots_.data();
+  value_      = values_.data();
+  char_       = chars_.data();
+  slot_count_ = slots_.size();
+  char_count_ = chars_.size();
+}
+
+////////
+/// checksum
+////////
+inline uint64_t
+flat_store::
+checksum(const char* p,
+         size_t n) {
+
+  uint64_t h = 0x9e3779b97f4a7c15ULL ^ n;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint64_t w;
+    std::memcpy(&w, p + i, sizeof(w));
+    h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    h ^= h >> 32;
+  }
+  for (; i < n; ++i) {
+    h = (h ^ static_cast<unsigned char>(p[i])) * 0x100000001b3ULL;
+  }
+  return h ^ (h >> 29);
+}
+
+////////
+/// image destructor
+////////
+inline
+flat_store::
+image::
+~image() {
+  ::munmap(p, n);
+}
+
+}
@@ -0,0 +1,131 @@
+#ifndef __EXP_FEED_VALIDATOR_HPP__
+#define __EXP_FEED_VALIDATOR_HPP__
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstdint>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ec.hpp>
+
+namespace trade {
+
+////////
+/// validation only scan of a feed file
+/// - applies the same checks as order_tracker::order::init
+///   without building orders or a book
+/// - maps the file and scans newline aligned chunks in parallel
+/// - counts errors by kind and keeps the first offending lines
+////////
+class feed_validator {
+public:
+
+  ////////
+  /// error kinds, one per order::init failure
+  ////////
+  enum class kind_t {
+    invalid_line,     /// no tokens
+    invalid_action,   /// not N, R, M or X
+    token_count,      /// wrong number of tokens for the action
+    empty_field,      /// blank integer field
+    negative_field,   /// integer field not positive
+    invalid_side,     /// not B or S
+    count
+  };
+
+  ////////
+  /// an offending line [1 based]
+  ////////
+  struct offence {
+    size_t  line;
+    kind_t  kind;
+  };
+
+  typedef std::vector<offence> offences;
+
+  ////////
+  /// semantics ->
+  /// - threads 0 means hardware concurrency
+  /// - keeps up to report offending lines
+  ////////
+  feed_validator(const std::string& file,
+                 size_t threads = 0,
+                 size_t report = 10);
+
+  ////////
+  /// exec semantics ->
+  /// - maps file read only
+  /// - splits into one newline aligned chunk per thread
+  /// - validates every line, merges counts and offences in line order
+  /// - returns false only if the file can't be scanned
+  ////////
+  bool exec(support::error_code& err);
+
+  ////////
+  /// true if no line failed validation
+  ////////
+  bool clean() const;
+
+  ////////
+  /// for tracing the report
+  ////////
+  template <class T>
+  friend T& operator<<(T& out, const feed_validator& in);
+
+private:
+
+  static const size_t kinds_ = static_cast<size_t>(kind_t::count);
+
+  ////////
+  /// per chunk results
+  ////////
+  struct chunk {
+    const char*  begin;
+    const char*  end;
+    size_t       lines;
+    size_t       counts[kinds_];
+    offences     first;   /// line numbers relative to the chunk
+  };
+
+  ////////
+  /// semantics ->
+  /// - validates each line of c, counting and recording offences
+  ////////
+  void scan(chunk& c) const;
+
+  ////////
+  /// semantics ->
+  /// - order::init checks on a single line
+  /// - returns false and sets kind on the first failure
+  ////////
+  static bool check(const char* p, const char* e, kind_t& kind);
+
+  ////////
+  /// semantics ->
+  /// - parse_int checks on a trimmed token
+  ////////
+  static bool check_int(const char* p, const char* e, kind_t& kind);
+
+  ////////
+  /// whitespace as boost::trim sees it in the classic locale
+  ////////
+  static bool is_space(char c);
+
+  const std::string  file_;
+  const size_t       threads_;
+  const size_t       report_;
+  size_t             lines_;
+  size_t             counts_[kinds_];
+  offences           first_;
+};
+
+}
+
+#include <fv.ipp>
+
+#endif
@@ -0,0 +1,316 @@
+namespace trade {
+
+////////
+/// constructor
+////////
+inline
+feed_validator::
+feed_validator(const std::string& file,
+               size_t threads,
+               size_t report) :
+  file_(file),
+  threads_(threads ? threads :
+           std::max<size_t>(1, std::thread::hardware_concurrency())),
+  report_(report),
+  lines_(0),
+  counts_() {
+}
+
+////////
+/// execute
+////////
+inline bool
+feed_validator::
+exec(support::error_code& err) {
+
+  ////////
+  /// map the whole file read only
+  ////////
+  int fd = ::open(file_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    err = support::error_code(-1, "Bad input file: <:" + file_ + ">");
+    return false;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) < 0) {
+    ::close(fd);
+    err = support::error_code(-1, "Cannot stat input file: <:" + file_ + ">");
+    return false;
+  }
+  const size_t size = st.st_size;
+  if (!size) {
+    ::close(fd);
+    return true;
+  }
+  void* base = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (base == MAP_FAILED) {
+    err = support::error_code(-1, "Cannot map input file: <:" + file_ + ">");
+    return false;
+  }
+  ::madvise(base, size, MADV_SEQUENTIAL);
+
+  ////////
+  /// newline aligned chunks, none smaller than 1MB
+  ////////
+  const char* p = static_cast<const char*>(base);
+  const char* e = p + size;
+  const size_t n = std::min(threads_, size / (1 << 20) + 1);
+  std::vector<chunk> chunks(n);
+
+  const char* b = p;
+  for (size_t i = 0; i < n; ++i) {
+    chunk& c = chunks[i];
+    c.begin = b;
+    c.end   = e;
+    if (i + 1 < n) {
+      const char* t = std::max(b, p + size / n * (i + 1));
+      const char* nl = static_cast<const char*>(::memchr(t, '\n', e - t));
+      c.end = nl ? nl + 1 : e;
+    }
+    c.lines = 0;
+    std::fill(c.counts, c.counts + kinds_, 0);
+    b = c.end;
+  }
+  ////////
+  /// scan chunks in parallel; this thread takes the first
+  ////////
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < n; ++i) {
+    workers.emplace_back(&feed_validator::scan, this, std::ref(chunks[i]));
+  }
+  scan(chunks[0]);
+  for (size_t i = 0; i < workers.size(); ++i) {
+    workers[i].join();
+  }
+  ::munmap(base, size);
+
+  ////////
+  /// merge in chunk order - line numbers become absolute
+  ////////
+  for (size_t i = 0; i < n; ++i) {
+    const chunk& c = chunks[i];
+    for (size_t k = 0; k < kinds_; ++k) {
+      counts_[k] += c.counts[k];
+    }
+    for (size_t j = 0; j < c.first.size() && first_.size() < report_; ++j) {
+      first_.push_back(offence{lines_ + c.first[j].line, c.first[j].kind});
+    }
+    lines_ += c.lines;
+  }
+  return true;
+}
+
+////////
+/// clean
+////////
+inline bool
+feed_validator::
+clean() const {
+  for (size_t k = 0; k < kinds_; ++k) {
+    if (counts_[k]) return false;
+  }
+  return true;
+}
+
+////////
+/// scan
+////////
+inline void
+feed_validator::
+scan(chunk& c) const {
+
+  const char* p = c.begin;
+  while (p < c.end) {
+
+    ////////
+    /// getline semantics - a trailing newline ends the last line
+    ////////
+    const char* nl = static_cast<const char*>(::memchr(p, '\n', c.end - p));
+    const char* e = nl ? nl : c.end;
+    ++c.lines;
+
+    kind_t kind;
+    if (!check(p, e, kind)) {
+      ++c.counts[static_cast<size_t>(kind)];
+      if (c.first.size() < report_) {
+        c.first.push_back(offence{c.lines, kind});
+      }
+    }
+    p = e + 1;
+  }
+}
+
+////////
+/// is space
+////////
+inline bool
+feed_validator::
+is_space(char c) {
+  return c == ' '  || c == '\t' || c == '\n' ||
+         c == '\v' || c == '\f' || c == '\r';
+}
+
+////////
+/// check
+////////
+inline bool
+feed_validator::
+check(const char* p,
+      const char* e,
+      kind_t& kind) {
+
+  ////////
+  /// split on ',' dropping empty tokens [boost::char_separator]
+  /// and trim each; only the first six are kept
+  ////////
+  const char* tb[6];
+  const char* te[6];
+  size_t size = 0;
+
+  while (p < e) {
+    if (*p == ',') {
+      ++p;
+      continue;
+    }
+    const char* s = p;
+    while (p < e && *p != ',') ++p;
+    if (size < 6) {
+      const char* b = s;
+      const char* t = p;
+      while (b < t && is_space(*b)) ++b;
+      while (t > b && is_space(t[-1])) --t;
+      tb[size] = b;
+      te[size] = t;
+    }
+    ++size;
+  }
+  ////////
+  /// must be able to see action
+  ////////
+  if (!size) {
+    kind = kind_t::invalid_line;
+    return false;
+  }
+  if (te[0] - tb[0] != 1 ||
+      (*tb[0] != 'N' && *tb[0] != 'R' && *tb[0] != 'M' && *tb[0] != 'X')) {
+    kind = kind_t::invalid_action;
+    return false;
+  }
+  const char action = *tb[0];
+
+  ////////
+  /// each action has a different number of tokens
+  ////////
+  const size_t want = action == 'N' ? 6 : action == 'X' ? 4 : 5;
+  if (size != want) {
+    kind = kind_t::token_count;
+    return false;
+  }
+  size_t i = 1;
+  if (action == 'X') {
+    return check_int(tb[1], te[1], kind) &&
+           check_int(tb[2], te[2], kind) &&
+           check_int(tb[3], te[3], kind);
+  }
+  ////////
+  /// product id for new, then order id
+  ////////
+  if (action == 'N') {
+    if (!check_int(tb[i], te[i], kind)) return false;
+    ++i;
+  }
+  if (!check_int(tb[i], te[i], kind)) return false;
+  ++i;
+
+  ////////
+  /// followed by side (buy or sell)
+  ////////
+  if (te[i] - tb[i] != 1 || (*tb[i] != 'B' && *tb[i] != 'S')) {
+    kind = kind_t::invalid_side;
+    return false;
+  }
+  ++i;
+
+  ////////
+  /// followed by quantity and price
+  ////////
+  return check_int(tb[i], te[i], kind) &&
+         check_int(tb[i + 1], te[i + 1], kind);
+}
+
+////////
+/// check int
+////////
+inline bool
+feed_validator::
+check_int(const char* p,
+          const char* e,
+          kind_t& kind) {
+
+  if (p == e) {
+    kind = kind_t::empty_field;
+    return false;
+  }
+  ////////
+  /// ::atoi semantics - sign, leading digits, long clamp, int narrowing
+  ////////
+  bool negative = false;
+  if (*p == '+' || *p == '-') {
+    negative = *p == '-';
+    ++p;
+  }
+  unsigned long long v = 0;
+  const unsigned long long limit =
+    static_cast<unsigned long long>(LONG_MAX) + (negative ? 1 : 0);
+  for (; p < e && *p >= '0' && *p <= '9'; ++p) {
+    v = v * 10 + (*p - '0');
+    if (v > limit) {
+      v = limit;
+      for (; p < e && *p >= '0' && *p <= '9'; ++p) {}
+      break;
+    }
+  }
+  const long l = negative ? static_cast<long>(0ULL - v) : static_cast<long>(v);
+  if (static_cast<int>(l) <= 0) {
+    kind = kind_t::negative_field;
+    return false;
+  }
+  return true;
+}
+
+////////
+/// operator<< (feed_validator)
+////////
+template <class T>
+T& operator<<(T& out, const feed_validator& in) {
+
+  static const char* names[] = {
+    "invalid line",
+    "invalid action",
+    "invalid token count",
+    "empty field",
+    "negative field",
+    "invalid side"
+  };
+
+  size_t errors = 0;
+  for (size_t k = 0; k < feed_validator::kinds_; ++k) {
+    errors += in.counts_[k];
+  }
+  out << "Lint <" << in.file_ << ">: lines " << in.lines_
+      << ", errors " << errors << std::endl;
+
+  for (size_t k = 0; k < feed_validator::kinds_; ++k) {
+    if (in.counts_[k]) {
+      out << "  " << names[k] << ": " << in.counts_[k] << std::endl;
+    }
+  }
+  for (size_t i = 0; i < in.first_.size(); ++i) {
+    out << "  line " << in.first_[i].line << ": "
+        << names[static_cast<size_t>(in.first_[i].kind)] << std::endl;
+  }
+  return out;
+}
+
+}
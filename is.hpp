@@ -0,0 +1,180 @@
+#ifndef __EXP_INPUT_SOURCE_HPP__
+#define __EXP_INPUT_SOURCE_HPP__
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ec.hpp>
+#include <af.hpp>
+
+////////
+/// compressed input is compiled in when its library is around;
+/// link w/ -lz and/or -lzstd accordingly
+////////
+#if __has_include(<zlib.h>)
+#include <zlib.h>
+#define __EXP_SOURCE_GZIP__ 1
+#endif
+
+#if __has_include(<zstd.h>)
+#include <zstd.h>
+#define __EXP_SOURCE_ZSTD__ 1
+#endif
+
+namespace support {
+
+////////
+/// line oriented input file
+/// - plain, gzip or zstd; detected from the file's magic bytes
+/// - a reader thread reads [and decompresses] into one of two
+///   buffers while the caller splits lines out of the other
+/// - getline behaves like std::getline on the uncompressed text
+////////
+class source {
+public:
+
+  ////////
+  /// file formats
+  ////////
+  enum class format_t { plain, gzip, zstd };
+
+  ////////
+  /// semantics ->
+  /// - nothing is opened until open()
+  /// - buffer_size bytes of decompressed text per buffer
+  /// - reader thread pinned to cpu [best effort]; -1 -> any
+  ////////
+  source(const std::string& file,
+         size_t buffer_size = 1 << 20,
+         int cpu = -1);
+
+  ////////
+  /// semantics ->
+  /// - stops and joins the reader thread, closes the file
+  ////////
+  ~source();
+
+  ////////
+  /// copy/move disabled
+  ////////
+  source(const source&) = delete;
+  source& operator=(const source&) = delete;
+
+  ////////
+  /// open semantics ->
+  /// - fails if the file can't be opened or its format isn't
+  ///   compiled in
+  /// - starts the reader thread
+  ////////
+  bool open(error_code& err);
+
+  ////////
+  /// getline semantics ->
+  /// - next line w/o its newline; a last line w/o newline counts
+  /// - false at end of input or once the reader failed
+  ////////
+  bool getline(std::string& line);
+
+  ////////
+  /// good semantics ->
+  /// - false w/ the failure appended to err if reading or decompressing
+  ///   failed; earlier errors in err are kept
+  ////////
+  bool good(error_code& err) const;
+
+  ////////
+  /// detected format
+  ////////
+  format_t format() const;
+
+  ////////
+  /// semantics ->
+  /// - true if format f was compiled in
+  ////////
+  static bool supported(format_t f);
+
+private:
+
+  ////////
+  /// one decompressed buffer; full is owned by the reader until set
+  ////////
+  struct buffer {
+    std::vector<char>  data;
+    size_t             size;
+    bool               full;
+    bool               last;  /// end of input [or error] after it
+  };
+
+  ////////
+  /// reader thread body
+  ////////
+  void run();
+
+  ////////
+  /// semantics ->
+  /// - fills b w/ up to buffer_size bytes of text, sets b.last at end
+  /// - false w/ error_ set on failure
+  ////////
+  bool fill(buffer& b);
+
+  ////////
+  /// semantics ->
+  /// - refills compressed input once it's consumed
+  /// - false on read error
+  ////////
+  bool refill();
+
+  ////////
+  /// hand the caller's buffer back / wait for the next one
+  ////////
+  void release();
+  void acquire();
+
+  const std::string        file_;
+  const size_t             buffer_size_;
+  const int                cpu_;
+  int                      fd_;
+  format_t                 format_;
+
+  buffer                   buffers_[2];
+  size_t                   current_;   /// caller's buffer
+  size_t                   pos_;       /// caller's offset in it
+  bool                     held_;
+  bool                     done_;
+
+  std::mutex               mutex_;
+  std::condition_variable  cond_;
+  bool                     stop_;
+  std::string              error_;
+  std::thread              thread_;
+
+  ////////
+  /// compressed input
+  ////////
+  std::vector<char>        in_;
+  size_t                   in_pos_;
+  size_t                   in_size_;
+  bool                     in_eof_;
+  bool                     in_frame_;  /// inside a compressed stream
+
+#ifdef __EXP_SOURCE_GZIP__
+  z_stream                 zlib_;
+  bool                     zlib_open_;
+#endif
+#ifdef __EXP_SOURCE_ZSTD__
+  ZSTD_DStream*            zstd_;
+#endif
+};
+
+}
+
+#include <is.ipp>
+
+#endif
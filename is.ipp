@@ -0,0 +1,379 @@
+namespace support {
+
+////////
+/// constructor
+////////
+inline
+source::
+source(const std::string& file,
+       size_t buffer_size,
+       int cpu) :
+  file_       (file),
+  buffer_size_(buffer_size ? buffer_size : 1),
+  cpu_        (cpu),
+  fd_         (-1),
+  format_     (format_t::plain),
+  current_    (0),
+  pos_        (0),
+  held_       (false),
+  done_       (false),
+  stop_       (false),
+  in_pos_     (0),
+  in_size_    (0),
+  in_eof_     (false),
+  in_frame_   (false) {
+
+  for (size_t i = 0; i < 2; ++i) {
+    buffers_[i].size = 0;
+    buffers_[i].full = false;
+    buffers_[i].last = false;
+  }
+#ifdef __EXP_SOURCE_GZIP__
+  zlib_open_ = false;
+#endif
+#ifdef __EXP_SOURCE_ZSTD__
+  zstd_ = nullptr;
+#endif
+}
+
+////////
+/// destructor
+////////
+inline
+source::
+~source() {
+
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+  }
+  if (fd_ != -1) {
+    ::close(fd_);
+  }
+#ifdef __EXP_SOURCE_GZIP__
+  if (zlib_open_) {
+    inflateEnd(&zlib_);
+  }
+#endif
+#ifdef __EXP_SOURCE_ZSTD__
+  ZSTD_freeDStream(zstd_);
+#endif
+}
+
+////////
+/// open
+////////
+inline bool
+source::
+open(error_code& err) {
+
+  fd_ = ::open(file_.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    err = error_code(-1, "Bad input file: <:" + file_ + ">");
+    return false;
+  }
+  ////////
+  /// sniff the magic bytes; they stay in the input buffer
+  ////////
+  in_.resize(buffer_size_ < (1 << 16) ? (1 << 16) : buffer_size_);
+  if (!refill()) {
+    err = error_code(-1, "Failed to read input file: <:" + file_ + ">");
+    return false;
+  }
+  const unsigned char* m =
+    reinterpret_cast<const unsigned char*>(in_.data());
+  if (in_size_ >= 2 && m[0] == 0x1f && m[1] == 0x8b) {
+    format_ = format_t::gzip;
+  }
+  else if (in_size_ >= 4 && m[0] == 0x28 && m[1] == 0xb5 &&
+           m[2] == 0x2f && m[3] == 0xfd) {
+    format_ = format_t::zstd;
+  }
+  if (!supported(format_)) {
+    err = error_code(-1, std::string("Unsupported input format: <:") +
+                     (format_ == format_t::gzip ? "gzip" : "zstd") +
+                     "> in file <:" + file_ + ">");
+    return false;
+  }
+#ifdef __EXP_SOURCE_GZIP__
+  if (format_ == format_t::gzip) {
+    std::memset(&zlib_, 0, sizeof(zlib_));
+
+    ////////
+    /// 15 + 32 -> max window, gzip or zlib header detected
+    ////////
+    if (inflateInit2(&zlib_, 15 + 32) != Z_OK) {
+      err = error_code(-1, "Failed to initialize gzip decoder");
+      return false;
+    }
+    zlib_open_ = true;
+  }
+#endif
+#ifdef __EXP_SOURCE_ZSTD__
+  if (format_ == format_t::zstd) {
+    zstd_ = ZSTD_createDStream();
+    if (!zstd_ || ZSTD_isError(ZSTD_initDStream(zstd_))) {
+      err = error_code(-1, "Failed to initialize zstd decoder");
+      return false;
+    }
+  }
+#endif
+  for (size_t i = 0; i < 2; ++i) {
+    buffers_[i].data.resize(buffer_size_);
+  }
+  thread_ = std::thread(&source::run, this);
+  return true;
+}
+
+////////
+/// getline
+////////
+inline bool
+source::
+getline(std::string& line) {
+
+  line.clear();
+  bool any = false;
+  while (!done_) {
+    if (!held_) {
+      acquire();
+    }
+    buffer& b = buffers_[current_];
+    const char* s = b.data.data() + pos_;
+    const char* e = b.data.data() + b.size;
+    const char* n = static_cast<const char*>(std::memchr(s, '\n', e - s));
+    if (n) {
+      line.append(s, n);
+      pos_ = n - b.data.data() + 1;
+      return true;
+    }
+    ////////
+    /// line continues in the next buffer
+    ////////
+    line.append(s, e);
+    any = any || s != e;
+    if (b.last) {
+      done_ = true;
+    }
+    release();
+  }
+  return any;
+}
+
+////////
+/// good
+////////
+inline bool
+source::
+good(error_code& err) const {
+
+  ////////
+  /// error_ is set before the last buffer is handed over
+  ////////
+  if (error_.empty()) {
+    return true;
+  }
+  err.append(-1, error_);
+  return false;
+}
+
+////////
+/// format
+////////
+inline source::format_t
+source::
+format() const {
+  return format_;
+}
+
+////////
+/// supported
+////////
+inline bool
+source::
+supported(format_t f) {
+
+  if (f == format_t::plain) {
+    return true;
+  }
+#ifdef __EXP_SOURCE_GZIP__
+  if (f == format_t::gzip) {
+    return true;
+  }
+#endif
+#ifdef __EXP_SOURCE_ZSTD__
+  if (f == format_t::zstd) {
+    return true;
+  }
+#endif
+  return false;
+}
+
+////////
+/// run
+////////
+inline void
+source::
+run() {
+
+  error_code err;
+  pin(err, cpu_);
+
+  for (size_t i = 0;; i ^= 1) {
+    buffer& b = buffers_[i];
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this, &b] { return !b.full || stop_; });
+      if (stop_) {
+        return;
+      }
+    }
+    const bool ok = fill(b);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!ok) {
+        b.last = true;
+      }
+      b.full = true;
+    }
+    cond_.notify_all();
+    if (b.last) {
+      return;
+    }
+  }
+}
+
+////////
+/// fill
+////////
+inline bool
+source::
+fill(buffer& b) {
+
+  b.size = 0;
+  b.last = false;
+  while (b.size < buffer_size_) {
+
+    if (in_pos_ == in_size_ && !in_eof_ && !refill()) {
+      error_ = "Failed to read input file: <:" + file_ + ">";
+      return false;
+    }
+    if (in_pos_ == in_size_ && in_eof_) {
+      if (in_frame_) {
+        error_ = "Truncated compressed input: <:" + file_ + ">";
+        return false;
+      }
+      b.last = true;
+      return true;
+    }
+    ////////
+    /// plain text is copied as is
+    ////////
+    if (format_ == format_t::plain) {
+      const size_t n = std::min(in_size_ - in_pos_, buffer_size_ - b.size);
+      std::memcpy(b.data.data() + b.size, in_.data() + in_pos_, n);
+      b.size += n;
+      in_pos_ += n;
+      continue;
+    }
+#ifdef __EXP_SOURCE_GZIP__
+    if (format_ == format_t::gzip) {
+      zlib_.next_in   = reinterpret_cast<Bytef*>(in_.data() + in_pos_);
+      zlib_.avail_in  = in_size_ - in_pos_;
+      zlib_.next_out  = reinterpret_cast<Bytef*>(b.data.data() + b.size);
+      zlib_.avail_out = buffer_size_ - b.size;
+      const int rc = inflate(&zlib_, Z_NO_FLUSH);
+      b.size  = buffer_size_ - zlib_.avail_out;
+      in_pos_ = in_size_ - zlib_.avail_in;
+      in_frame_ = rc != Z_STREAM_END;
+      if (rc == Z_STREAM_END) {
+
+        ////////
+        /// concatenated members [e.g. cat a.gz b.gz] keep going
+        ////////
+        inflateReset(&zlib_);
+      }
+      else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+        error_ = "Failed to decompress gzip input: <:" + file_ +
+                 ">, " + (zlib_.msg ? zlib_.msg : "corrupt data");
+        return false;
+      }
+      continue;
+    }
+#endif
+#ifdef __EXP_SOURCE_ZSTD__
+    if (format_ == format_t::zstd) {
+      ZSTD_inBuffer  in  = { in_.data(), in_size_, in_pos_ };
+      ZSTD_outBuffer out = { b.data.data(), buffer_size_, b.size };
+      const size_t rc = ZSTD_decompressStream(zstd_, &out, &in);
+      if (ZSTD_isError(rc)) {
+        error_ = "Failed to decompress zstd input: <:" + file_ +
+                 ">, " + ZSTD_getErrorName(rc);
+        return false;
+      }
+      b.size  = out.pos;
+      in_pos_ = in.pos;
+      in_frame_ = rc != 0;
+      continue;
+    }
+#endif
+  }
+  return true;
+}
+
+////////
+/// refill
+////////
+inline bool
+source::
+refill() {
+
+  ssize_t n;
+  do {
+    n = ::read(fd_, in_.data(), in_.size());
+  } while (n == -1 && errno == EINTR);
+  if (n == -1) {
+    return false;
+  }
+  in_pos_  = 0;
+  in_size_ = n;
+  in_eof_  = n == 0;
+  return true;
+}
+
+////////
+/// release
+////////
+inline void
+source::
+release() {
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    buffers_[current_].full = false;
+  }
+  cond_.notify_all();
+  current_ ^= 1;
+  pos_ = 0;
+  held_ = false;
+}
+
+////////
+/// acquire
+////////
+inline void
+source::
+acquire() {
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  buffer& b = buffers_[current_];
+  cond_.wait(lock, [&b] { return b.full; });
+  pos_ = 0;
+  held_ = true;
+}
+
+}
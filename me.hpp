@@ -0,0 +1,299 @@
+#ifndef __EXP_MATCHING_ENGINE_HPP__
+#define __EXP_MATCHING_ENGINE_HPP__
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <ar.hpp>
+
+namespace trade {
+
+////////
+/// price-time priority matching engine
+/// - resting orders sit in per price level fifo queues
+/// - an aggressive order crosses the opposite side best
+///   price first, oldest order first within a level
+/// - whatever remains after crossing rests on its own side
+/// - eb.cpp measures the engine alone, w/o parsing or tracing
+////////
+class matching_engine {
+public:
+
+  ////////
+  /// buy or sell side
+  ////////
+  enum class side_t { buy, sell };
+
+  ////////
+  /// a single execution against a resting order
+  ////////
+  struct fill {
+    int prod;       /// product id
+    int aggressor;  /// incoming order id
+    int resting;    /// resting order id
+    int quantity;   /// executed quantity
+    int price;      /// executed price [resting order's]
+    int left;       /// resting order's quantity after the fill
+  };
+
+  ////////
+  /// trade tape for the last matched order
+  ////////
+  typedef std::vector<fill> tape_t;
+
+  ////////
+  /// match latency histogram
+  /// - log2 buckets of nanoseconds
+  ////////
+  struct latency {
+
+    ////////
+    /// semantics ->
+    /// - all buckets zero
+    ////////
+    latency();
+
+    ////////
+    /// semantics ->
+    /// - bumps bucket for ns, count, sum and max
+    ////////
+    void record(uint64_t ns);
+
+    ////////
+    /// semantics ->
+    /// - walks buckets until fraction p of count is covered
+    /// - returns the upper bound of the bucket found
+    ////////
+    uint64_t percentile(double p) const;
+
+    static const size_t buckets_ = 64;
+
+    uint64_t  bucket[buckets_];
+    uint64_t  count;
+    uint64_t  sum;
+    uint64_t  max;
+  };
+
+  ////////
+  /// semantics ->
+  /// - reserves order pool, id index and tape
+  /// - pool chunks and id index come from arena if given
+  ////////
+  matching_engine(const size_t reserve = 1 << 16,
+                  support::arena* arena = nullptr);
+
+  ////////
+  /// semantics ->
+  /// - releases order pool chunks [arena chunks go w/ the arena]
+  ////////
+  ~matching_engine();
+
+  ////////
+  /// add semantics ->
+  /// - fails if id is already resting
+  /// - crosses the opposite side while price allows and quantity remains
+  /// - fully filled resting orders are removed from their level
+  /// - remainder rests at the tail of its price level
+  /// - fills are available through tape() until the next call
+  /// - records match latency
+  ////////
+  bool add(int id, int prod, side_t side, int quantity, int price);
+
+  ////////
+  /// cancel semantics ->
+  /// - fails if id is not resting
+  /// - unlinks order from its level in O(1)
+  /// - erases level once empty
+  ////////
+  bool cancel(int id);
+
+  ////////
+  /// modify semantics ->
+  /// - fails if id is not resting
+  /// - same price, quantity reduced -> updated in place, keeps priority
+  /// - same price, quantity increased -> moved to the level tail in O(1)
+  /// - new price -> unlinked in O(1), crosses the opposite side like an
+  ///   aggressive order, remainder rests at the new level tail in
+  ///   O(log levels)
+  /// - fills are available through tape() until the next call
+  ////////
+  bool modify(int id, int quantity, int price);
+
+  ////////
+  /// fills produced by the last add or modify
+  ////////
+  const tape_t& tape() const;
+
+  ////////
+  /// match latency so far
+  ////////
+  const latency& latencies() const;
+
+  ////////
+  /// number of resting orders
+  ////////
+  size_t size() const;
+
+  ////////
+  /// locate semantics ->
+  /// - false if id is not resting
+  /// - sets prod, buy, price and quantity of the resting order
+  ////////
+  bool locate(int id, int& prod, bool& buy, int& price, int& quantity) const;
+
+  ////////
+  /// for_each semantics ->
+  /// - calls f(id, buy, quantity, price) for prod's resting orders
+  ///   bids best first then asks best first
+  ////////
+  template <class F>
+  void for_each(int prod, F f) const;
+
+  ////////
+  /// for_each semantics ->
+  /// - calls f(id, quantity) for one level's resting orders, oldest first
+  ////////
+  template <class F>
+  void for_each(int prod, bool buy, int price, F f) const;
+
+  ////////
+  /// trace semantics ->
+  /// - writes up to limit resting orders per product, bids best first
+  ///   then asks best first, to the stream out_for(prod) returns
+  ////////
+  template <class F>
+  void trace(F out_for, size_t limit = 5) const;
+
+  ////////
+  /// for tracing resting orders
+  ////////
+  template <class T>
+  friend T& operator<<(T& out, const matching_engine& in);
+
+  ////////
+  /// for tracing match latency
+  ////////
+  template <class T>
+  friend T& operator<<(T& out, const latency& in);
+
+private:
+
+  struct level;
+
+  ////////
+  /// resting order - intrusive fifo node
+  ////////
+  struct node {
+    int     id;
+    int     prod;
+    side_t  side;
+    int     quantity;
+    int     price;
+    node*   prev;
+    node*   next;
+    level*  owner;
+  };
+
+  ////////
+  /// price level - fifo of resting orders
+  ////////
+  struct level {
+    int    price;
+    int    quantity;
+    node*  head;
+    node*  tail;
+  };
+
+  ////////
+  /// ascending price levels for one side
+  /// - bids are consumed from the back, asks from the front
+  ////////
+  typedef std::map<int, level> levels;
+
+  ////////
+  /// both sides for one product
+  ////////
+  struct book {
+    levels  bids;
+    levels  asks;
+  };
+
+  typedef std::map<int, book>               books;
+  typedef std::unordered_map<
+    int, node*, std::hash<int>, std::equal_to<int>,
+    support::arena_allocator<std::pair<const int, node*>>
+  > node_index;
+  typedef std::vector<node*>                chunks;
+
+  ////////
+  /// semantics ->
+  /// - crosses op against opposite side levels
+  /// - appends fills to tape_
+  ////////
+  void match(node* op, levels& other);
+
+  ////////
+  /// semantics ->
+  /// - finds or creates level for op's price
+  /// - links op at the level tail
+  ////////
+  void rest(node* op, levels& side);
+
+  ////////
+  /// semantics ->
+  /// - unlinks op from its level
+  /// - erases the level once empty
+  ////////
+  void unlink(node* op);
+
+  ////////
+  /// semantics ->
+  /// - moves op to the tail of its own level
+  ////////
+  void requeue(node* op);
+
+  ////////
+  /// semantics ->
+  /// - pops a node from the free list
+  /// - allocates a new chunk if free list is empty
+  ////////
+  node* acquire();
+
+  ////////
+  /// semantics ->
+  /// - pushes node back onto the free list
+  ////////
+  void release(node* op);
+
+  ////////
+  /// product lookup w/ last product cached
+  ////////
+  book& book_for(int prod);
+
+  ////////
+  /// level map for a resting order
+  ////////
+  levels& levels_for(const node* op);
+
+  static const size_t chunk_size_ = 4096;
+
+  support::arena*  arena_;
+  books       books_;
+  node_index  index_;
+  chunks      chunks_;
+  node*       free_;
+  int         last_prod_;
+  book*       last_book_;
+  tape_t      tape_;
+  latency     latency_;
+};
+
+}
+
+#include <me.ipp>
+
+#endif
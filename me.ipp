@@ -0,0 +1,536 @@
+namespace trade {
+
+////////
+/// latency constructor
+////////
+inline
+matching_engine::
+latency::
+latency() :
+  bucket(),
+  count(0),
+  sum(0),
+  max(0)
+{}
+
+////////
+/// record
+////////
+inline void
+matching_engine::
+latency::
+record(uint64_t ns) {
+
+  ////////
+  /// bucket i holds [2^(i-1), 2^i)
+  ////////
+  size_t i = ns ? 64 - __builtin_clzll(ns) : 0;
+  ++bucket[i < buckets_ ? i : buckets_ - 1];
+  ++count;
+  sum += ns;
+  if (ns > max) max = ns;
+}
+
+////////
+/// percentile
+////////
+inline uint64_t
+matching_engine::
+latency::
+percentile(double p) const {
+
+  const uint64_t want = static_cast<uint64_t>(p * count);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets_; ++i) {
+    seen += bucket[i];
+    if (seen > want) {
+      uint64_t upper = i ? (uint64_t(1) << i) - 1 : 0;
+      return upper < max ? upper : max;
+    }
+  }
+  return max;
+}
+
+////////
+/// constructor
+////////
+inline
+matching_engine::
+matching_engine(const size_t reserve,
+                support::arena* arena) :
+  arena_(arena),
+  index_(0, node_index::hasher(), node_index::key_equal(),
+         node_index::allocator_type(arena)),
+  free_(nullptr),
+  last_prod_(-1),
+  last_book_(nullptr) {
+  index_.reserve(reserve);
+  tape_.reserve(64);
+}
+
+////////
+/// destructor
+////////
+inline
+matching_engine::
+~matching_engine() {
+  for (size_t i = 0; i < chunks_.size() && !arena_; ++i) {
+    delete [] chunks_[i];
+  }
+}
+
+////////
+/// add
+////////
+inline bool
+matching_engine::
+add(int id,
+    int prod,
+    side_t side,
+    int quantity,
+    int price) {
+
+  tape_.clear();
+  if (index_.find(id) != index_.end()) {
+    return false;
+  }
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+
+  node* op = acquire();
+  op->id       = id;
+  op->prod     = prod;
+  op->side     = side;
+  op->quantity = quantity;
+  op->price    = price;
+  op->prev     = nullptr;
+  op->next     = nullptr;
+  op->owner    = nullptr;
+
+  ////////
+  /// cross the opposite side, rest whatever is left
+  ////////
+  book& b = book_for(prod);
+  match(op, side == side_t::buy ? b.asks : b.bids);
+
+  if (op->quantity > 0) {
+    rest(op, side == side_t::buy ? b.bids : b.asks);
+    index_.emplace(id, op);
+  }
+  else {
+    release(op);
+  }
+  latency_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count());
+  return true;
+}
+
+////////
+/// cancel
+////////
+inline bool
+matching_engine::
+cancel(int id) {
+
+  node_index::iterator i = index_.find(id);
+  if (i == index_.end()) {
+    return false;
+  }
+  node* op = i->second;
+  index_.erase(i);
+  unlink(op);
+  release(op);
+  return true;
+}
+
+////////
+/// modify
+////////
+inline bool
+matching_engine::
+modify(int id,
+       int quantity,
+       int price) {
+
+  tape_.clear();
+  node_index::iterator i = index_.find(id);
+  if (i == index_.end()) {
+    return false;
+  }
+  node* op = i->second;
+
+  ////////
+  /// same price - only an increase loses queue priority
+  ////////
+  if (price == op->price) {
+    const bool up = quantity > op->quantity;
+    op->owner->quantity += quantity - op->quantity;
+    op->quantity = quantity;
+    if (up) {
+      requeue(op);
+    }
+    return true;
+  }
+  ////////
+  /// price amend - relocate, possibly crossing on the way
+  ////////
+  unlink(op);
+  op->quantity = quantity;
+  op->price    = price;
+
+  book& b = book_for(op->prod);
+  const bool buy = op->side == side_t::buy;
+  match(op, buy ? b.asks : b.bids);
+
+  if (op->quantity > 0) {
+    rest(op, buy ? b.bids : b.asks);
+  }
+  else {
+    index_.erase(id);
+    release(op);
+  }
+  return true;
+}
+
+////////
+/// tape
+////////
+inline const matching_engine::tape_t&
+matching_engine::
+tape() const {
+  return tape_;
+}
+
+////////
+/// latencies
+////////
+inline const matching_engine::latency&
+matching_engine::
+latencies() const {
+  return latency_;
+}
+
+////////
+/// size
+////////
+inline size_t
+matching_engine::
+size() const {
+  return index_.size();
+}
+
+////////
+/// locate
+////////
+inline bool
+matching_engine::
+locate(int id,
+       int& prod,
+       bool& buy,
+       int& price,
+       int& quantity) const {
+
+  node_index::const_iterator i = index_.find(id);
+  if (i == index_.end()) {
+    return false;
+  }
+  prod  = i->second->prod;
+  buy   = i->second->side == side_t::buy;
+  price    = i->second->price;
+  quantity = i->second->quantity;
+  return true;
+}
+
+////////
+/// for each
+////////
+template <class F>
+inline void
+matching_engine::
+for_each(int prod,
+         F f) const {
+
+  books::const_iterator p = books_.find(prod);
+  if (p == books_.end()) {
+    return;
+  }
+  levels::const_reverse_iterator b = p->second.bids.rbegin();
+  for (; b != p->second.bids.rend(); ++b) {
+    for (const node* n = b->second.head; n; n = n->next) {
+      f(n->id, true, n->quantity, n->price);
+    }
+  }
+  levels::const_iterator a = p->second.asks.begin();
+  for (; a != p->second.asks.end(); ++a) {
+    for (const node* n = a->second.head; n; n = n->next) {
+      f(n->id, false, n->quantity, n->price);
+    }
+  }
+}
+
+////////
+/// for each [level]
+////////
+template <class F>
+inline void
+matching_engine::
+for_each(int prod,
+         bool buy,
+         int price,
+         F f) const {
+
+  books::const_iterator p = books_.find(prod);
+  if (p == books_.end()) {
+    return;
+  }
+  const levels& side = buy ? p->second.bids : p->second.asks;
+  levels::const_iterator l = side.find(price);
+  if (l == side.end()) {
+    return;
+  }
+  for (const node* n = l->second.head; n; n = n->next) {
+    f(n->id, n->quantity);
+  }
+}
+
+////////
+/// match
+////////
+inline void
+matching_engine::
+match(node* op,
+      levels& other) {
+
+  const bool buy = op->side == side_t::buy;
+
+  while (op->quantity > 0 && !other.empty()) {
+
+    ////////
+    /// best opposite level - lowest ask or highest bid
+    ////////
+    levels::iterator l = buy ? other.begin() : std::prev(other.end());
+    level& lvl = l->second;
+    if (buy ? lvl.price > op->price : lvl.price < op->price) {
+      break;
+    }
+    ////////
+    /// walk the level fifo oldest first
+    ////////
+    while (op->quantity > 0 && lvl.head) {
+
+      node* rp = lvl.head;
+      int qty = std::min(op->quantity, rp->quantity);
+      tape_.push_back(fill{op->prod, op->id, rp->id, qty, lvl.price,
+                           rp->quantity - qty});
+
+      op->quantity  -= qty;
+      rp->quantity  -= qty;
+      lvl.quantity  -= qty;
+
+      if (rp->quantity == 0) {
+        lvl.head = rp->next;
+        if (lvl.head) lvl.head->prev = nullptr;
+        else          lvl.tail = nullptr;
+        index_.erase(rp->id);
+        release(rp);
+      }
+    }
+    if (!lvl.head) {
+      other.erase(l);
+    }
+  }
+}
+
+////////
+/// rest
+////////
+inline void
+matching_engine::
+rest(node* op,
+     levels& side) {
+
+  levels::iterator l = side.lower_bound(op->price);
+  if (l == side.end() || l->first != op->price) {
+    l = side.emplace_hint(l, op->price,
+                          level{op->price, 0, nullptr, nullptr});
+  }
+  level& lvl = l->second;
+  op->owner = &lvl;
+  op->prev  = lvl.tail;
+  op->next  = nullptr;
+  if (lvl.tail) lvl.tail->next = op;
+  else          lvl.head = op;
+  lvl.tail = op;
+  lvl.quantity += op->quantity;
+}
+
+////////
+/// unlink
+////////
+inline void
+matching_engine::
+unlink(node* op) {
+
+  level& lvl = *op->owner;
+  if (op->prev) op->prev->next = op->next;
+  else          lvl.head = op->next;
+  if (op->next) op->next->prev = op->prev;
+  else          lvl.tail = op->prev;
+  lvl.quantity -= op->quantity;
+
+  if (!lvl.head) {
+    const int price = lvl.price;
+    levels_for(op).erase(price);
+  }
+  op->owner = nullptr;
+}
+
+////////
+/// requeue
+////////
+inline void
+matching_engine::
+requeue(node* op) {
+
+  level& lvl = *op->owner;
+  if (lvl.tail == op) {
+    return;
+  }
+  if (op->prev) op->prev->next = op->next;
+  else          lvl.head = op->next;
+  op->next->prev = op->prev;
+
+  op->prev = lvl.tail;
+  op->next = nullptr;
+  lvl.tail->next = op;
+  lvl.tail = op;
+}
+
+////////
+/// acquire
+////////
+inline matching_engine::node*
+matching_engine::
+acquire() {
+
+  if (!free_) {
+    node* chunk = arena_ ?
+      static_cast<node*>(arena_->allocate(chunk_size_ * sizeof(node))) :
+      new node[chunk_size_];
+    chunks_.push_back(chunk);
+    for (size_t i = 0; i < chunk_size_; ++i) {
+      chunk[i].next = free_;
+      free_ = &chunk[i];
+    }
+  }
+  node* op = free_;
+  free_ = op->next;
+  return op;
+}
+
+////////
+/// release
+////////
+inline void
+matching_engine::
+release(node* op) {
+  op->next = free_;
+  free_ = op;
+}
+
+////////
+/// book for
+////////
+inline matching_engine::book&
+matching_engine::
+book_for(int prod) {
+  if (prod != last_prod_) {
+    last_book_ = &books_[prod];
+    last_prod_ = prod;
+  }
+  return *last_book_;
+}
+
+////////
+/// levels for
+////////
+inline matching_engine::levels&
+matching_engine::
+levels_for(const node* op) {
+  book& b = book_for(op->prod);
+  return op->side == side_t::buy ? b.bids : b.asks;
+}
+
+////////
+/// trace
+////////
+template <class F>
+inline void
+matching_engine::
+trace(F out_for,
+      size_t limit) const {
+
+  books::const_iterator p = books_.begin();
+  for (; p != books_.end(); ++p) {
+
+    const levels& bids = p->second.bids;
+    const levels& asks = p->second.asks;
+    size_t traced = 0;
+    if (bids.empty() && asks.empty()) {
+      continue;
+    }
+    auto& out = out_for(p->first);
+
+    levels::const_reverse_iterator b = bids.rbegin();
+    for (; b != bids.rend() && traced < limit; ++b) {
+      const node* n = b->second.head;
+      for (; n && traced < limit; n = n->next, ++traced) {
+        out << "N, " << n->prod << ", " << n->id << ", B, "
+            << n->quantity << ", " << n->price << std::endl;
+      }
+    }
+    levels::const_iterator a = asks.begin();
+    for (; a != asks.end() && traced < limit; ++a) {
+      const node* n = a->second.head;
+      for (; n && traced < limit; n = n->next, ++traced) {
+        out << "N, " << n->prod << ", " << n->id << ", S, "
+            << n->quantity << ", " << n->price << std::endl;
+      }
+    }
+  }
+}
+
+////////
+/// operator<< (matching_engine)
+/// - resting orders per product, bids best first then asks best first
+/// - same five orders per product as the order table trace
+////////
+template <class T>
+T& operator<<(T& out, const matching_engine& in) {
+  in.trace([&out](int) -> T& { return out; });
+  return out;
+}
+
+////////
+/// operator<< (latency)
+////////
+template <class T>
+T& operator<<(T& out, const matching_engine::latency& in) {
+
+  out << "Match latency (ns): orders "
+      << in.count
+      << ", mean "
+      << (in.count ? in.sum / in.count : 0)
+      << ", p50 "
+      << in.percentile(0.50)
+      << ", p99 "
+      << in.percentile(0.99)
+      << ", p99.9 "
+      << in.percentile(0.999)
+      << ", max "
+      << in.max
+      << std::endl;
+  return out;
+}
+
+}
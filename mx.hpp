@@ -0,0 +1,255 @@
+#ifndef __EXP_METRICS_HPP__
+#define __EXP_METRICS_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdio>
+#include <cstdint>
+#include <cerrno>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <ec.hpp>
+
+namespace support {
+
+////////
+/// process wide metrics registry
+/// - counters and histograms live in per thread shards of relaxed
+///   atomics; only the owning thread writes a shard, so an update is
+///   a thread local lookup, a load and a store - no rmw, no sharing
+/// - reads sum every shard; a shard outlives its thread and is
+///   handed to the next new thread, so totals never go backwards
+/// - gauges are single process wide atomics [set/add]
+/// - registering is locked and idempotent by name + labels; hot
+///   paths keep the returned handle
+/// - traces in prometheus text exposition format
+////////
+class metrics {
+public:
+
+  ////////
+  /// metric kinds
+  ////////
+  enum class kind_t { counter, gauge, histogram };
+
+  ////////
+  /// monotonically increasing count
+  ////////
+  class counter {
+  public:
+
+    ////////
+    /// semantics ->
+    /// - a default handle counts into a scratch slot nobody reads
+    ////////
+    counter();
+
+    ////////
+    /// add semantics ->
+    /// - adds n to the calling thread's shard
+    ////////
+    void add(uint64_t n = 1) const;
+
+    ////////
+    /// semantics ->
+    /// - sum over all shards
+    ////////
+    uint64_t value() const;
+
+  private:
+    friend class metrics;
+    size_t  slot_;
+  };
+
+  ////////
+  /// value that goes up and down
+  ////////
+  class gauge {
+  public:
+
+    gauge();
+
+    void set(int64_t v) const;
+    void add(int64_t n) const;
+    int64_t value() const;
+
+  private:
+    friend class metrics;
+    std::atomic<int64_t>*  value_;
+  };
+
+  ////////
+  /// distribution over power of two buckets
+  /// - bucket b counts values of bit width b, i.e. [2^(b-1), 2^b - 1]
+  ////////
+  class histogram {
+  public:
+
+    histogram();
+
+    ////////
+    /// observe semantics ->
+    /// - bumps v's bucket, the count and the sum
+    ////////
+    void observe(uint64_t v) const;
+
+  private:
+    friend class metrics;
+    size_t  slot_;
+  };
+
+  ////////
+  /// periodic dump to a file
+  /// - writes to <file>.tmp and renames it over file so scrapers never
+  ///   see a partial dump [node_exporter textfile collector style]
+  /// - dumps once more when destroyed
+  ////////
+  class writer {
+  public:
+
+    ////////
+    /// semantics ->
+    /// - starts the dump thread if interval is non zero
+    ////////
+    writer(metrics& m,
+           const std::string& file,
+           std::chrono::milliseconds interval);
+
+    ////////
+    /// semantics ->
+    /// - stops the thread, writes a final dump
+    ////////
+    ~writer();
+
+    writer(const writer&) = delete;
+    writer& operator=(const writer&) = delete;
+
+    ////////
+    /// dump semantics ->
+    /// - writes one dump now
+    /// - false w/ err set if the file couldn't be written
+    ////////
+    bool dump(error_code& err);
+
+  private:
+    void run();
+
+    metrics&                   metrics_;
+    const std::string          file_;
+    std::chrono::milliseconds  interval_;
+    std::mutex                 mutex_;
+    std::condition_variable    cond_;
+    bool                       stop_;
+    std::thread                thread_;
+  };
+
+  ////////
+  /// instance
+  ////////
+  static metrics& instance();
+
+  ////////
+  /// register semantics ->
+  /// - name must be a valid prometheus name; labels are the text
+  ///   between the braces, e.g. action="new"
+  /// - returns the existing metric if name + labels is registered
+  /// - a full registry hands out scratch handles
+  ////////
+  counter make_counter(const std::string& name,
+                       const std::string& help,
+                       const std::string& labels = "");
+  gauge make_gauge(const std::string& name,
+                   const std::string& help,
+                   const std::string& labels = "");
+  histogram make_histogram(const std::string& name,
+                           const std::string& help,
+                           const std::string& labels = "");
+
+  ////////
+  /// for tracing every metric in prometheus text format
+  ////////
+  template <class T>
+  friend T& operator<<(T& out, const metrics& in);
+
+private:
+
+  ////////
+  /// per thread slots; slot 0 is scratch
+  ////////
+  static const size_t slots_   = 4096;
+  static const size_t buckets_ = 65;
+
+  struct shard {
+    std::atomic<uint64_t>  slot[slots_];
+    std::atomic<bool>      owned;
+    shard*                 next;
+  };
+
+  ////////
+  /// registered metric
+  ////////
+  struct entry {
+    std::string                            name;
+    std::string                            help;
+    std::string                            labels;
+    kind_t                                 kind;
+    size_t                                 slot;   /// first slot
+    std::unique_ptr<std::atomic<int64_t>>  gauge;
+  };
+
+  metrics();
+  ~metrics();
+
+  metrics(const metrics&) = delete;
+  metrics& operator=(const metrics&) = delete;
+
+  ////////
+  /// semantics ->
+  /// - calling thread's shard; claims a free one or makes one
+  ////////
+  static shard* local();
+
+  ////////
+  /// semantics ->
+  /// - finds name + labels or appends it w/ n slots
+  ////////
+  entry* enroll(const std::string& name,
+                const std::string& help,
+                const std::string& labels,
+                kind_t kind,
+                size_t n);
+
+  ////////
+  /// semantics ->
+  /// - slot i summed over shards
+  ////////
+  uint64_t sum(size_t i) const;
+
+  ////////
+  /// thread local shard; released for reuse when the thread exits
+  ////////
+  struct holder {
+    shard*  s = nullptr;
+    ~holder();
+  };
+
+  static thread_local holder local_;
+
+  mutable std::mutex                   mutex_;
+  std::vector<std::unique_ptr<entry>>  entries_;
+  size_t                               used_;
+  std::atomic<shard*>                  shards_;
+};
+
+}
+
+#include <mx.ipp>
+
+#endif
@@ -0,0 +1,439 @@
+namespace support {
+
+inline thread_local metrics::holder metrics::local_;
+
+////////
+/// counter constructor
+////////
+inline
+metrics::
+counter::
+counter() :
+  slot_(0) {
+}
+
+////////
+/// counter add
+////////
+inline void
+metrics::
+counter::
+add(uint64_t n) const {
+  std::atomic<uint64_t>& a = local()->slot[slot_];
+  a.store(a.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+////////
+/// counter value
+////////
+inline uint64_t
+metrics::
+counter::
+value() const {
+  return instance().sum(slot_);
+}
+
+////////
+/// gauge constructor
+////////
+inline
+metrics::
+gauge::
+gauge() {
+  static std::atomic<int64_t> scratch(0);
+  value_ = &scratch;
+}
+
+////////
+/// gauge set
+////////
+inline void
+metrics::
+gauge::
+set(int64_t v) const {
+  value_->store(v, std::memory_order_relaxed);
+}
+
+////////
+/// gauge add
+////////
+inline void
+metrics::
+gauge::
+add(int64_t n) const {
+  value_->fetch_add(n, std::memory_order_relaxed);
+}
+
+////////
+/// gauge value
+////////
+inline int64_t
+metrics::
+gauge::
+value() const {
+  return value_->load(std::memory_order_relaxed);
+}
+
+////////
+/// histogram constructor
+////////
+inline
+metrics::
+histogram::
+histogram() :
+  slot_(0) {
+}
+
+////////
+/// histogram observe
+/// - slots are buckets by bit width, then count, then sum
+////////
+inline void
+metrics::
+histogram::
+observe(uint64_t v) const {
+
+  shard* s = local();
+  if (!slot_) {
+    return;
+  }
+  const size_t b = v ? 64 - __builtin_clzll(v) : 0;
+  std::atomic<uint64_t>* a = s->slot + slot_;
+  a[b].store(a[b].load(std::memory_order_relaxed) + 1,
+             std::memory_order_relaxed);
+  a[buckets_].store(a[buckets_].load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+  a[buckets_ + 1].store(a[buckets_ + 1].load(std::memory_order_relaxed) + v,
+                        std::memory_order_relaxed);
+}
+
+////////
+/// writer constructor
+////////
+inline
+metrics::
+writer::
+writer(metrics& m,
+       const std::string& file,
+       std::chrono::milliseconds interval) :
+  metrics_ (m),
+  file_    (file),
+  interval_(interval),
+  stop_    (false) {
+
+  if (interval_.count() > 0) {
+    thread_ = std::thread(&writer::run, this);
+  }
+}
+
+////////
+/// writer destructor
+////////
+inline
+metrics::
+writer::
+~writer() {
+
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+  }
+  error_code err;
+  dump(err);
+}
+
+////////
+/// writer dump
+////////
+inline bool
+metrics::
+writer::
+dump(error_code& err) {
+
+  std::ostringstream text;
+  text << metrics_;
+  const std::string body = text.str();
+
+  const std::string tmp = file_ + ".tmp";
+  const int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    err.append(-1, "Failed to open metrics file: <:" + tmp + ">");
+    return false;
+  }
+  size_t done = 0;
+  while (done < body.size()) {
+    const ssize_t n = ::write(fd, body.data() + done, body.size() - done);
+    if (n == -1 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += n;
+  }
+  ::close(fd);
+  if (done < body.size() || std::rename(tmp.c_str(), file_.c_str())) {
+    err.append(-1, "Failed to write metrics file: <:" + file_ + ">");
+    return false;
+  }
+  return true;
+}
+
+////////
+/// writer run
+////////
+inline void
+metrics::
+writer::
+run() {
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!cond_.wait_for(lock, interval_, [this] { return stop_; })) {
+    lock.unlock();
+    error_code err;
+    dump(err);
+    lock.lock();
+  }
+}
+
+////////
+/// holder destructor
+////////
+inline
+metrics::
+holder::
+~holder() {
+  if (s) {
+    s->owned.store(false, std::memory_order_release);
+  }
+}
+
+////////
+/// instance
+////////
+inline metrics&
+metrics::
+instance() {
+  static metrics instance_;
+  return instance_;
+}
+
+////////
+/// constructor
+////////
+inline
+metrics::
+metrics() :
+  used_  (1),
+  shards_(nullptr) {
+}
+
+////////
+/// destructor
+////////
+inline
+metrics::
+~metrics() {
+  shard* s = shards_.load();
+  while (s) {
+    shard* n = s->next;
+    delete s;
+    s = n;
+  }
+}
+
+////////
+/// make counter
+////////
+inline metrics::counter
+metrics::
+make_counter(const std::string& name,
+             const std::string& help,
+             const std::string& labels) {
+
+  counter c;
+  if (entry* e = enroll(name, help, labels, kind_t::counter, 1)) {
+    c.slot_ = e->slot;
+  }
+  return c;
+}
+
+////////
+/// make gauge
+////////
+inline metrics::gauge
+metrics::
+make_gauge(const std::string& name,
+           const std::string& help,
+           const std::string& labels) {
+
+  gauge g;
+  if (entry* e = enroll(name, help, labels, kind_t::gauge, 0)) {
+    g.value_ = e->gauge.get();
+  }
+  return g;
+}
+
+////////
+/// make histogram
+////////
+inline metrics::histogram
+metrics::
+make_histogram(const std::string& name,
+               const std::string& help,
+               const std::string& labels) {
+
+  histogram h;
+  if (entry* e = enroll(name, help, labels, kind_t::histogram,
+                        buckets_ + 2)) {
+    h.slot_ = e->slot;
+  }
+  return h;
+}
+
+////////
+/// local
+////////
+inline metrics::shard*
+metrics::
+local() {
+
+  if (local_.s) {
+    return local_.s;
+  }
+  metrics& m = instance();
+  for (shard* s = m.shards_.load(std::memory_order_acquire); s; s = s->next) {
+    bool owned = false;
+    if (s->owned.compare_exchange_strong(owned, true)) {
+      return local_.s = s;
+    }
+  }
+  shard* s = new shard();
+  for (size_t i = 0; i < slots_; ++i) {
+    s->slot[i].store(0, std::memory_order_relaxed);
+  }
+  s->owned.store(true, std::memory_order_relaxed);
+  s->next = m.shards_.load(std::memory_order_relaxed);
+  while (!m.shards_.compare_exchange_weak(s->next, s,
+                                          std::memory_order_release)) {
+  }
+  return local_.s = s;
+}
+
+////////
+/// enroll
+////////
+inline metrics::entry*
+metrics::
+enroll(const std::string& name,
+       const std::string& help,
+       const std::string& labels,
+       kind_t kind,
+       size_t n) {
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    entry* e = entries_[i].get();
+    if (e->name == name && e->labels == labels) {
+      return e->kind == kind ? e : nullptr;
+    }
+  }
+  if (used_ + n > slots_) {
+    return nullptr;
+  }
+  std::unique_ptr<entry> e(new entry{name, help, labels, kind, used_, nullptr});
+  if (kind == kind_t::gauge) {
+    e->gauge.reset(new std::atomic<int64_t>(0));
+  }
+  used_ += n;
+  entries_.push_back(std::move(e));
+  return entries_.back().get();
+}
+
+////////
+/// sum
+////////
+inline uint64_t
+metrics::
+sum(size_t i) const {
+
+  uint64_t v = 0;
+  for (shard* s = shards_.load(std::memory_order_acquire); s; s = s->next) {
+    v += s->slot[i].load(std::memory_order_relaxed);
+  }
+  return v;
+}
+
+////////
+/// operator<< (metrics)
+/// - help and type once per name, then each labelled series
+////////
+template <class T>
+T& operator<<(T& out, const metrics& in) {
+
+  static const char* types[] = { "counter", "gauge", "histogram" };
+
+  std::lock_guard<std::mutex> lock(in.mutex_);
+  std::vector<bool> done(in.entries_.size(), false);
+
+  for (size_t i = 0; i < in.entries_.size(); ++i) {
+    if (done[i]) {
+      continue;
+    }
+    const metrics::entry& f = *in.entries_[i];
+    out << "# HELP " << f.name << " " << f.help << std::endl
+        << "# TYPE " << f.name << " "
+        << types[static_cast<int>(f.kind)] << std::endl;
+
+    for (size_t j = i; j < in.entries_.size(); ++j) {
+      const metrics::entry& e = *in.entries_[j];
+      if (done[j] || e.name != f.name) {
+        continue;
+      }
+      done[j] = true;
+
+      const std::string l = e.labels.empty() ? "" : "{" + e.labels + "}";
+      if (e.kind == metrics::kind_t::counter) {
+        out << e.name << l << " " << in.sum(e.slot) << std::endl;
+      }
+      else if (e.kind == metrics::kind_t::gauge) {
+        out << e.name << l << " "
+            << static_cast<long long>(e.gauge->load()) << std::endl;
+      }
+      else {
+        ////////
+        /// cumulative buckets up to the highest non empty one
+        ////////
+        const std::string p = e.labels.empty() ? "{" : "{" + e.labels + ",";
+        uint64_t counts[metrics::buckets_];
+        size_t last = 0;
+        for (size_t b = 0; b < metrics::buckets_; ++b) {
+          counts[b] = in.sum(e.slot + b);
+          if (counts[b]) {
+            last = b;
+          }
+        }
+        uint64_t cumulative = 0;
+        for (size_t b = 0; b <= last && b < 64; ++b) {
+          cumulative += counts[b];
+          const uint64_t le = b ? (uint64_t(1) << b) - 1 : 0;
+          out << e.name << "_bucket" << p << "le=\"" << le << "\"} "
+              << cumulative << std::endl;
+        }
+        const uint64_t count = in.sum(e.slot + metrics::buckets_);
+        out << e.name << "_bucket" << p << "le=\"+Inf\"} " << count
+            << std::endl
+            << e.name << "_sum" << l << " "
+            << in.sum(e.slot + metrics::buckets_ + 1) << std::endl
+            << e.name << "_count" << l << " " << count << std::endl;
+      }
+    }
+  }
+  return out;
+}
+
+}
@@ -1,19 +1,226 @@
-#include <fstream>
+#include <unistd.h>
 #include <om.hpp>
+#include <ah.hpp>
+#include <fv.hpp>
 #include <iomanip>
 #include <limits>
+#include <climits>
 #include <boost/algorithm/string/trim.hpp>
 
 namespace trade {
 
+////////
+/// options constructor
+////////
+order_tracker::
+options::
+options() :
+  matching(false),
+  trace_interval(10),
+  trace_limit(5),
+  lint(false),
+  threads(0),
+  lint_report(10),
+  stats(false),
+  snapshot_interval(0),
+  profile(false),
+  input_buffer(1 << 20),
+  arena(false),
+  cpu(-1),
+  input_cpu(-1),
+  partitioned(false),
+  spill_window(100000),
+  metrics_interval(1000)
+{}
+
+////////
+/// options configure
+/// - order_tracker.matching             bool
+/// - order_tracker.trace_interval       int   messages, 0 -> off
+/// - order_tracker.trace_limit          int   orders per product
+/// - order_tracker.threads              int
+/// - order_tracker.lint_report          int
+/// - order_tracker.stats                bool
+/// - order_tracker.snapshot_interval    int
+/// - order_tracker.profile              bool
+/// - order_tracker.input_buffer         int   bytes
+/// - order_tracker.output.capacity      int   bytes
+/// - order_tracker.output.flush_size    int   bytes
+/// - order_tracker.output.flush         string size|interval|manual
+/// - order_tracker.output.interval      int   milliseconds
+/// - order_tracker.output.background    bool
+/// - order_tracker.memory.pages         string normal|transparent|hugetlb
+/// - order_tracker.memory.node          int
+/// - order_tracker.memory.region        int   bytes
+/// - order_tracker.cpu                  int
+/// - order_tracker.input_cpu            int
+/// - order_tracker.output.cpu           int
+/// - order_tracker.files.dir            string [enables partitioning]
+/// - order_tracker.files.buckets        int
+/// - order_tracker.files.capacity       int   bytes per bucket buffer
+/// - order_tracker.spill.file           string [enables tiering]
+/// - order_tracker.spill.window         int   idle messages before a spill
+/// - order_tracker.metrics.file         string [enables metric dumps]
+/// - order_tracker.metrics.interval     int   milliseconds
+////////
+bool
+order_tracker::
+options::
+configure(support::error_code& err,
+          const support::config& c) {
+
+  static const std::string k = "order_tracker.";
+
+  ////////
+  /// k + key in one buffer reused for every lookup
+  ////////
+  std::string name;
+  name.reserve(64);
+  auto full = [&name](const char* key) -> const std::string& {
+    name.assign(k);
+    name.append(key);
+    return name;
+  };
+
+  ////////
+  /// counts and sizes can't be negative
+  ////////
+  auto count = [&](const char* key, size_t& v) {
+    const int i = c.find<int>(full(key), v > size_t(INT_MAX) ? INT_MAX : v);
+    if (i < 0) {
+      err = support::error_code(-1, "Bad config value: <" + k + key +
+                                "> must not be negative");
+      return false;
+    }
+    v = i;
+    return true;
+  };
+
+  matching = c.find<bool>(full("matching"), matching);
+  stats    = c.find<bool>(full("stats"), stats);
+  profile  = c.find<bool>(full("profile"), profile);
+  output.background =
+    c.find<bool>(full("output.background"), output.background);
+
+  size_t interval = output.interval.count();
+  size_t region   = memory.region;
+  size_t dumps    = metrics_interval.count();
+  if (!count("trace_interval", trace_interval) ||
+      !count("trace_limit", trace_limit) ||
+      !count("threads", threads) ||
+      !count("lint_report", lint_report) ||
+      !count("snapshot_interval", snapshot_interval) ||
+      !count("input_buffer", input_buffer) ||
+      !count("output.capacity", output.capacity) ||
+      !count("output.flush_size", output.flush_size) ||
+      !count("output.interval", interval) ||
+      !count("memory.region", region) ||
+      !count("files.buckets", files.buckets) ||
+      !count("files.capacity", files.output.capacity) ||
+      !count("spill.window", spill_window) ||
+      !count("metrics.interval", dumps)) {
+    return false;
+  }
+  output.interval  = std::chrono::milliseconds(interval);
+  metrics_interval = std::chrono::milliseconds(dumps);
+  metrics          = c.find<std::string>(full("metrics.file"), metrics);
+  spill            = c.find<std::string>(full("spill.file"), spill);
+  memory.region   = region;
+  cpu             = c.find<int>(full("cpu"), cpu);
+  input_cpu       = c.find<int>(full("input_cpu"), input_cpu);
+  output.cpu      = c.find<int>(full("output.cpu"), output.cpu);
+
+  const std::string_view flush =
+    c.find<std::string_view>(full("output.flush"), "");
+  if (flush == "size") {
+    output.flush = support::sink::flush_t::size;
+  }
+  else if (flush == "interval") {
+    output.flush = support::sink::flush_t::interval;
+  }
+  else if (flush == "manual") {
+    output.flush = support::sink::flush_t::manual;
+  }
+  else if (!flush.empty()) {
+    err = support::error_code(-1, "Bad config value: <" + k +
+                              "output.flush> must be size, interval or manual");
+    return false;
+  }
+  const std::string_view pages =
+    c.find<std::string_view>(full("memory.pages"), "");
+  if (pages == "normal") {
+    memory.pages = support::arena::pages_t::normal;
+  }
+  else if (pages == "transparent") {
+    memory.pages = support::arena::pages_t::transparent;
+  }
+  else if (pages == "hugetlb") {
+    memory.pages = support::arena::pages_t::hugetlb;
+  }
+  else if (!pages.empty()) {
+    err = support::error_code(-1, "Bad config value: <" + k +
+                              "memory.pages> must be normal, transparent "
+                              "or hugetlb");
+    return false;
+  }
+  memory.node = c.find<int>(full("memory.node"), memory.node);
+  if (memory.pages != support::arena::pages_t::normal || memory.node >= 0) {
+    arena = true;
+  }
+  const std::string_view dir = c.find<std::string_view>(full("files.dir"), "");
+  if (!dir.empty()) {
+    files.dir   = dir;
+    partitioned = true;
+  }
+  if (files.output.flush_size > files.output.capacity) {
+    files.output.flush_size = files.output.capacity;
+  }
+  return true;
+}
+
 ////////
 /// constructor
 ////////
 order_tracker::
-order_tracker(const std::string& file) :
+order_tracker(const std::string& file,
+              support::sink& out,
+              const options& opts) :
   file_(file),
-  message_count_(0)
-{}
+  out_(out),
+  opts_(opts),
+  arena_(opts.arena ? new support::arena(opts.memory) : nullptr),
+  orders_(order_table::ctor_args_list(),
+          order_table::allocator_type(arena_.get())),
+  seq_(0),
+  message_count_(0),
+  engine_(1 << 16, arena_.get()),
+  next_sweep_(0),
+  spills_(0),
+  faults_(0),
+  peak_spilled_(0) {
+
+  static const char* actions[] = { "new", "cancel", "modify", "trade",
+                                   "unknown" };
+
+  support::metrics& m = support::metrics::instance();
+  for (size_t i = 0; i < 5; ++i) {
+    messages_[i] = m.make_counter("order_tracker_messages_total",
+                                  "Feed messages by action",
+                                  std::string("action=\"") + actions[i] + "\"");
+  }
+  errors_      = m.make_counter("order_tracker_errors_total",
+                                "Errors reported while handling messages");
+  book_orders_ = m.make_gauge("order_tracker_book_orders",
+                              "Orders resting in the book");
+  publish_ns_  = m.make_histogram("order_tracker_publish_ns",
+                                  "Book snapshot publish time in nanoseconds");
+  spill_count_    = m.make_counter("order_tracker_spills_total",
+                                   "Products moved to the spill file");
+  fault_count_    = m.make_counter("order_tracker_faults_total",
+                                   "Products faulted back from the spill file");
+  spilled_orders_ = m.make_gauge("order_tracker_spilled_orders",
+                                 "Resting orders held in the spill file");
+}
 
 ////////
 /// execute
@@ -23,31 +230,81 @@ order_tracker::
 exec(support::error_code& err) {
 
   ////////
-  /// attempt to open input file
+  /// attempt to open input file [plain, gzip or zstd]
   ////////
-  std::ifstream ifs(file_);
-  if ( !ifs) {
-    std::string s = "Bad input file: <:" + file_ + ">";
-    err = support::error_code(-1, s);
+  if ( !support::pin(err, opts_.cpu)) {
     return false;
   }
+  support::source in(file_, opts_.input_buffer, opts_.input_cpu);
+  if ( !in.open(err)) {
+    return false;
+  }
+  if (opts_.partitioned) {
+    files_.reset(new product_files(opts_.files));
+    if ( !files_->open(err)) {
+      return false;
+    }
+  }
+  if (!opts_.spill.empty() && opts_.spill_window && !opts_.matching) {
+    spill_.reset(new spill_file(opts_.spill));
+    if ( !spill_->open(err)) {
+      return false;
+    }
+  }
+  if (opts_.profile) {
+    perf_.reset(new support::perf_counters(
+      { "read", "parse", "apply", "trace", "resolve" }));
+  }
+  ////////
+  /// failing past this point still stops the profile and indexes
+  /// whatever the bucket files got
+  ////////
+  auto fail = [this, &err]() {
+    if (files_) files_->close(err);
+    if (perf_) perf_->leave();
+    return false;
+  };
   ////////
   /// start reading each line from the file
   ////////
   std::string line;
-  while (std::getline(ifs, line)) {
-
+  size_t errors = 0;
+  size_t next_trace = opts_.trace_interval ?
+    opts_.trace_interval : std::numeric_limits<size_t>::max();
+  for (;;) {
+
+    if (perf_) perf_->enter(stage_read);
+    if ( !in.getline(line)) {
+      break;
+    }
     ////////
     /// attempt to create an order from the line
     ////////
-    order::ptr  op = std::make_shared<order>();
-    if ( !op->init(err, line)) {
+    if (perf_) perf_->enter(stage_parse);
+    order::ptr  op;
+    bool        ok;
+    {
+      support::allocations::scope s(support::allocations::parse);
+      op = std::allocate_shared<order>(
+        support::arena_allocator<order>(arena_.get()));
+      ok = op->init(err, line);
+    }
+
+    if (perf_) perf_->enter(stage_apply);
+    if ( !ok) {
+    }
+    ////////
+    /// bring spilled products back before the handlers look
+    ////////
+    else if (spill_ && !tier(err, *op)) {
+      return fail();
     }
     ////////
     /// handle new order
     ////////
     else if (op->action == action_t::new_order) {
-      handle_new(err, op);
+      if (opts_.matching) match_new(err, op);
+      else                handle_new(err, op);
     }
     ////////
     /// handle cancel order
@@ -64,20 +321,98 @@ exec(support::error_code& err) {
     ////////
     /// handle trade message
     ////////
-    else if (op->action == action_t::trade) {
+    else if (op->action == action_t::trade && !opts_.matching) {
       handle_trade(err, op);
     }
     ////////
-    /// trace every 10 messages - invalid or not ?
+    /// metrics - errors are whatever the handlers appended
     ////////
-    if (++message_count_ % 10 == 0) {
-      std::cout << orders_ << std::endl;
+    messages_[static_cast<size_t>(op->action)].add();
+    const size_t e = err.size();
+    if (e > errors) {
+      errors_.add(e - errors);
+      errors = e;
     }
+    book_orders_.set(opts_.matching ? engine_.size() : orders_.size());
+
+    ////////
+    /// let snapshot readers see what the handlers touched
+    ////////
+    if (perf_) perf_->enter(stage_trace);
+    if (opts_.snapshot_interval &&
+        (message_count_ + 1) % opts_.snapshot_interval == 0) {
+      publish();
+    }
+    ////////
+    /// trace every n messages - invalid or not ?
+    ////////
+    if (++message_count_ == next_trace) {
+      next_trace += opts_.trace_interval;
+      trace_book();
+      if ( !files_) {
+        out_ << std::endl;
+      }
+    }
+  }
+  ////////
+  /// a broken compressed stream ends the run
+  ////////
+  if ( !in.good(err)) {
+    return fail();
+  }
+  ////////
+  /// matched book can never be crossed
+  ////////
+  if (perf_) perf_->enter(stage_resolve);
+  if (spill_ && !fault_all(err)) {
+    return fail();
+  }
+  if (!opts_.matching) {
+    resolve();
+  }
+  if (opts_.snapshot_interval) {
+    publish();
+  }
+  ////////
+  /// final book and unresolved orders go w/ their product too
+  ////////
+  if (files_) {
+    trace_book();
+
+    order_set::const_iterator p = potentials_.begin();
+    for (; p != potentials_.end(); ++p) {
+      files_->select((*p)->prod) << "U, " << **p << std::endl;
+    }
+    if ( !files_->close(err)) {
+      if (perf_) perf_->leave();
+      return false;
+    }
+  }
+  if (perf_) {
+    perf_->leave();
+    perf_->messages(message_count_);
   }
-  resolve();
   return err;
 }
 
+////////
+/// stats
+////////
+const product_stats&
+order_tracker::
+stats() const {
+  return stats_;
+}
+
+////////
+/// snapshots
+////////
+book_snapshots&
+order_tracker::
+snapshots() {
+  return snapshots_;
+}
+
 ////////
 /// order constructor
 ////////
@@ -89,7 +424,8 @@ order() :
   id      (-1),
   side    (side_t::unknown),
   quantity(-1),
-  price   (-1)
+  price   (-1),
+  seq     (0)
 {}
 
 ////////
@@ -98,6 +434,35 @@ order() :
 typedef boost::tokenizer<boost::char_separator<char>> tokenizer_t;
 static boost::char_separator<char> the_sep(",");
 
+////////
+/// error categories; messages are formatted only when traced
+////////
+static const support::error_category empty_field(
+  -1, "Empty {} for line <{}>");
+static const support::error_category negative_field(
+  -1, "Negative {} for line <{}>");
+static const support::error_category invalid_line(
+  -1, "Cannot parse invalid line <{}>");
+static const support::error_category invalid_action(
+  -1, "Cannot parse, invalid action <{}>");
+static const support::error_category invalid_new(
+  -1, "Cannot parse, invalid tokens for new line <{}>");
+static const support::error_category invalid_amend(
+  -1, "Cannot parse, invalid tokens for cancel/modify <{}>");
+static const support::error_category invalid_trade(
+  -1, "Cannot parse, invalid tokens for trade <{}>");
+static const support::error_category invalid_side(
+  -1, "Invalid buy/sell inidicator for line <{}>");
+static const support::error_category duplicate_order(
+  -1, "Failed to add new order to order book - duplicate; order id <{}>");
+static const support::error_category cancel_not_found(
+  -1, "Failed to cancel order - not found; order id <{}>");
+static const support::error_category modify_not_found(
+  -1, "Failed to modify order - not found; order id <{}>");
+static const support::error_category trade_not_filled(
+  -1, "Invalid trade (X) transaction; quantiy not zero for {} side. "
+      "Product {} price {} quantity {}");
+
 ////////
 /// parse int
 ////////
@@ -105,19 +470,17 @@ bool
 parse_int(support::error_code& err,
           int& result,
           tokenizer_t::const_iterator p,
-          const std::string& field,
+          const char* field,
           const std::string& line) {
 
   const std::string q = boost::trim_copy(*p);
   if (q.empty()) {
-    std::string s = "Empty " + field + " for line <" + line + ">";
-    err.append(-1, s);
+    err.append(empty_field, field, line);
     return false;
   }
   result = ::atoi(q.c_str());
   if (result <= 0) {
-    std::string s = "Negative " + field + " for line <" + line + ">";
-    err.append(-1, s);
+    err.append(negative_field, field, line);
     return false;
   }
   return true;
@@ -141,8 +504,7 @@ init(support::error_code& err,
   /// must be able to see action
   ////////
   if (!size) {
-    std::string  s = "Cannot parse invalid line <" + line + ">";
-    err.append(-1, s );
+    err.append(invalid_line, line);
     return false;
   }
   ////////
@@ -150,8 +512,7 @@ init(support::error_code& err,
   ////////
   const std::string t = boost::trim_copy(*p);
   if (t != "N" && t != "R" && t != "M" && t != "X") {
-    std::string s = "Cannot parse, invalid action <" + line + ">";
-    err.append(-1, s);
+    err.append(invalid_action, line);
     return false;
   }
   action = t == "N" ? action_t::new_order :
@@ -163,22 +524,16 @@ init(support::error_code& err,
   /// each action has a different number of tokens
   ////////
   if (action == action_t::new_order && size != 6) {
-    std::string s = "Cannot parse, invalid tokens for new line <";
-    s += line + ">";
-    err.append(-1, s);
+    err.append(invalid_new, line);
     return false;
   }
   else if ((action == action_t::cancel ||
            action == action_t::modify) && size != 5) {
-    std::string s = "Cannot parse, invalid tokens for cancel/modify <";
-    s += line + ">";
-    err.append(-1, s);
+    err.append(invalid_amend, line);
     return false;
   }
   else if (action == action_t::trade && size != 4) {
-    std::string s = "Cannot parse, invalid tokens for trade <";
-    s += line + ">";
-    err.append(-1, s);
+    err.append(invalid_trade, line);
     return false;
   }
   ////////
@@ -215,8 +570,7 @@ init(support::error_code& err,
     ////////
     const std::string q = boost::trim_copy(*p);
     if (q.empty() || (q != "B" && q != "S")) {
-      std::string s = "Invalid buy/sell inidicator for line <" + line + ">";
-      err.append(-1, s);
+      err.append(invalid_side, line);
       return false;
     }
     side = q == "B" ? side_t::buy : side_t::sell;
@@ -260,16 +614,19 @@ order_tracker::
 handle_new(support::error_code& err,
            order::ptr op) {
 
+  support::allocations::scope scope(support::allocations::handle_new);
+
   ////////
   /// attempt to insert into container
   ////////
   order_id_ndx& ndx = orders_.get<order_id_tag>();
+  op->seq = ++seq_;
   std::pair<order_id_ndx::iterator, bool>  p = orders_.insert(op);
   if (!p.second) {
-    std::string s = "Failed to add new order to order book - duplicate; ";
-    s += "order id <" + std::to_string(op->id) + ">";
-    err.append(-1, s );
+    err.append(duplicate_order, op->id);
+    return;
   }
+  added(op->prod, op->side, op->price, op->id, op->quantity);
 }
 
 ////////
@@ -279,6 +636,22 @@ void
 order_tracker::
 handle_cancel(support::error_code& err,
               order::ptr op) {
+  support::allocations::scope scope(support::allocations::handle_cancel);
+
+  ////////
+  /// matching mode unlinks from the engine's level
+  ////////
+  if (opts_.matching) {
+    int prod, price, quantity;
+    bool buy;
+    if (!engine_.locate(op->id, prod, buy, price, quantity)) {
+      err.append(cancel_not_found, op->id);
+      return;
+    }
+    engine_.cancel(op->id);
+    removed(prod, buy ? side_t::buy : side_t::sell, price, op->id);
+    return;
+  }
   ////////
   /// attempt to find by order id in container
   ////////
@@ -286,14 +659,13 @@ handle_cancel(support::error_code& err,
   order_id_ndx::iterator i = ndx.find(op->id);
 
   if (i == ndx.end()) {
-    std::string s = "Failed to cancel order - not found; ";
-    s += "order id <" + std::to_string(op->id) + ">";
-    err.append(-1, s);
+    err.append(cancel_not_found, op->id);
   }
   ////////
   /// erase order from order table
   ////////
   else {
+    removed((*i)->prod, (*i)->side, (*i)->price, (*i)->id);
     ndx.erase(i);
   }
 }
@@ -306,22 +678,72 @@ order_tracker::
 handle_modify(support::error_code& err,
               order::ptr op) {
 
+  support::allocations::scope scope(support::allocations::handle_modify);
+
+  ////////
+  /// matching mode relocates the engine's resting order; a price
+  /// amend may cross and trade
+  ////////
+  if (opts_.matching) {
+    int prod, price, quantity;
+    bool buy;
+    if (!engine_.locate(op->id, prod, buy, price, quantity)) {
+      err.append(modify_not_found, op->id);
+      return;
+    }
+    engine_.modify(op->id, op->quantity, op->price);
+    const side_t side = buy ? side_t::buy : side_t::sell;
+    if (op->price == price && op->quantity <= quantity) {
+      changed(prod, side, price, op->id, op->quantity);
+    }
+    else {
+      removed(prod, side, price, op->id);
+      const int left = op->quantity - filled(side);
+      if (left > 0) {
+        added(prod, side, op->price, op->id, left);
+      }
+    }
+
+    const matching_engine::tape_t& tape = engine_.tape();
+    for (size_t i = 0; i < tape.size(); ++i) {
+      trace_trade_counts(tape[i].prod, tape[i].quantity, tape[i].price);
+    }
+    return;
+  }
   ////////
   /// attempt to find by order id in container
   ////////
   order_id_ndx& ndx = orders_.get<order_id_tag>();
   order_id_ndx::iterator i = ndx.find(op->id);
   if (i == ndx.end()) {
-    std::string s = "Failed to modify order - not found; ";
-    s += "order id <" + std::to_string(op->id) + ">";
-    err.append(-1, s);
+    err.append(modify_not_found, op->id);
+    return;
   }
   ////////
   /// guess all ok; update quantity
   /// -> or are we supposed to subtract quantity.....
+  /// - a price amend or a quantity increase loses queue priority, as
+  ///   in matching mode; a decrease keeps it
+  ////////
+  const int price = op->price;
+  const bool requeue = price != (*i)->price || op->quantity > (*i)->quantity;
+  (*i)->quantity = op->quantity;
+
   ////////
+  /// a fresh arrival sorts after every order at the new price, so the
+  /// one relink lands it at the level's tail
+  ////////
+  if (requeue) {
+    removed((*i)->prod, (*i)->side, (*i)->price, (*i)->id);
+    const uint64_t seq = ++seq_;
+    ndx.modify(i, [price, seq](order::ptr& o) {
+      o->price = price;
+      o->seq   = seq;
+    });
+    added((*i)->prod, (*i)->side, price, (*i)->id, (*i)->quantity);
+  }
   else {
-    (*i)->quantity = op->quantity;
+    changed((*i)->prod, (*i)->side, price, (*i)->id, (*i)->quantity);
   }
 }
 
@@ -345,6 +767,8 @@ order_tracker::
 handle_trade(support::error_code& err,
              order::ptr op) {
 
+  support::allocations::scope scope(support::allocations::handle_trade);
+
   ////////
   /// for the buy side locate the range; i guess buyer is willing to 
   /// pay upto the trade price...
@@ -371,12 +795,7 @@ handle_trade(support::error_code& err,
   /// trade indicated quantity should have hit zero for buy
   ////////
   if (qty != 0) {
-
-    std::string s = "Invalid trade (X) transaction; quantiy not zero ";
-    s += "for buy side. Product " + std::to_string(op->prod) + " ";
-    s += "price " + std::to_string(op->price) + " quantity ";
-    s += std::to_string(op->quantity);
-    err.append(-1, s);
+    err.append(trade_not_filled, "buy", op->prod, op->price, op->quantity);
     rollback(bp, buy_rollback);
     return;
   }
@@ -404,70 +823,92 @@ handle_trade(support::error_code& err,
   /// trade indicated quantity should have hit zero for sell
   ////////
   if (qty != 0) {
-    std::string s = "Invalid trade (X) transaction; quantiy not zero ";
-    s += "for sell side. Product " + std::to_string(op->prod) + " ";
-    s += "price " + std::to_string(op->price) + " quantity ";
-    s += std::to_string(op->quantity);
-    err.append(-1, s);
+    err.append(trade_not_filled, "sell", op->prod, op->price, op->quantity);
     rollback(sp, sell_rollback);
     rollback(bp, buy_rollback);
     return;
   }
   ////////
+  /// quantities changed across price ranges on both sides
+  ////////
+  if (opts_.snapshot_interval) {
+    for (size_t i = 0; i < buy_rollback.size(); ++i, ++bp) {
+      changed((*bp)->prod, (*bp)->side, (*bp)->price, (*bp)->id,
+              (*bp)->quantity);
+    }
+    for (size_t i = 0; i < sell_rollback.size(); ++i, ++sp) {
+      changed((*sp)->prod, (*sp)->side, (*sp)->price, (*sp)->id,
+              (*sp)->quantity);
+    }
+  }
+  ////////
   /// not sure why we need this tracing
   ////////
-  trace_trade_counts(op);
+  trace_trade_counts(op->prod, op->quantity, op->price);
 }
 
 ////////
-/// trace trade counts
+/// match new
 ////////
 void
 order_tracker::
-trace_trade_counts(order::ptr op) {
+match_new(support::error_code& err,
+          order::ptr op) {
 
-  ////////
-  /// find by product id in trade counts map
-  ////////
-  trade_counts::iterator i = trade_counts_.find(op->prod);
+  support::allocations::scope scope(support::allocations::handle_new);
 
-  ////////
-  /// insert new entry
-  ////////
-  if (i == trade_counts_.end()) {
-    i = trade_counts_.insert(
-      std::pair(op->prod, trade_count{op->quantity, op->price})).first;
+  matching_engine::side_t side = op->side == side_t::buy ?
+    matching_engine::side_t::buy : matching_engine::side_t::sell;
+
+  if (!engine_.add(op->id, op->prod, side, op->quantity, op->price)) {
+    err.append(duplicate_order, op->id);
+    return;
   }
+  const int left = op->quantity - filled(op->side);
+  if (left > 0) {
+    added(op->prod, op->side, op->price, op->id, left);
+  }
+
   ////////
-  /// existing entry - price changed
+  /// trace the internally generated trades like reported ones
   ////////
-  else if (i->second.price != op->price) {
-    i->second.count = op->quantity;
-    i->second.price = op->price;
+  const matching_engine::tape_t& tape = engine_.tape();
+  for (size_t i = 0; i < tape.size(); ++i) {
+    trace_trade_counts(tape[i].prod, tape[i].quantity, tape[i].price);
   }
+}
+
+////////
+/// trace trade counts
+////////
+void
+order_tracker::
+trace_trade_counts(int prod,
+                   int quantity,
+                   int price) {
+
   ////////
-  /// existing entry - price did not change
+  /// O(1) statistics update; run length restarts on a price change
   ////////
-  else {
-    i->second.count += op->quantity;
-  }
+  const int run = stats_.record(prod, quantity, price);
+
   ////////
   /// finally trace the trade message
   ////////
-  std::cout << "X,"
-            << op->prod
-            << ","
-            << op->quantity
-            << ","
-            << op->price
-            << " => "
-            << "product "
-            << op->prod
-            << ": "
-            << i->second.count
-            << "@"
-            << i->second.price
-            << std::endl;
+  out_for(prod) << "X,"
+       << prod
+       << ","
+       << quantity
+       << ","
+       << price
+       << " => "
+       << "product "
+       << prod
+       << ": "
+       << run
+       << "@"
+       << price
+       << std::endl;
 }
 
 ////////
@@ -477,6 +918,8 @@ void
 order_tracker::
 resolve() {
 
+  support::allocations::scope scope(support::allocations::resolve);
+
   const order_id_ndx& oin = orders_.get<order_id_tag>();
   order_id_ndx::const_iterator p = oin.begin();
   order_id_ndx::const_iterator q = oin.end();
@@ -507,6 +950,90 @@ resolve() {
   }
 }
 
+////////
+/// added
+////////
+void
+order_tracker::
+added(int prod,
+      side_t side,
+      int price,
+      int id,
+      int quantity) {
+  if (opts_.snapshot_interval) {
+    snapshots_.add(prod, side == side_t::buy ? 'B' : 'S', price, id, quantity);
+  }
+}
+
+////////
+/// changed
+////////
+void
+order_tracker::
+changed(int prod,
+        side_t side,
+        int price,
+        int id,
+        int quantity) {
+  if (opts_.snapshot_interval) {
+    snapshots_.update(prod, side == side_t::buy ? 'B' : 'S', price, id,
+                      quantity);
+  }
+}
+
+////////
+/// removed
+////////
+void
+order_tracker::
+removed(int prod,
+        side_t side,
+        int price,
+        int id) {
+  if (opts_.snapshot_interval) {
+    snapshots_.remove(prod, side == side_t::buy ? 'B' : 'S', price, id);
+  }
+}
+
+////////
+/// filled
+////////
+int
+order_tracker::
+filled(side_t side) {
+
+  const side_t other = side == side_t::buy ? side_t::sell : side_t::buy;
+  const matching_engine::tape_t& tape = engine_.tape();
+  int quantity = 0;
+  for (size_t i = 0; i < tape.size(); ++i) {
+    const matching_engine::fill& f = tape[i];
+    if (f.left) {
+      changed(f.prod, other, f.price, f.resting, f.left);
+    }
+    else {
+      removed(f.prod, other, f.price, f.resting);
+    }
+    quantity += f.quantity;
+  }
+  return quantity;
+}
+
+////////
+/// publish
+////////
+void
+order_tracker::
+publish() {
+
+  support::allocations::scope scope(support::allocations::tracing);
+
+  const std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  snapshots_.publish(message_count_);
+  publish_ns_.observe(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count());
+}
+
 ////////
 /// operator<< (order)
 ////////
@@ -541,56 +1068,287 @@ T& operator<<(T& out, const order_tracker::order& in) {
 }
 
 ////////
-/// operator<< (order_table)
+/// out for
 ////////
-template <class T>
-T& operator<<(T& out, const order_tracker::order_table& in) {
+support::sink&
+order_tracker::
+out_for(int prod) {
+  return files_ ? files_->select(prod) : out_;
+}
+
+////////
+/// tier
+/// - cancels and modifies only carry the order id; the spill file
+///   knows spilled ids, the id index the resident ones
+////////
+bool
+order_tracker::
+tier(support::error_code& err,
+     const order& o) {
+
+  int prod;
+  if (o.action != action_t::trade && spill_->owner(o.id, prod)) {
+    if ( !fault(err, prod)) {
+      return false;
+    }
+    active_[prod] = message_count_;
+  }
+  if (o.action == action_t::new_order || o.action == action_t::trade) {
+    if ( !fault(err, o.prod)) {
+      return false;
+    }
+    active_[o.prod] = message_count_;
+  }
+  else {
+    const order_id_ndx& ndx = orders_.get<order_id_tag>();
+    order_id_ndx::const_iterator i = ndx.find(o.id);
+    if (i != ndx.end()) {
+      active_[(*i)->prod] = message_count_;
+    }
+  }
+  ////////
+  /// sweep a few times per window
+  ////////
+  if (message_count_ < next_sweep_) {
+    return true;
+  }
+  next_sweep_ = message_count_ + std::max<size_t>(opts_.spill_window / 4, 1);
+
+  std::vector<int> idle;
+  std::unordered_map<int, size_t>::const_iterator p = active_.begin();
+  for (; p != active_.end(); ++p) {
+    if (p->second + opts_.spill_window <= message_count_) {
+      idle.push_back(p->first);
+    }
+  }
+  for (size_t i = 0; i < idle.size(); ++i) {
+    if ( !spill(err, idle[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+////////
+/// spill
+////////
+bool
+order_tracker::
+spill(support::error_code& err,
+      int prod) {
+
+  active_.erase(prod);
+
+  prod_id_ndx& pn = orders_.get<prod_id_tag>();
+  std::pair<prod_id_ndx::iterator, prod_id_ndx::iterator> r =
+    pn.equal_range(prod);
+  if (r.first == r.second) {
+    return true;
+  }
+  ////////
+  /// records in product order; composite order as positions in it
+  ////////
+  std::vector<spill_file::record> records;
+  std::unordered_map<const order*, uint32_t> position;
+  for (prod_id_ndx::iterator i = r.first; i != r.second; ++i) {
+    const order& o = **i;
+    position[&o] = records.size();
+    records.push_back(spill_file::record{
+      o.id, o.prod, o.quantity, o.price, static_cast<int32_t>(o.side)});
+  }
+  std::vector<uint32_t> composite;
+  const composite_ndx& cn = orders_.get<composite_tag>();
+  composite_ndx::const_iterator c = cn.lower_bound(boost::make_tuple(prod));
+  composite_ndx::const_iterator d = cn.upper_bound(boost::make_tuple(prod));
+  for (; c != d; ++c) {
+    composite.push_back(position[c->get()]);
+  }
+  if ( !spill_->put(err, prod, records, composite)) {
+    return false;
+  }
+  pn.erase(r.first, r.second);
+
+  ++spills_;
+  spill_count_.add();
+  spilled_orders_.set(spill_->orders());
+  peak_spilled_ = std::max(peak_spilled_, spill_->orders());
+  return true;
+}
+
+////////
+/// fault
+/// - inserting in product order rebuilds the product index; fresh
+///   arrivals handed out in composite order rebuild every level's fifo
+////////
+bool
+order_tracker::
+fault(support::error_code&,
+      int prod) {
+
+  std::vector<spill_file::record> records;
+  std::vector<uint32_t> composite;
+  if ( !spill_->take(prod, records, composite)) {
+    return true;
+  }
+  std::vector<order::ptr> ptrs;
+  ptrs.reserve(records.size());
+  for (size_t i = 0; i < records.size(); ++i) {
+    const spill_file::record& r = records[i];
+    order::ptr op = std::allocate_shared<order>(
+      support::arena_allocator<order>(arena_.get()));
+    op->action   = action_t::new_order;
+    op->prod     = r.prod;
+    op->id       = r.id;
+    op->side     = static_cast<side_t>(r.side);
+    op->quantity = r.quantity;
+    op->price    = r.price;
+    ptrs.push_back(op);
+  }
+  for (size_t i = 0; i < composite.size(); ++i) {
+    ptrs[composite[i]]->seq = ++seq_;
+  }
+  for (size_t i = 0; i < ptrs.size(); ++i) {
+    orders_.insert(ptrs[i]);
+  }
+  ++faults_;
+  fault_count_.add();
+  spilled_orders_.set(spill_->orders());
+  return true;
+}
+
+////////
+/// fault all
+////////
+bool
+order_tracker::
+fault_all(support::error_code& err) {
 
+  std::vector<int> prods;
+  spill_file::products_t::const_iterator p = spill_->products().begin();
+  for (; p != spill_->products().end(); ++p) {
+    prods.push_back(p->first);
+  }
+  for (size_t i = 0; i < prods.size(); ++i) {
+    if ( !fault(err, prods[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+////////
+/// trace book
+////////
+void
+order_tracker::
+trace_book() {
+
+  support::allocations::scope scope(support::allocations::tracing);
+
+  auto out_for = [this](int prod) -> support::sink& {
+    return this->out_for(prod);
+  };
+  if (opts_.matching) engine_.trace(out_for, opts_.trace_limit);
+  else                trace(orders_, opts_.trace_limit, out_for, spill_.get());
+}
+
+////////
+/// trace
+////////
+template <class F>
+void
+order_tracker::
+trace(const order_table& orders,
+      size_t limit,
+      F out_for,
+      const spill_file* spilled) {
+
+  ////////
+  /// spilled products below prod go first; they keep product order
+  /// in the file so the first limit records are the ones to trace
+  ////////
+  spill_file::products_t::const_iterator s, e;
+  if (spilled) {
+    s = spilled->products().begin();
+    e = spilled->products().end();
+  }
+  auto trace_spilled = [&](bool all, int prod) {
+    for (; spilled && s != e && (all || s->first < prod); ++s) {
+      spilled->visit(s->second, limit, [&](const spill_file::record& r) {
+        order o;
+        o.action   = action_t::new_order;
+        o.prod     = r.prod;
+        o.id       = r.id;
+        o.side     = static_cast<side_t>(r.side);
+        o.quantity = r.quantity;
+        o.price    = r.price;
+        out_for(o.prod) << o << std::endl;
+      });
+    }
+  };
   ////////
   /// acquire index for product id
   ////////
-  const order_tracker::prod_id_ndx& ndx = in.get<order_tracker::prod_id_tag>();
-  order_tracker::prod_id_ndx::const_iterator p = ndx.begin();
+  const prod_id_ndx& ndx = orders.get<prod_id_tag>();
+  prod_id_ndx::const_iterator p = ndx.begin();
 
   size_t traced = 0;
   int last_prod = -1;
 
   for (; p != ndx.end(); ++p) {
 
-    order_tracker::order::ptr op = *p;
+    order::ptr op = *p;
 
     ////////
     /// reset count when product changes
     ////////
     if (last_prod != op->prod) {
+      trace_spilled(false, op->prod);
       last_prod = op->prod;
       traced = 0;
     }
     ////////
-    /// noop if traced count hits 5??
+    /// noop if traced count hits the limit
     ////////
-    if (traced == 5) {
+    if (traced == limit) {
     }
     ////////
     /// trace the order
     ////////
     else {
-      out << *op << std::endl;
+      out_for(op->prod) << *op << std::endl;
       ++traced;
     }
   }
-  return out;
+  trace_spilled(true, 0);
 }
- 
+
 ////////
 /// operator<< (order_tracker)
 ////////
 template <class T>
 T& operator<<(T& out, const order_tracker& in) {
 
-  out << in.orders_;
-
-  if (!in.potentials_.empty()) {
+  if (in.opts_.stats) {
+    out << in.stats_;
+  }
+  ////////
+  /// partitioned runs left the book and unresolved orders in files
+  ////////
+  if (in.opts_.partitioned) {
+  }
+  else if (in.opts_.matching) {
+    in.engine_.trace([&out](int) -> T& { return out; }, in.opts_.trace_limit);
+  }
+  else {
+    order_tracker::trace(in.orders_, in.opts_.trace_limit,
+                         [&out](int) -> T& { return out; });
+  }
+  if (in.opts_.matching) {
+    out << in.engine_.latencies();
+  }
+  if (!in.opts_.matching && !in.opts_.partitioned &&
+      !in.potentials_.empty()) {
 
     out << "Unresolved orders: " << std::endl;
     order_tracker::order_set::const_iterator p = in.potentials_.begin();
@@ -601,22 +1359,209 @@ T& operator<<(T& out, const order_tracker& in) {
       out << *op << std::endl;
     }
   }
+  if (in.spill_) {
+    out << "Spill: spills "
+        << in.spills_
+        << ", faults "
+        << in.faults_
+        << ", peak spilled orders "
+        << in.peak_spilled_
+        << ", file bytes "
+        << in.spill_->size()
+        << std::endl;
+  }
+  if (in.arena_) {
+    out << *in.arena_;
+  }
+  if (in.perf_) {
+    out << *in.perf_;
+  }
   return out;
 }
 
 }  /// namespace trade
 
-int main(int argc, const char** argv) {
+int main(int argc, char** argv) {
 
-  if (argc != 2) {
-    std::cout << "Usage: <" << argv[0] << "> <filename>" << std::endl;
+  ////////
+  /// -m   -> matching mode
+  /// -w   -> background output writer
+  /// -l   -> lint only
+  /// -j n -> scan threads
+  /// -e n -> offending lines reported by lint
+  /// -s   -> trace per product statistics
+  /// -i n -> publish book snapshots every n messages
+  /// -p   -> per stage hardware counter profile
+  /// -H t -> arena backed by transparent huge pages [h -> hugetlb]
+  /// -n n -> arena memory preferred on numa node n
+  /// -c l -> pin exec, input, then output threads to the cpus in comma
+  ///         separated list l
+  /// -o d -> per product bucket files and index in directory d
+  /// -b n -> bucket files for -o
+  /// -S f -> tiered book w/ spill file f
+  /// -W n -> spill products idle for n messages
+  /// -M f -> dump process metrics to file f [prometheus text]
+  /// -I n -> metrics dump interval in milliseconds
+  /// -f f -> configuration file
+  /// -F f -> configuration file, w/ a binary image cached at f.cache
+  /// -k kv -> configuration override key=value [repeatable]
+  ///
+  /// configuration is applied first, flags override it
+  ////////
+  static const char* flags = "mwlj:e:si:pH:n:c:o:b:S:W:M:I:f:F:k:";
+  support::config& config = support::config::instance();
+  int c;
+  opterr = 0;
+  while ((c = ::getopt(argc, argv, flags)) != -1) {
+    if (c == 'f' || c == 'F') {
+      support::error_code err;
+      if (!config.init(err, optarg, c == 'F')) {
+        std::cout << err;
+        return -1;
+      }
+    }
+    else if (c == 'k') {
+      std::string kv = optarg;
+      size_t eq = kv.find('=');
+      if (eq == std::string::npos || !eq) {
+        std::cout << "Bad config override: <" << kv << ">" << std::endl;
+        return -1;
+      }
+      std::string k = kv.substr(0, eq);
+      std::string v = kv.substr(eq + 1);
+      char* end = nullptr;
+      long  i = ::strtol(v.c_str(), &end, 10);
+      if (v == "true" || v == "false") {
+        config.insert_or_assign<bool>(k, v == "true");
+      }
+      else if (!v.empty() && !*end && i >= INT_MIN && i <= INT_MAX) {
+        config.insert_or_assign<int>(k, int(i));
+      }
+      else {
+        config.insert_or_assign<std::string>(k, v);
+      }
+    }
+  }
+  trade::order_tracker::options opts;
+  {
+    support::error_code err;
+    if (!opts.configure(err, config)) {
+      std::cout << err;
+      return -1;
+    }
+  }
+  std::vector<int> cpus;
+  optind = 0;
+  opterr = 1;
+  while ((c = ::getopt(argc, argv, flags)) != -1) {
+    if (c == 'f' || c == 'F' || c == 'k') {
+    }
+    else if (c == 'm') {
+      opts.matching = true;
+    }
+    else if (c == 'w') {
+      opts.output.background = true;
+    }
+    else if (c == 'l') {
+      opts.lint = true;
+    }
+    else if (c == 'j') {
+      opts.threads = ::atoi(optarg);
+    }
+    else if (c == 'e') {
+      opts.lint_report = ::atoi(optarg);
+    }
+    else if (c == 's') {
+      opts.stats = true;
+    }
+    else if (c == 'i') {
+      opts.snapshot_interval = ::atoi(optarg);
+    }
+    else if (c == 'p') {
+      opts.profile = true;
+    }
+    else if (c == 'H') {
+      opts.arena = true;
+      opts.memory.pages = optarg[0] == 'h' ?
+        support::arena::pages_t::hugetlb :
+        support::arena::pages_t::transparent;
+    }
+    else if (c == 'n') {
+      opts.arena = true;
+      opts.memory.node = ::atoi(optarg);
+    }
+    else if (c == 'c') {
+      cpus = support::cpus(optarg);
+    }
+    else if (c == 'o') {
+      opts.partitioned = true;
+      opts.files.dir = optarg;
+    }
+    else if (c == 'b') {
+      opts.files.buckets = ::atoi(optarg);
+    }
+    else if (c == 'S') {
+      opts.spill = optarg;
+    }
+    else if (c == 'W') {
+      opts.spill_window = ::atoi(optarg);
+    }
+    else if (c == 'M') {
+      opts.metrics = optarg;
+    }
+    else if (c == 'I') {
+      opts.metrics_interval = std::chrono::milliseconds(::atoi(optarg));
+    }
+    else {
+      optind = argc + 1;
+      break;
+    }
+  }
+  if (optind != argc - 1) {
+    std::cout << "Usage: <" << argv[0] << "> [-m] [-w] [-l] [-j threads] "
+              << "[-e lines] [-s] [-i interval] [-p] "
+              << "[-H t|h] [-n node] [-c cpus] [-o dir] [-b buckets] "
+              << "[-S file] [-W window] [-M file] [-I interval] "
+              << "[-f config] [-F config] [-k key=value] <filename>"
+              << std::endl;
     return -1;
   }
-  trade::order_tracker ot(argv[1]);
+  opts.cpu        = cpus.size() > 0 ? cpus[0] : -1;
+  opts.input_cpu  = cpus.size() > 1 ? cpus[1] : -1;
+  opts.output.cpu = cpus.size() > 2 ? cpus[2] : -1;
+  support::sink out(STDOUT_FILENO, opts.output);
+
+  ////////
+  /// lint exits non zero on any offending line
+  ////////
+  if (opts.lint) {
+    trade::feed_validator fv(argv[optind], opts.threads, opts.lint_report);
+    support::error_code err;
+    if (!fv.exec(err)) {
+      out << err;
+      return -1;
+    }
+    out << fv;
+    return fv.clean() ? 0 : 1;
+  }
+  trade::order_tracker ot(argv[optind], out, opts);
+
+  ////////
+  /// final dump happens before the tracker and its arena go away
+  ////////
+  std::unique_ptr<support::metrics::writer> metrics;
+  if (!opts.metrics.empty()) {
+    metrics.reset(new support::metrics::writer(
+      support::metrics::instance(), opts.metrics, opts.metrics_interval));
+  }
+
   support::error_code err;
   bool rc = ot.exec(err);
-  std::cout << ot;
+  out << ot;
   if (!rc) {
-    std::cout << err;
+    out << err;
+  }
+  if (support::allocations::enabled()) {
+    out << support::allocations();
   }
 }
@@ -3,6 +3,7 @@
 
 #include <memory>
 #include <set>
+#include <unordered_map>
 #include <boost/tokenizer.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
@@ -11,6 +12,17 @@
 #include <boost/multi_index/composite_key.hpp>
 #include <boost/multi_index/indexed_by.hpp>
 #include <ec.hpp>
+#include <os.hpp>
+#include <is.hpp>
+#include <me.hpp>
+#include <ps.hpp>
+#include <bs.hpp>
+#include <config.hpp>
+#include <pc.hpp>
+#include <ar.hpp>
+#include <pf.hpp>
+#include <mx.hpp>
+#include <sf.hpp>
 
 namespace trade {
 
@@ -23,15 +35,139 @@ class order_tracker {
 public:
 
   ////////
-  /// constructor w/ file name
+  /// run time options
   ////////
-  order_tracker(const std::string& file);
+  struct options {
+
+    ////////
+    /// defaults to reconcile mode
+    ////////
+    options();
+
+    ////////
+    /// configure semantics ->
+    /// - overrides fields w/ the "order_tracker.*" keys present in c
+    ///   [see om.cpp for the key list]
+    /// - false w/ err set on out of range values; fields already
+    ///   applied stay applied
+    ////////
+    bool configure(support::error_code& err, const support::config& c);
+
+    ////////
+    /// match incoming new orders in price-time priority instead
+    /// of reconciling reported trades; X messages are ignored
+    ////////
+    bool matching;
+
+    ////////
+    /// trace the book every n messages; 0 -> never
+    ////////
+    size_t trace_interval;
+
+    ////////
+    /// orders traced per product
+    ////////
+    size_t trace_limit;
+
+    ////////
+    /// only validate the feed [see feed_validator]
+    ////////
+    bool lint;
+
+    ////////
+    /// worker threads for parallel scans; 0 -> hardware concurrency
+    ////////
+    size_t threads;
+
+    ////////
+    /// offending lines listed by lint
+    ////////
+    size_t lint_report;
+
+    ////////
+    /// trace per product statistics at the end
+    ////////
+    bool stats;
+
+    ////////
+    /// publish a book snapshot for readers every n messages; 0 -> off
+    ////////
+    size_t snapshot_interval;
+
+    ////////
+    /// count cycles, cache/branch/tlb misses per stage [read, parse,
+    /// apply, trace, resolve] and trace them per message at the end
+    ////////
+    bool profile;
+
+    ////////
+    /// decompressed bytes per input buffer [two are in flight]
+    ////////
+    size_t input_buffer;
+
+    ////////
+    /// back orders, index nodes and the matching pool w/ an arena
+    /// [huge pages, numa node per memory]
+    ////////
+    bool arena;
+    support::arena::policy memory;
+
+    ////////
+    /// cpus for the exec thread and the input reader; -1 -> any
+    ////////
+    int cpu;
+    int input_cpu;
+
+    ////////
+    /// write book traces, trades and unresolved orders to per product
+    /// bucket files w/ an index instead of the output sink
+    ////////
+    bool partitioned;
+    product_files::policy files;
+
+    ////////
+    /// tiered book in reconcile mode - products idle for spill_window
+    /// messages are moved to this spill file and faulted back on their
+    /// next message; empty -> everything stays resident
+    ////////
+    std::string spill;
+    size_t spill_window;
+
+    ////////
+    /// dump process metrics to this file every metrics_interval and
+    /// once at exit; empty -> off
+    ////////
+    std::string metrics;
+    std::chrono::milliseconds metrics_interval;
+
+    ////////
+    /// output buffering
+    ////////
+    support::sink::policy output;
+  };
+
+  ////////
+  /// constructor w/ file name and output sink
+  ////////
+  order_tracker(const std::string& file,
+                support::sink& out,
+                const options& opts = options());
 
   ////////
   /// execute
   ////////
   bool exec(support::error_code& err);
 
+  ////////
+  /// per product trade statistics - safe to read from any thread
+  ////////
+  const product_stats& stats() const;
+
+  ////////
+  /// point in time book views - readers attach from any thread
+  ////////
+  book_snapshots& snapshots();
+
 private:
 
   ////////
@@ -44,6 +180,12 @@ private:
   ////////
   enum class action_t { new_order, cancel, modify, trade, unknown };
 
+  ////////
+  /// profiled stages of exec
+  ////////
+  enum stage_t { stage_read, stage_parse, stage_apply, stage_trace,
+                 stage_resolve };
+
   ////////
   /// order info
   ////////
@@ -65,6 +207,7 @@ private:
     side_t    side;      /// buy or sell
     int       quantity;  /// order quanity
     int       price;     /// order price
+    uint64_t  seq;       /// arrival at its level [see seq_]
 
     ////////
     /// shared ptr to order
@@ -85,7 +228,8 @@ private:
   ///   used in new, cancel, modify
   /// - [prod id] -> non-unique for tracing purposes
   /// - [side, product id, price] -> not unique but must be ordered
-  ///   to assist in matching/reconciling; used in trade
+  ///   to assist in matching/reconciling; used in trade; arrival
+  ///   keeps each level fifo
   ////////
   typedef mti::multi_index_container<
     order::ptr,
@@ -104,10 +248,12 @@ private:
           order::ptr,
           mti::member<order, int,    &order::prod>,
           mti::member<order, side_t, &order::side>,
-          mti::member<order, int,    &order::price>
+          mti::member<order, int,    &order::price>,
+          mti::member<order, uint64_t, &order::seq>
         >
       >
-    >
+    >,
+    support::arena_allocator<order::ptr>
   > order_table;
 
   ////////
@@ -118,24 +264,15 @@ private:
   typedef order_table::index<prod_id_tag>::type    prod_id_ndx;
 
   ////////
-  /// trade counts`
+  /// needed for some kind of reconciliation at the end; ordered by
+  /// order id so the unresolved trace doesn't depend on addresses
   ////////
-  struct trade_count {
-
-    trade_count(int c, int p) : count(c), price(p) {}
-
-    int count;
-    int price;
+  struct by_order_id {
+    bool operator()(const order::ptr& a, const order::ptr& b) const {
+      return a->id < b->id;
+    }
   };
-  ////////
-  /// maps [product id] -> [trade count]
-  ////////
-  typedef std::map<int, trade_count>  trade_counts;
-
-  ////////
-  /// needed for some kind of reconciliation at the end
-  ////////
-  typedef std::set<order::ptr>  order_set;
+  typedef std::set<order::ptr, by_order_id>  order_set;
 
   ////////
   /// handle new
@@ -163,10 +300,15 @@ private:
   void rollback(composite_ndx::iterator p,
                 const std::vector<int>& rollback);
 
+  ////////
+  /// handle new in matching mode
+  ////////
+  void match_new(support::error_code& err, order::ptr order);
+
   ////////
   /// trace trade counts
   ////////
-  void trace_trade_counts(order::ptr op);
+  void trace_trade_counts(int prod, int quantity, int price);
 
   ////////
   /// resolve
@@ -174,16 +316,63 @@ private:
   void resolve();
 
   ////////
-  /// for tracing order
+  /// mirror a book change into the next snapshot; noop w/o snapshots
+  /// - added joins its level's tail, changed keeps its place, removed
+  ///   leaves its level
   ////////
-  template <class T>
-  friend T& operator<<(T& out, const order& in);
+  void added(int prod, side_t side, int price, int id, int quantity);
+  void changed(int prod, side_t side, int price, int id, int quantity);
+  void removed(int prod, side_t side, int price, int id);
 
   ////////
-  /// for tracing order table
+  /// mirror the resting orders the last engine fills hit; side is the
+  /// aggressor's; returns the filled quantity
+  ////////
+  int filled(side_t side);
+
+  ////////
+  /// publish the mirrored changes to snapshot readers
+  ////////
+  void publish();
+
+  ////////
+  /// stream for prod's output - its bucket file when partitioned
+  ////////
+  support::sink& out_for(int prod);
+
+  ////////
+  /// trace the book per options to out_for(prod)
+  ////////
+  void trace_book();
+
+  ////////
+  /// trace up to limit orders per product to out_for(prod); spilled
+  /// products are merged in from the spill file
+  ////////
+  template <class F>
+  static void trace(const order_table& orders,
+                    size_t limit,
+                    F out_for,
+                    const spill_file* spilled = nullptr);
+
+  ////////
+  /// tiering semantics ->
+  /// - tier: makes the products o refers to resident and marks them
+  ///   active; sweeps idle products out every so often
+  /// - spill: moves prod's resting orders to the spill file
+  /// - fault: moves them back, product and composite order intact
+  /// - false w/ err appended if the spill file failed
+  ////////
+  bool tier(support::error_code& err, const order& o);
+  bool spill(support::error_code& err, int prod);
+  bool fault(support::error_code& err, int prod);
+  bool fault_all(support::error_code& err);
+
+  ////////
+  /// for tracing order
   ////////
   template <class T>
-  friend T& operator<<(T& out, const order_table& in);
+  friend T& operator<<(T& out, const order& in);
 
   ////////
   /// for tracing order tracker
@@ -196,25 +385,88 @@ private:
   ////////
   const std::string file_;
 
+  ////////
+  /// trace, trade and unresolved output
+  ////////
+  support::sink& out_;
+
+  ////////
+  /// run time options
+  ////////
+  const options opts_;
+
+  ////////
+  /// backing memory when opts_.arena; outlives everything below
+  ////////
+  std::unique_ptr<support::arena> arena_;
+
   ////////
   /// the main order table
   ////////
   order_table  orders_;
 
+  ////////
+  /// last arrival handed out; an order requeued at its level takes a
+  /// fresh one, so a single relink puts it at the tail
+  ////////
+  uint64_t  seq_;
+
   ////////
   /// processed message count - used for tracing
   ////////
   size_t message_count_;
 
   /////////
-  /// for some tracing trade reason
+  /// per product trade statistics; also drives trade tracing
   /////////
-  trade_counts  trade_counts_;
+  product_stats  stats_;
+
+  ////////
+  /// views published to concurrent readers
+  ////////
+  book_snapshots  snapshots_;
 
   ////////
   /// potential matches
   ////////
   order_set potentials_;
+
+  ////////
+  /// resting book in matching mode
+  ////////
+  matching_engine engine_;
+
+  ////////
+  /// stage counters when profiling; opened on the exec thread
+  ////////
+  std::unique_ptr<support::perf_counters> perf_;
+
+  ////////
+  /// per product output when partitioned
+  ////////
+  std::unique_ptr<product_files> files_;
+
+  ////////
+  /// spilled products when tiered; active_ is the last message that
+  /// touched each resident product
+  ////////
+  std::unique_ptr<spill_file>      spill_;
+  std::unordered_map<int, size_t>  active_;
+  size_t                           next_sweep_;
+  size_t                           spills_;
+  size_t                           faults_;
+  size_t                           peak_spilled_;
+
+  ////////
+  /// process metrics; messages_ is indexed by action_t
+  ////////
+  support::metrics::counter    messages_[5];
+  support::metrics::counter    errors_;
+  support::metrics::gauge      book_orders_;
+  support::metrics::histogram  publish_ns_;
+  support::metrics::counter    spill_count_;
+  support::metrics::counter    fault_count_;
+  support::metrics::gauge      spilled_orders_;
 };
 
 };
@@ -0,0 +1,194 @@
+#ifndef __EXP_OUTPUT_SINK_HPP__
+#define __EXP_OUTPUT_SINK_HPP__
+
+#include <string>
+#include <string_view>
+#include <ostream>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <unistd.h>
+#include <af.hpp>
+
+namespace support {
+
+////////
+/// buffered output sink
+/// - appends into a preallocated buffer, formats integers itself
+/// - writes to a file descriptor according to a flush policy
+/// - optionally hands full buffers to a background writer thread
+/// - streams like std::ostream for the templated operator<<s;
+///   std::endl is a newline, std::flush an explicit flush
+////////
+class sink {
+public:
+
+  ////////
+  /// when to write the buffer out
+  /// - size     -> once flush_size bytes are buffered
+  /// - interval -> at the first newline interval after the last write
+  /// - manual   -> only on flush() [or when the buffer is full]
+  ////////
+  enum class flush_t { size, interval, manual };
+
+  ////////
+  /// buffering policy
+  ////////
+  struct policy {
+
+    ////////
+    /// 1MB buffer flushed by size on the calling thread
+    ////////
+    policy();
+
+    size_t                     capacity;    /// buffer bytes
+    flush_t                    flush;       /// flush trigger
+    size_t                     flush_size;  /// bytes for flush_t::size
+    std::chrono::milliseconds  interval;    /// period for flush_t::interval
+    bool                       background;  /// write on a writer thread
+    int                        cpu;         /// writer thread cpu; -1 -> any
+  };
+
+  ////////
+  /// semantics ->
+  /// - allocates front [and back] buffers of policy capacity
+  /// - starts the writer thread if background
+  ////////
+  sink(int fd, const policy& p = policy());
+
+  ////////
+  /// semantics ->
+  /// - flushes remaining data
+  /// - stops and joins the writer thread
+  /// - does not close fd
+  ////////
+  ~sink();
+
+  ////////
+  /// copy/move disabled
+  ////////
+  sink(const sink&) = delete;
+  sink& operator=(const sink&) = delete;
+
+  ////////
+  /// flush semantics ->
+  /// - noop if nothing is buffered
+  /// - foreground -> writes buffer to fd
+  /// - background -> waits for the writer to drain the back buffer,
+  ///   swaps buffers and wakes the writer
+  ////////
+  void flush();
+
+  ////////
+  /// wait semantics ->
+  /// - background -> blocks until the writer drained what was flushed
+  /// - foreground -> noop
+  ////////
+  void wait();
+
+  ////////
+  /// false once a write to fd failed
+  ////////
+  bool good() const;
+
+  ////////
+  /// bytes accepted so far [written or buffered]; the offset in fd
+  /// of the next byte if fd started empty
+  ////////
+  uint64_t position() const;
+
+  ////////
+  /// raw append; no flush policy, whatever the bytes
+  ////////
+  sink& write(const char* p, size_t n);
+
+  ////////
+  /// stream semantics ->
+  /// - append text or formatted number
+  /// - newlines may trigger a flush per policy, including ones
+  ///   embedded in strings
+  ////////
+  sink& operator<<(char c);
+  sink& operator<<(const char* s);
+  sink& operator<<(const std::string& s);
+  sink& operator<<(std::string_view s);
+  sink& operator<<(int v);
+  sink& operator<<(unsigned v);
+  sink& operator<<(long v);
+  sink& operator<<(unsigned long v);
+  sink& operator<<(long long v);
+  sink& operator<<(unsigned long long v);
+  sink& operator<<(double v);
+  sink& operator<<(bool v);
+
+  ////////
+  /// manipulators -> std::endl, std::flush
+  ////////
+  sink& operator<<(std::ostream& (*m)(std::ostream&));
+
+private:
+
+  ////////
+  /// semantics ->
+  /// - formats v into buffer, buffer has room for 20 digits + sign
+  ////////
+  void format(unsigned long long v, bool negative);
+
+  ////////
+  /// semantics ->
+  /// - flushes when the buffer can't take n more bytes
+  ////////
+  void reserve(size_t n);
+
+  ////////
+  /// semantics ->
+  /// - write, then newline if the text holds a '\n'
+  ////////
+  sink& text(const char* p, size_t n);
+
+  ////////
+  /// semantics ->
+  /// - applies flush policy after a newline
+  ////////
+  void newline();
+
+  ////////
+  /// semantics ->
+  /// - write(2) loop w/ partial writes and EINTR
+  ////////
+  void drain(const char* p, size_t n);
+
+  ////////
+  /// writer thread body
+  ////////
+  void run();
+
+  typedef std::chrono::steady_clock clock_t;
+
+  int                      fd_;
+  policy                   policy_;
+  char*                    front_;
+  size_t                   size_;
+  uint64_t                 offset_;
+  char*                    back_;
+  size_t                   back_size_;
+  clock_t::time_point      last_;
+  std::atomic<bool>        good_;
+  bool                     pending_;
+  bool                     stop_;
+  std::mutex               mutex_;
+  std::condition_variable  cond_;
+  std::thread              writer_;
+};
+
+}
+
+#include <os.ipp>
+
+#endif
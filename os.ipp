@@ -0,0 +1,439 @@
+namespace support {
+
+////////
+/// policy constructor
+////////
+inline
+sink::
+policy::
+policy() :
+  capacity  (1 << 20),
+  flush     (flush_t::size),
+  flush_size(1 << 19),
+  interval  (100),
+  background(false),
+  cpu       (-1)
+{}
+
+////////
+/// constructor
+////////
+inline
+sink::
+sink(int fd,
+     const policy& p) :
+  fd_       (fd),
+  policy_   (p),
+  front_    (nullptr),
+  size_     (0),
+  offset_   (0),
+  back_     (nullptr),
+  back_size_(0),
+  last_     (clock_t::now()),
+  good_     (true),
+  pending_  (false),
+  stop_     (false) {
+
+  ////////
+  /// room for at least one formatted number
+  ////////
+  if (policy_.capacity < 64) {
+    policy_.capacity = 64;
+  }
+  if (policy_.flush_size > policy_.capacity) {
+    policy_.flush_size = policy_.capacity;
+  }
+  front_ = new char[policy_.capacity];
+  if (policy_.background) {
+    back_ = new char[policy_.capacity];
+    writer_ = std::thread(&sink::run, this);
+  }
+}
+
+////////
+/// destructor
+////////
+inline
+sink::
+~sink() {
+
+  flush();
+  if (writer_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    writer_.join();
+  }
+  delete [] front_;
+  delete [] back_;
+}
+
+////////
+/// flush
+////////
+inline void
+sink::
+flush() {
+
+  last_ = clock_t::now();
+  if (!size_) {
+    return;
+  }
+  offset_ += size_;
+  if (!policy_.background) {
+    drain(front_, size_);
+    size_ = 0;
+    return;
+  }
+  ////////
+  /// hand the front buffer to the writer once it's idle
+  ////////
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return !pending_; });
+    std::swap(front_, back_);
+    back_size_ = size_;
+    pending_ = true;
+  }
+  cond_.notify_all();
+  size_ = 0;
+}
+
+////////
+/// wait
+////////
+inline void
+sink::
+wait() {
+
+  if (!policy_.background) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [this] { return !pending_; });
+}
+
+////////
+/// good
+////////
+inline bool
+sink::
+good() const {
+  return good_;
+}
+
+////////
+/// position
+////////
+inline uint64_t
+sink::
+position() const {
+  return offset_ + size_;
+}
+
+////////
+/// write
+////////
+inline sink&
+sink::
+write(const char* p,
+      size_t n) {
+
+  if (n > policy_.capacity - size_) {
+    flush();
+
+    ////////
+    /// too big to ever buffer - write through [in order]
+    ////////
+    if (n > policy_.capacity) {
+      if (policy_.background) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return !pending_; });
+      }
+      drain(p, n);
+      offset_ += n;
+      return *this;
+    }
+  }
+  std::memcpy(front_ + size_, p, n);
+  size_ += n;
+  return *this;
+}
+
+////////
+/// operator<< (char)
+////////
+inline sink&
+sink::
+operator<<(char c) {
+  reserve(1);
+  front_[size_++] = c;
+  if (c == '\n') {
+    newline();
+  }
+  return *this;
+}
+
+////////
+/// operator<< (const char*)
+////////
+inline sink&
+sink::
+operator<<(const char* s) {
+  return text(s, std::strlen(s));
+}
+
+////////
+/// operator<< (std::string)
+////////
+inline sink&
+sink::
+operator<<(const std::string& s) {
+  return text(s.data(), s.size());
+}
+
+////////
+/// operator<< (std::string_view)
+////////
+inline sink&
+sink::
+operator<<(std::string_view s) {
+  return text(s.data(), s.size());
+}
+
+////////
+/// operator<< (integers)
+////////
+inline sink&
+sink::
+operator<<(int v) {
+  return *this << static_cast<long long>(v);
+}
+
+inline sink&
+sink::
+operator<<(unsigned v) {
+  return *this << static_cast<unsigned long long>(v);
+}
+
+inline sink&
+sink::
+operator<<(long v) {
+  return *this << static_cast<long long>(v);
+}
+
+inline sink&
+sink::
+operator<<(unsigned long v) {
+  return *this << static_cast<unsigned long long>(v);
+}
+
+inline sink&
+sink::
+operator<<(long long v) {
+  reserve(21);
+  if (v < 0) {
+    format(0ULL - static_cast<unsigned long long>(v), true);
+  }
+  else {
+    format(static_cast<unsigned long long>(v), false);
+  }
+  return *this;
+}
+
+inline sink&
+sink::
+operator<<(unsigned long long v) {
+  reserve(21);
+  format(v, false);
+  return *this;
+}
+
+////////
+/// operator<< (double)
+////////
+inline sink&
+sink::
+operator<<(double v) {
+  reserve(32);
+  std::to_chars_result r =
+    std::to_chars(front_ + size_, front_ + size_ + 32, v);
+  size_ = r.ptr - front_;
+  return *this;
+}
+
+////////
+/// operator<< (bool) - as std::ostream w/o boolalpha
+////////
+inline sink&
+sink::
+operator<<(bool v) {
+  return *this << (v ? '1' : '0');
+}
+
+////////
+/// operator<< (manipulators)
+////////
+inline sink&
+sink::
+operator<<(std::ostream& (*m)(std::ostream&)) {
+
+  typedef std::ostream& (*manip_t)(std::ostream&);
+  if (m == static_cast<manip_t>(std::flush)) {
+    flush();
+    return *this;
+  }
+  ////////
+  /// std::endl and anything else end the line
+  ////////
+  return *this << '\n';
+}
+
+////////
+/// format
+////////
+inline void
+sink::
+format(unsigned long long v,
+       bool negative) {
+
+  static const char digits[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+  ////////
+  /// render two digits at a time backwards into a scratch area
+  ////////
+  char tmp[24];
+  char* e = tmp + sizeof(tmp);
+  char* p = e;
+  while (v >= 100) {
+    const unsigned i = static_cast<unsigned>(v % 100) * 2;
+    v /= 100;
+    *--p = digits[i + 1];
+    *--p = digits[i];
+  }
+  if (v >= 10) {
+    const unsigned i = static_cast<unsigned>(v) * 2;
+    *--p = digits[i + 1];
+    *--p = digits[i];
+  }
+  else {
+    *--p = static_cast<char>('0' + v);
+  }
+  if (negative) {
+    *--p = '-';
+  }
+  std::memcpy(front_ + size_, p, e - p);
+  size_ += e - p;
+}
+
+////////
+/// reserve
+////////
+inline void
+sink::
+reserve(size_t n) {
+  if (n > policy_.capacity - size_) {
+    flush();
+  }
+}
+
+////////
+/// text
+////////
+inline sink&
+sink::
+text(const char* p,
+     size_t n) {
+
+  write(p, n);
+  if (std::memchr(p, '\n', n)) {
+    newline();
+  }
+  return *this;
+}
+
+////////
+/// newline
+////////
+inline void
+sink::
+newline() {
+
+  switch (policy_.flush) {
+  case flush_t::size:
+    if (size_ >= policy_.flush_size) flush();
+    break;
+  case flush_t::interval:
+    if (clock_t::now() - last_ >= policy_.interval) flush();
+    break;
+  case flush_t::manual:
+    break;
+  }
+}
+
+////////
+/// drain
+////////
+inline void
+sink::
+drain(const char* p,
+      size_t n) {
+
+  while (n && good_) {
+    ssize_t rc = ::write(fd_, p, n);
+    if (rc < 0) {
+      if (errno == EINTR) continue;
+      good_ = false;
+      break;
+    }
+    p += rc;
+    n -= rc;
+  }
+}
+
+////////
+/// run
+////////
+inline void
+sink::
+run() {
+
+  ////////
+  /// best effort - a writer on the wrong cpu still writes
+  ////////
+  error_code err;
+  pin(err, policy_.cpu);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    cond_.wait(lock, [this] { return pending_ || stop_; });
+    if (pending_) {
+      ////////
+      /// write w/o holding the lock; front_ is the producer's
+      ////////
+      lock.unlock();
+      drain(back_, back_size_);
+      lock.lock();
+      back_size_ = 0;
+      pending_ = false;
+      cond_.notify_all();
+    }
+    else if (stop_) {
+      break;
+    }
+  }
+}
+
+}
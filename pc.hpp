@@ -0,0 +1,130 @@
+#ifndef __EXP_PERF_COUNTERS_HPP__
+#define __EXP_PERF_COUNTERS_HPP__
+
+#include <array>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+namespace support {
+
+////////
+/// hardware counters attributed to named stages of a loop
+/// - one perf_event_open group on the constructing thread, user
+///   space only so it works unprivileged [perf_event_paranoid <= 2]
+/// - enter() reads the group once and charges the delta to the stage
+///   that was running; scaled when the kernel multiplexes
+/// - events the kernel or the cpu won't give us are reported as n/a;
+///   wall time per stage is always available
+////////
+class perf_counters {
+public:
+
+  ////////
+  /// counted events
+  ////////
+  enum event_t {
+    cycles,
+    instructions,
+    l1d_misses,
+    llc_misses,
+    branch_misses,
+    dtlb_misses,
+    events_
+  };
+
+  ////////
+  /// semantics ->
+  /// - opens and enables the group for the calling thread
+  /// - no stage is running
+  ////////
+  perf_counters(const std::vector<std::string>& stages);
+
+  ////////
+  /// semantics ->
+  /// - closes the group
+  ////////
+  ~perf_counters();
+
+  perf_counters(const perf_counters&) = delete;
+  perf_counters& operator=(const perf_counters&) = delete;
+
+  ////////
+  /// semantics ->
+  /// - true if event e could be opened
+  ////////
+  bool available(event_t e) const;
+
+  ////////
+  /// enter semantics ->
+  /// - charges everything since the last enter/leave to the running
+  ///   stage and starts stage
+  ////////
+  void enter(size_t stage);
+
+  ////////
+  /// leave semantics ->
+  /// - charges the running stage, none is running afterwards
+  ////////
+  void leave();
+
+  ////////
+  /// semantics ->
+  /// - totals are reported per n messages [0 -> raw totals]
+  ////////
+  void messages(size_t n);
+
+  ////////
+  /// for tracing the per stage table
+  ////////
+  template <class T>
+  friend T& operator<<(T& out, const perf_counters& in);
+
+private:
+
+  ////////
+  /// one group read
+  ////////
+  struct sample {
+    std::chrono::steady_clock::time_point  when;
+    uint64_t                               enabled;
+    uint64_t                               running;
+    uint64_t                               value[events_];
+  };
+
+  ////////
+  /// accumulated per stage; events_ holds wall nanoseconds
+  ////////
+  typedef std::array<double, events_ + 1> totals_t;
+
+  static const size_t none_ = ~size_t(0);
+
+  ////////
+  /// semantics ->
+  /// - fills s from the clock and the group
+  ////////
+  void read(sample& s) const;
+
+  std::vector<std::string>  names_;
+  std::vector<totals_t>     totals_;
+  int                       fd_[events_];
+  size_t                    slot_[events_];   /// position in group read
+  int                       leader_;
+  size_t                    opened_;
+  size_t                    current_;
+  sample                    last_;
+  size_t                    messages_;
+};
+
+}
+
+#include <pc.ipp>
+
+#endif
@@ -0,0 +1,199 @@
+namespace support {
+
+////////
+/// constructor
+////////
+inline
+perf_counters::
+perf_counters(const std::vector<std::string>& stages) :
+  names_(stages),
+  totals_(stages.size(), totals_t()),
+  leader_(-1),
+  opened_(0),
+  current_(none_),
+  last_(),
+  messages_(0) {
+
+  static const struct {
+    uint32_t  type;
+    uint64_t  config;
+  } events[events_] = {
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+    { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) }
+  };
+
+  ////////
+  /// first event that opens leads the group; the rest join it
+  ////////
+  for (size_t i = 0; i < events_; ++i) {
+    perf_event_attr a;
+    std::memset(&a, 0, sizeof(a));
+    a.size           = sizeof(a);
+    a.type           = events[i].type;
+    a.config         = events[i].config;
+    a.disabled       = leader_ == -1;
+    a.exclude_kernel = 1;
+    a.exclude_hv     = 1;
+    a.read_format    = PERF_FORMAT_GROUP |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fd_[i] = ::syscall(SYS_perf_event_open, &a, 0, -1, leader_, 0);
+    if (fd_[i] != -1) {
+      if (leader_ == -1) {
+        leader_ = fd_[i];
+      }
+      slot_[i] = opened_++;
+    }
+  }
+  if (leader_ != -1) {
+    ::ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ::ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+}
+
+////////
+/// destructor
+////////
+inline
+perf_counters::
+~perf_counters() {
+  for (size_t i = 0; i < events_; ++i) {
+    if (fd_[i] != -1) {
+      ::close(fd_[i]);
+    }
+  }
+}
+
+////////
+/// available
+////////
+inline bool
+perf_counters::
+available(event_t e) const {
+  return fd_[e] != -1;
+}
+
+////////
+/// enter
+////////
+inline void
+perf_counters::
+enter(size_t stage) {
+
+  sample s;
+  read(s);
+  if (current_ != none_) {
+
+    ////////
+    /// scale by the share of the interval the group was scheduled
+    ////////
+    totals_t& t = totals_[current_];
+    const uint64_t enabled = s.enabled - last_.enabled;
+    const uint64_t running = s.running - last_.running;
+    const double scale = running ? double(enabled) / running : 0;
+    for (size_t i = 0; i < events_; ++i) {
+      t[i] += (s.value[i] - last_.value[i]) * scale;
+    }
+    t[events_] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+      s.when - last_.when).count();
+  }
+  last_ = s;
+  current_ = stage;
+}
+
+////////
+/// leave
+////////
+inline void
+perf_counters::
+leave() {
+  enter(none_);
+}
+
+////////
+/// messages
+////////
+inline void
+perf_counters::
+messages(size_t n) {
+  messages_ = n;
+}
+
+////////
+/// read
+////////
+inline void
+perf_counters::
+read(sample& s) const {
+
+  s = sample();
+  s.when = std::chrono::steady_clock::now();
+  if (leader_ == -1) {
+    return;
+  }
+  ////////
+  /// nr, time enabled, time running, then values in open order
+  ////////
+  uint64_t buf[3 + events_];
+  if (::read(leader_, buf, sizeof(buf)) < ssize_t(3 * sizeof(uint64_t))) {
+    return;
+  }
+  s.enabled = buf[1];
+  s.running = buf[2];
+  for (size_t i = 0; i < events_; ++i) {
+    if (fd_[i] != -1 && slot_[i] < buf[0]) {
+      s.value[i] = buf[3 + slot_[i]];
+    }
+  }
+}
+
+////////
+/// operator<< (perf_counters)
+////////
+template <class T>
+T& operator<<(T& out, const perf_counters& in) {
+
+  static const char* names[perf_counters::events_] = {
+    "cycles",
+    "instructions",
+    "l1d misses",
+    "llc misses",
+    "branch misses",
+    "dtlb misses"
+  };
+  const double n = in.messages_ ? double(in.messages_) : 1;
+
+  ////////
+  /// two decimals is plenty per message
+  ////////
+  auto round = [](double v) { return std::round(v * 100) / 100; };
+
+  out << "Profile: messages "
+      << in.messages_
+      << (in.messages_ ? ", per message" : ", totals")
+      << std::endl;
+  for (size_t i = 0; i < in.names_.size(); ++i) {
+    const perf_counters::totals_t& t = in.totals_[i];
+    out << "stage "
+        << in.names_[i]
+        << ": ns "
+        << round(t[perf_counters::events_] / n);
+    for (size_t e = 0; e < perf_counters::events_; ++e) {
+      out << ", " << names[e] << " ";
+      if (in.fd_[e] == -1) out << "n/a";
+      else                 out << round(t[e] / n);
+    }
+    out << std::endl;
+  }
+  return out;
+}
+
+}
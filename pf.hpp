@@ -0,0 +1,129 @@
+#ifndef __EXP_PRODUCT_FILES_HPP__
+#define __EXP_PRODUCT_FILES_HPP__
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <ec.hpp>
+#include <os.hpp>
+
+namespace trade {
+
+////////
+/// output partitioned by product
+/// - products are hashed onto bucket files <dir>/bucket-NNN.txt
+///   [prod % buckets], each written by its own background sink
+/// - every run of bytes written for a product is recorded; on close
+///   <dir>/index.txt lists them as "prod,file,offset,length" in
+///   product then file order, adjacent runs coalesced
+/// - single producer thread
+////////
+class product_files {
+public:
+
+  ////////
+  /// layout and buffering
+  ////////
+  struct policy {
+
+    ////////
+    /// 16 buckets, 4MB buffers on background writers
+    ////////
+    policy();
+
+    std::string             dir;      /// output directory [created]
+    size_t                  buckets;  /// bucket files, at least one
+    support::sink::policy   output;   /// per bucket sink policy
+  };
+
+  ////////
+  /// semantics ->
+  /// - nothing is created until open()
+  ////////
+  product_files(const policy& p = policy());
+
+  ////////
+  /// semantics ->
+  /// - flushes and closes bucket files w/o writing the index
+  ////////
+  ~product_files();
+
+  product_files(const product_files&) = delete;
+  product_files& operator=(const product_files&) = delete;
+
+  ////////
+  /// open semantics ->
+  /// - creates dir if missing and truncates every bucket file
+  /// - starts the bucket writers
+  ////////
+  bool open(support::error_code& err);
+
+  ////////
+  /// select semantics ->
+  /// - sink of prod's bucket; everything written to it until the next
+  ///   select belongs to prod
+  ////////
+  support::sink& select(int prod);
+
+  ////////
+  /// close semantics ->
+  /// - flushes and closes bucket files, writes the index
+  /// - false if a bucket or the index couldn't be written
+  ////////
+  bool close(support::error_code& err);
+
+private:
+
+  ////////
+  /// byte run in a bucket file
+  ////////
+  struct extent {
+    size_t    bucket;
+    uint64_t  offset;
+    uint64_t  length;
+  };
+
+  typedef std::map<int, std::vector<extent>> extents_t;
+
+  ////////
+  /// semantics ->
+  /// - records the current product's run, if any
+  ////////
+  void settle();
+
+  ////////
+  /// semantics ->
+  /// - file name of bucket b / w/ the directory
+  ////////
+  std::string name(size_t b) const;
+  std::string path(size_t b) const;
+
+  ////////
+  /// semantics ->
+  /// - flushes sinks and closes fds
+  /// - false w/ err appended if any bucket failed
+  ////////
+  bool release(support::error_code& err);
+
+  policy                                       policy_;
+  std::vector<int>                             fds_;
+  std::vector<std::unique_ptr<support::sink>>  sinks_;
+  extents_t                                    extents_;
+  int                                          current_;
+  size_t                                       bucket_;
+  uint64_t                                     start_;
+};
+
+}
+
+#include <pf.ipp>
+
+#endif
@@ -0,0 +1,206 @@
+namespace trade {
+
+////////
+/// policy constructor
+////////
+inline
+product_files::
+policy::
+policy() :
+  dir    ("."),
+  buckets(16) {
+  output.capacity   = 4 << 20;
+  output.flush_size = 2 << 20;
+  output.background = true;
+}
+
+////////
+/// constructor
+////////
+inline
+product_files::
+product_files(const policy& p) :
+  policy_ (p),
+  current_(-1),
+  bucket_ (0),
+  start_  (0) {
+
+  if (!policy_.buckets) {
+    policy_.buckets = 1;
+  }
+}
+
+////////
+/// destructor
+////////
+inline
+product_files::
+~product_files() {
+  support::error_code err;
+  release(err);
+}
+
+////////
+/// open
+////////
+inline bool
+product_files::
+open(support::error_code& err) {
+
+  if (::mkdir(policy_.dir.c_str(), 0755) == -1 && errno != EEXIST) {
+    err = support::error_code(-1, "Failed to create output directory: <:" +
+                              policy_.dir + ">, " + std::strerror(errno));
+    return false;
+  }
+  for (size_t b = 0; b < policy_.buckets; ++b) {
+    const std::string file = path(b);
+    const int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+      err = support::error_code(-1, "Failed to open output file: <:" +
+                                file + ">, " + std::strerror(errno));
+      return false;
+    }
+    fds_.push_back(fd);
+    sinks_.emplace_back(new support::sink(fd, policy_.output));
+  }
+  return true;
+}
+
+////////
+/// select
+////////
+inline support::sink&
+product_files::
+select(int prod) {
+
+  const size_t b = static_cast<unsigned>(prod) % policy_.buckets;
+  if (prod != current_) {
+    settle();
+    current_ = prod;
+    bucket_  = b;
+    start_   = sinks_[b]->position();
+  }
+  return *sinks_[b];
+}
+
+////////
+/// close
+////////
+inline bool
+product_files::
+close(support::error_code& err) {
+
+  settle();
+  current_ = -1;
+  if (!release(err)) {
+    return false;
+  }
+  ////////
+  /// index is small; write it in one go
+  ////////
+  const std::string file = policy_.dir + "/index.txt";
+  const int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    err.append(-1, "Failed to open index file: <:" + file + ">, " +
+                   std::strerror(errno));
+    return false;
+  }
+  bool ok = true;
+  {
+    support::sink out(fd);
+    extents_t::const_iterator p = extents_.begin();
+    for (; p != extents_.end(); ++p) {
+      for (size_t i = 0; i < p->second.size(); ++i) {
+        const extent& e = p->second[i];
+        out << p->first
+            << ","
+            << name(e.bucket)
+            << ","
+            << e.offset
+            << ","
+            << e.length
+            << '\n';
+      }
+    }
+    out.flush();
+    if (!out.good()) {
+      err.append(-1, "Failed to write index file: <:" + file + ">");
+      ok = false;
+    }
+  }
+  ::close(fd);
+  return ok;
+}
+
+////////
+/// settle
+////////
+inline void
+product_files::
+settle() {
+
+  if (current_ == -1) {
+    return;
+  }
+  const uint64_t end = sinks_[bucket_]->position();
+  if (end == start_) {
+    return;
+  }
+  std::vector<extent>& v = extents_[current_];
+  if (!v.empty() && v.back().bucket == bucket_ &&
+      v.back().offset + v.back().length == start_) {
+    v.back().length += end - start_;
+  }
+  else {
+    v.push_back(extent{bucket_, start_, end - start_});
+  }
+}
+
+////////
+/// name
+////////
+inline std::string
+product_files::
+name(size_t b) const {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "bucket-%03zu.txt", b);
+  return buf;
+}
+
+////////
+/// path
+////////
+inline std::string
+product_files::
+path(size_t b) const {
+  return policy_.dir + "/" + name(b);
+}
+
+////////
+/// release
+////////
+inline bool
+product_files::
+release(support::error_code& err) {
+
+  bool ok = true;
+  for (size_t b = 0; b < sinks_.size(); ++b) {
+    sinks_[b]->flush();
+    sinks_[b]->wait();
+    if (!sinks_[b]->good()) {
+      err.append(-1, "Failed to write output file: <:" + path(b) + ">");
+      ok = false;
+    }
+  }
+  ////////
+  /// sinks drain and join their writers before the fds go
+  ////////
+  sinks_.clear();
+  for (size_t b = 0; b < fds_.size(); ++b) {
+    ::close(fds_[b]);
+  }
+  fds_.clear();
+  return ok;
+}
+
+}
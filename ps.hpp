@@ -0,0 +1,121 @@
+#ifndef __EXP_PRODUCT_STATS_HPP__
+#define __EXP_PRODUCT_STATS_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <climits>
+#include <cstdlib>
+
+namespace trade {
+
+////////
+/// per product trading statistics
+/// - flat, indexed by product id through fixed size chunks that never
+///   move once allocated
+/// - O(1) update per trade from a single ingest thread
+/// - readers on any thread take consistent copies through a
+///   per product seqlock and never block the writer
+////////
+class product_stats {
+public:
+
+  ////////
+  /// consistent copy of one product's statistics
+  ////////
+  struct snapshot {
+    int64_t   volume;    /// traded quantity
+    double    notional;  /// sum of quantity * price
+    uint64_t  trades;    /// trade count
+    int       high;      /// highest trade price
+    int       low;       /// lowest trade price
+    int       last;      /// last trade price
+    int       run;       /// quantity traded at last price since it changed
+
+    ////////
+    /// volume weighted average price
+    ////////
+    double vwap() const;
+  };
+
+  ////////
+  /// semantics ->
+  /// - reserves the chunk directory, no chunks allocated
+  ////////
+  product_stats();
+
+  ////////
+  /// semantics ->
+  /// - releases chunks and directory
+  ////////
+  ~product_stats();
+
+  product_stats(const product_stats&) = delete;
+  product_stats& operator=(const product_stats&) = delete;
+
+  ////////
+  /// record semantics -> [ingest thread only]
+  /// - allocates the product's chunk on first use
+  /// - bumps volume, notional, trades; tracks high/low
+  /// - run restarts at quantity when price changes, else accumulates
+  /// - returns the run length at price
+  ////////
+  int record(int prod, int quantity, int price);
+
+  ////////
+  /// read semantics -> [any thread]
+  /// - false if product never traded
+  /// - retries until an even, unchanged sequence brackets the copy
+  ////////
+  bool read(int prod, snapshot& s) const;
+
+  ////////
+  /// for_each semantics -> [any thread]
+  /// - calls f(prod, snapshot) for each traded product in id order
+  ////////
+  template <class F>
+  void for_each(F f) const;
+
+  ////////
+  /// for tracing all products
+  ////////
+  template <class T>
+  friend T& operator<<(T& out, const product_stats& in);
+
+private:
+
+  ////////
+  /// one product; odd seq means a write is in progress
+  ////////
+  struct alignas(64) entry {
+    std::atomic<uint32_t>  seq;
+    std::atomic<int64_t>   volume;
+    std::atomic<double>    notional;
+    std::atomic<uint64_t>  trades;
+    std::atomic<int>       high;
+    std::atomic<int>       low;
+    std::atomic<int>       last;
+    std::atomic<int>       run;
+  };
+
+  static const size_t chunk_bits_ = 12;
+  static const size_t chunk_size_ = size_t(1) << chunk_bits_;
+  static const size_t chunks_     = (size_t(INT_MAX) >> chunk_bits_) + 1;
+
+  ////////
+  /// entry for prod or nullptr if its chunk doesn't exist
+  ////////
+  const entry* find(int prod) const;
+
+  std::atomic<entry*>*  directory_;
+
+  ////////
+  /// one past the highest allocated chunk
+  ////////
+  std::atomic<size_t>   used_;
+};
+
+}
+
+#include <ps.ipp>
+
+#endif
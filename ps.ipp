@@ -0,0 +1,188 @@
+namespace trade {
+
+////////
+/// vwap
+////////
+inline double
+product_stats::
+snapshot::
+vwap() const {
+  return volume ? notional / volume : 0.0;
+}
+
+////////
+/// constructor
+////////
+inline
+product_stats::
+product_stats() :
+  used_(0) {
+
+  ////////
+  /// zeroed directory; untouched pages are never faulted in
+  ////////
+  directory_ = static_cast<std::atomic<entry*>*>(
+    std::calloc(chunks_, sizeof(std::atomic<entry*>)));
+}
+
+////////
+/// destructor
+////////
+inline
+product_stats::
+~product_stats() {
+  const size_t used = used_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < used; ++i) {
+    delete [] directory_[i].load(std::memory_order_relaxed);
+  }
+  std::free(directory_);
+}
+
+////////
+/// record
+////////
+inline int
+product_stats::
+record(int prod,
+       int quantity,
+       int price) {
+
+  const size_t c = static_cast<size_t>(prod) >> chunk_bits_;
+  entry* chunk = directory_[c].load(std::memory_order_relaxed);
+  if (!chunk) {
+    chunk = new entry[chunk_size_]();
+    directory_[c].store(chunk, std::memory_order_release);
+    if (c >= used_.load(std::memory_order_relaxed)) {
+      used_.store(c + 1, std::memory_order_release);
+    }
+  }
+  entry& e = chunk[prod & (chunk_size_ - 1)];
+
+  ////////
+  /// values the writer owns can be read back relaxed
+  ////////
+  const uint32_t s = e.seq.load(std::memory_order_relaxed);
+  const uint64_t trades = e.trades.load(std::memory_order_relaxed);
+  const int last = e.last.load(std::memory_order_relaxed);
+  const int run  = trades && last == price ?
+    e.run.load(std::memory_order_relaxed) + quantity : quantity;
+
+  e.seq.store(s + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  e.volume.store(e.volume.load(std::memory_order_relaxed) + quantity,
+                 std::memory_order_relaxed);
+  e.notional.store(e.notional.load(std::memory_order_relaxed) +
+                   double(quantity) * price, std::memory_order_relaxed);
+  e.trades.store(trades + 1, std::memory_order_relaxed);
+  if (!trades || price > e.high.load(std::memory_order_relaxed)) {
+    e.high.store(price, std::memory_order_relaxed);
+  }
+  if (!trades || price < e.low.load(std::memory_order_relaxed)) {
+    e.low.store(price, std::memory_order_relaxed);
+  }
+  e.last.store(price, std::memory_order_relaxed);
+  e.run.store(run, std::memory_order_relaxed);
+
+  e.seq.store(s + 2, std::memory_order_release);
+  return run;
+}
+
+////////
+/// read
+////////
+inline bool
+product_stats::
+read(int prod,
+     snapshot& s) const {
+
+  const entry* e = find(prod);
+  if (!e) {
+    return false;
+  }
+  for (;;) {
+    const uint32_t s0 = e->seq.load(std::memory_order_acquire);
+    if (s0 & 1) {
+      continue;
+    }
+    s.volume   = e->volume.load(std::memory_order_relaxed);
+    s.notional = e->notional.load(std::memory_order_relaxed);
+    s.trades   = e->trades.load(std::memory_order_relaxed);
+    s.high     = e->high.load(std::memory_order_relaxed);
+    s.low      = e->low.load(std::memory_order_relaxed);
+    s.last     = e->last.load(std::memory_order_relaxed);
+    s.run      = e->run.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (e->seq.load(std::memory_order_relaxed) == s0) {
+      return s.trades != 0;
+    }
+  }
+}
+
+////////
+/// for each
+////////
+template <class F>
+inline void
+product_stats::
+for_each(F f) const {
+
+  snapshot s;
+  const size_t used = used_.load(std::memory_order_acquire);
+  for (size_t c = 0; c < used; ++c) {
+    if (!directory_[c].load(std::memory_order_acquire)) {
+      continue;
+    }
+    for (size_t i = 0; i < chunk_size_; ++i) {
+      const int prod = static_cast<int>((c << chunk_bits_) | i);
+      if (read(prod, s)) {
+        f(prod, s);
+      }
+    }
+  }
+}
+
+////////
+/// find
+////////
+inline const product_stats::entry*
+product_stats::
+find(int prod) const {
+  if (prod < 0) {
+    return nullptr;
+  }
+  const entry* chunk =
+    directory_[static_cast<size_t>(prod) >> chunk_bits_].load(
+      std::memory_order_acquire);
+  return chunk ? &chunk[prod & (chunk_size_ - 1)] : nullptr;
+}
+
+////////
+/// operator<< (product_stats)
+////////
+template <class T>
+T& operator<<(T& out, const product_stats& in) {
+
+  in.for_each([&out](int prod, const product_stats::snapshot& s) {
+    out << "product "
+        << prod
+        << ": trades "
+        << s.trades
+        << ", volume "
+        << s.volume
+        << ", vwap "
+        << s.vwap()
+        << ", high "
+        << s.high
+        << ", low "
+        << s.low
+        << ", last "
+        << s.last
+        << ", run "
+        << s.run
+        << std::endl;
+  });
+  return out;
+}
+
+}
@@ -0,0 +1,108 @@
+#include <cstdlib>
+#include <sstream>
+#include <rh.hpp>
+
+////////
+/// splits a command line on white space [no quoting]
+////////
+static std::vector<std::string>
+split(const std::string& s) {
+  std::vector<std::string> out;
+  std::istringstream in(s);
+  std::string w;
+  while (in >> w) {
+    out.push_back(w);
+  }
+  return out;
+}
+
+int main(int argc, char** argv) {
+
+  ////////
+  /// -a c -> baseline command line, e.g. "./om"
+  /// -b c -> candidate command line, e.g. "./om -H t"
+  /// -g n -> generate a feed of n messages [repeatable; replaces the
+  ///         default 100000]
+  /// -s n -> seed of the first generated feed
+  /// -d d -> work directory for feeds and outputs
+  /// -n n -> runs per side and feed
+  /// -x s -> also ignore output lines containing s [repeatable]
+  /// -t r -> min b/a median throughput
+  /// -w r -> max b/a p90 wall time
+  /// -r r -> max b/a peak rss
+  ///
+  /// remaining arguments are existing feeds; exits 0 on pass, 1 on
+  /// fail
+  ///
+  /// allocation, profile and per product stats reports are left out
+  /// of the compare along w/ the -x lines
+  ////////
+  trade::regression_harness::policy p;
+  bool generate = false;
+  int c;
+  while ((c = ::getopt(argc, argv, "a:b:g:s:d:n:x:t:w:r:")) != -1) {
+    if (c == 'a') {
+      p.a = split(optarg);
+    }
+    else if (c == 'b') {
+      p.b = split(optarg);
+    }
+    else if (c == 'g') {
+      if (!generate) {
+        p.generate.clear();
+        generate = true;
+      }
+      p.generate.push_back(::atoi(optarg));
+    }
+    else if (c == 's') {
+      p.seed = ::atoi(optarg);
+    }
+    else if (c == 'd') {
+      p.dir = optarg;
+    }
+    else if (c == 'n') {
+      p.runs = ::atoi(optarg);
+    }
+    else if (c == 'x') {
+      p.ignore.push_back(optarg);
+    }
+    else if (c == 't') {
+      p.min_throughput = ::atof(optarg);
+    }
+    else if (c == 'w') {
+      p.max_wall = ::atof(optarg);
+    }
+    else if (c == 'r') {
+      p.max_rss = ::atof(optarg);
+    }
+    else {
+      p.a.clear();
+      break;
+    }
+  }
+  if (p.a.empty() || p.b.empty()) {
+    std::cout << "Usage: <" << argv[0] << "> -a command -b command "
+              << "[-g messages] [-s seed] [-d dir] [-n runs] [-x ignore] "
+              << "[-t throughput] [-w wall] [-r rss] [feed...]"
+              << std::endl;
+    return -1;
+  }
+  ////////
+  /// given feeds only, unless -g asked for generated ones too
+  ////////
+  for (int i = optind; i < argc; ++i) {
+    p.feeds.push_back(argv[i]);
+  }
+  if (!p.feeds.empty() && !generate) {
+    p.generate.clear();
+  }
+  support::sink out(STDOUT_FILENO);
+  trade::regression_harness rh(p);
+  support::error_code err;
+  if (!rh.exec(err)) {
+    out << err;
+    return -1;
+  }
+  out << rh;
+  return rh.passed() ? 0 : 1;
+}
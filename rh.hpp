@@ -0,0 +1,192 @@
+#ifndef __EXP_REGRESSION_HARNESS_HPP__
+#define __EXP_REGRESSION_HARNESS_HPP__
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <random>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <ec.hpp>
+#include <os.hpp>
+
+namespace trade {
+
+////////
+/// golden output and performance comparison of two order_tracker
+/// builds or modes
+/// - a and b are command lines; each feed is appended as the last
+///   argument, stdout is captured to a file per side and feed
+/// - feeds are given or generated from a seed [same seed, same
+///   bytes on every box]
+/// - outputs must match byte for byte, except lines containing one
+///   of the ignore strings [mode reports, timings] and whole report
+///   blocks [allocation table, profile, per product stats]
+/// - each side runs policy.runs times per feed; wall time percentiles
+///   are over those runs, peak rss and cpu times come from wait4
+/// - b fails against a if its median throughput, p90 wall time or
+///   peak rss fall outside the policy ratios
+////////
+class regression_harness {
+public:
+
+  ////////
+  /// what to run and the pass/fail thresholds
+  ////////
+  ////////
+  /// a multi line report left out of compare; it starts at a line
+  /// beginning w/ head and runs while lines begin w/ body [empty ->
+  /// the head line alone]
+  ////////
+  struct block {
+    std::string  head;
+    std::string  body;
+  };
+
+  struct policy {
+
+    ////////
+    /// one 100k message feed, seed 1, 3 runs, b may be 5% slower and
+    /// use 10% more memory
+    ////////
+    policy();
+
+    std::vector<std::string>  a;               /// baseline argv
+    std::vector<std::string>  b;               /// candidate argv
+    std::vector<std::string>  feeds;           /// existing feeds
+    std::vector<size_t>       generate;        /// messages per generated feed
+    uint32_t                  seed;
+    std::string               dir;             /// feeds and outputs
+    size_t                    runs;            /// per side and feed
+    std::vector<std::string>  ignore;          /// lines left out of compare
+    std::vector<block>        blocks;          /// reports left out of compare
+    double                    min_throughput;  /// b / a, median
+    double                    max_wall;        /// b / a, p90
+    double                    max_rss;         /// b / a
+  };
+
+  ////////
+  /// semantics ->
+  /// - nothing runs until exec()
+  ////////
+  regression_harness(const policy& p = policy());
+
+  ////////
+  /// exec semantics ->
+  /// - generates feeds, runs both sides over every feed and compares
+  /// - false w/ err set if a feed couldn't be written or a command
+  ///   couldn't be started; comparisons failing is not an error
+  ////////
+  bool exec(support::error_code& err);
+
+  ////////
+  /// semantics ->
+  /// - true if every feed matched and stayed in the thresholds
+  ////////
+  bool passed() const;
+
+  ////////
+  /// generate semantics ->
+  /// - writes n messages [new, cancel, modify, trade and the odd
+  ///   malformed line] drawn from seed to file
+  ////////
+  static bool generate(support::error_code& err,
+                       const std::string& file,
+                       size_t n,
+                       uint32_t seed);
+
+  ////////
+  /// for tracing the side by side report
+  ////////
+  template <class T>
+  friend T& operator<<(T& out, const regression_harness& in);
+
+private:
+
+  ////////
+  /// one run of one side
+  ////////
+  struct run {
+    double  wall_ms;
+    double  user_ms;
+    double  sys_ms;
+    long    rss_kb;
+    int     status;
+  };
+
+  ////////
+  /// every run of one side over a feed
+  ////////
+  struct side {
+    std::vector<run>  runs;
+    std::string       output;
+
+    double percentile(double p) const;
+    long rss_kb() const;
+    double user_ms() const;
+  };
+
+  ////////
+  /// one feed
+  ////////
+  struct result {
+    std::string  feed;
+    size_t       messages;
+    side         a;
+    side         b;
+    bool         same;
+    size_t       line;      /// first differing line of a's output
+    std::string  failures;
+  };
+
+  ////////
+  /// semantics ->
+  /// - runs argv w/ feed appended, stdout to output
+  /// - false w/ err set if the process couldn't be started
+  ////////
+  bool launch(support::error_code& err,
+              const std::vector<std::string>& argv,
+              const std::string& feed,
+              const std::string& output,
+              run& r) const;
+
+  ////////
+  /// semantics ->
+  /// - true if both files hold the same lines once ignored lines and
+  ///   report blocks are dropped; line is a's first differing line
+  ///   otherwise
+  ////////
+  bool compare(const std::string& a,
+               const std::string& b,
+               size_t& line) const;
+
+  ////////
+  /// semantics ->
+  /// - lines in file
+  ////////
+  static size_t lines(const std::string& file);
+
+  ////////
+  /// semantics ->
+  /// - v w/ d decimals, right aligned in a report column
+  ////////
+  static std::string fixed(double v, int d);
+
+  policy               policy_;
+  std::vector<result>  results_;
+};
+
+}
+
+#include <rh.ipp>
+
+#endif
@@ -0,0 +1,467 @@
+namespace trade {
+
+////////
+/// policy constructor
+////////
+inline
+regression_harness::
+policy::
+policy() :
+  generate      { 100000 },
+  seed          (1),
+  dir           ("rh"),
+  runs          (3),
+  ignore        { "Arena:", "Spill:", "latency" },
+  blocks        { { "Allocations:", "  " }, { "Profile:", "stage " },
+                  { "product ", "product " } },
+  min_throughput(0.95),
+  max_wall      (1.05),
+  max_rss       (1.10)
+{}
+
+////////
+/// constructor
+////////
+inline
+regression_harness::
+regression_harness(const policy& p) :
+  policy_(p) {
+
+  if (!policy_.runs) {
+    policy_.runs = 1;
+  }
+}
+
+////////
+/// exec
+////////
+inline bool
+regression_harness::
+exec(support::error_code& err) {
+
+  if (::mkdir(policy_.dir.c_str(), 0755) == -1 && errno != EEXIST) {
+    err = support::error_code(-1, "Failed to create work directory: <:" +
+                              policy_.dir + ">, " + std::strerror(errno));
+    return false;
+  }
+  ////////
+  /// generated feeds go after the given ones; seeds step per feed
+  ////////
+  std::vector<std::string> feeds = policy_.feeds;
+  for (size_t i = 0; i < policy_.generate.size(); ++i) {
+    const std::string file = policy_.dir + "/feed-" + std::to_string(i) +
+                             "-" + std::to_string(policy_.generate[i]) +
+                             ".txt";
+    if (!generate(err, file, policy_.generate[i], policy_.seed + i)) {
+      return false;
+    }
+    feeds.push_back(file);
+  }
+  for (size_t f = 0; f < feeds.size(); ++f) {
+
+    result r;
+    r.feed     = feeds[f];
+    r.messages = lines(feeds[f]);
+    r.same     = false;
+    r.line     = 0;
+    r.a.output = policy_.dir + "/out-" + std::to_string(f) + "-a.txt";
+    r.b.output = policy_.dir + "/out-" + std::to_string(f) + "-b.txt";
+
+    ////////
+    /// interleave the sides so drift [thermal, page cache] hits both
+    ////////
+    for (size_t i = 0; i < policy_.runs; ++i) {
+      run x, y;
+      if (!launch(err, policy_.a, r.feed, r.a.output, x) ||
+          !launch(err, policy_.b, r.feed, r.b.output, y)) {
+        return false;
+      }
+      r.a.runs.push_back(x);
+      r.b.runs.push_back(y);
+    }
+    r.same = compare(r.a.output, r.b.output, r.line);
+
+    ////////
+    /// thresholds
+    ////////
+    if (!r.same) {
+      r.failures += " output";
+    }
+    if (r.a.runs.back().status != r.b.runs.back().status) {
+      r.failures += " status";
+    }
+    const double a50 = r.a.percentile(50), b50 = r.b.percentile(50);
+    if (a50 > 0 && b50 > 0 && a50 / b50 < policy_.min_throughput) {
+      r.failures += " throughput";
+    }
+    const double a90 = r.a.percentile(90), b90 = r.b.percentile(90);
+    if (a90 > 0 && b90 / a90 > policy_.max_wall) {
+      r.failures += " wall";
+    }
+    if (r.a.rss_kb() > 0 &&
+        double(r.b.rss_kb()) / r.a.rss_kb() > policy_.max_rss) {
+      r.failures += " rss";
+    }
+    results_.push_back(r);
+  }
+  return true;
+}
+
+////////
+/// passed
+////////
+inline bool
+regression_harness::
+passed() const {
+  for (size_t i = 0; i < results_.size(); ++i) {
+    if (!results_[i].failures.empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+////////
+/// generate
+/// - draws straight from mt19937 [fully specified], not from the
+///   library's distributions, so feeds are the same everywhere
+/// - keeps the resting orders so cancels and modifies mostly refer
+///   to live ones; trades hit prices near the touch
+////////
+inline bool
+regression_harness::
+generate(support::error_code& err,
+         const std::string& file,
+         size_t n,
+         uint32_t seed) {
+
+  struct live {
+    int   id;
+    int   prod;
+    char  side;
+    int   quantity;
+    int   price;
+  };
+
+  const int fd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    err = support::error_code(-1, "Failed to open feed file: <:" + file +
+                              ">, " + std::strerror(errno));
+    return false;
+  }
+  bool ok;
+  {
+    support::sink out(fd);
+    std::mt19937 rng(seed);
+    auto draw = [&rng](uint32_t k) -> int { return rng() % k; };
+
+    std::vector<live> book;
+    int next_id = 100000;
+
+    for (size_t i = 0; i < n; ++i) {
+
+      const int kind = draw(100);
+      if (kind < 1) {
+        out << "N,," << draw(100) << ",B,,\n";
+      }
+      else if (kind < 50 || book.size() < 16) {
+        live o{ ++next_id, 1 + draw(20), draw(2) ? 'B' : 'S',
+                1 + draw(50), 975 + draw(50) };
+        book.push_back(o);
+        out << "N," << o.prod << "," << o.id << "," << o.side << ","
+            << o.quantity << "," << o.price << '\n';
+      }
+      else if (kind < 72) {
+        ////////
+        /// cancel; one in fifty refers to an unknown order
+        ////////
+        const size_t k = draw(book.size());
+        const live o = book[k];
+        book[k] = book.back();
+        book.pop_back();
+        const int id = draw(50) ? o.id : next_id + 1 + draw(1000);
+        out << "R," << id << "," << o.side << "," << o.quantity << ","
+            << o.price << '\n';
+      }
+      else if (kind < 84) {
+        live& o = book[draw(book.size())];
+        o.quantity = 1 + draw(50);
+        if (!draw(3)) {
+          o.price = 975 + draw(50);
+        }
+        out << "M," << o.id << "," << o.side << "," << o.quantity << ","
+            << o.price << '\n';
+      }
+      else {
+        const live& o = book[draw(book.size())];
+        out << "X," << o.prod << "," << 1 + draw(o.quantity) << ","
+            << o.price << '\n';
+      }
+    }
+    out.flush();
+    ok = out.good();
+  }
+  ::close(fd);
+  if (!ok) {
+    err = support::error_code(-1, "Failed to write feed file: <:" + file +
+                              ">");
+  }
+  return ok;
+}
+
+////////
+/// side percentile
+/// - nearest rank over the runs' wall times
+////////
+inline double
+regression_harness::
+side::
+percentile(double p) const {
+
+  if (runs.empty()) {
+    return 0;
+  }
+  std::vector<double> v;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    v.push_back(runs[i].wall_ms);
+  }
+  std::sort(v.begin(), v.end());
+  size_t k = static_cast<size_t>(p / 100 * v.size() + 0.5);
+  k = k ? k - 1 : 0;
+  return v[std::min(k, v.size() - 1)];
+}
+
+////////
+/// side rss_kb - worst run
+////////
+inline long
+regression_harness::
+side::
+rss_kb() const {
+  long m = 0;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    m = std::max(m, runs[i].rss_kb);
+  }
+  return m;
+}
+
+////////
+/// side user_ms - mean
+////////
+inline double
+regression_harness::
+side::
+user_ms() const {
+  double s = 0;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    s += runs[i].user_ms;
+  }
+  return runs.empty() ? 0 : s / runs.size();
+}
+
+////////
+/// launch
+////////
+inline bool
+regression_harness::
+launch(support::error_code& err,
+       const std::vector<std::string>& argv,
+       const std::string& feed,
+       const std::string& output,
+       run& r) const {
+
+  if (argv.empty()) {
+    err = support::error_code(-1, "Empty command line");
+    return false;
+  }
+  std::vector<char*> args;
+  for (size_t i = 0; i < argv.size(); ++i) {
+    args.push_back(const_cast<char*>(argv[i].c_str()));
+  }
+  args.push_back(const_cast<char*>(feed.c_str()));
+  args.push_back(nullptr);
+
+  const int fd = ::open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd == -1) {
+    err = support::error_code(-1, "Failed to open output file: <:" +
+                              output + ">, " + std::strerror(errno));
+    return false;
+  }
+  const std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+
+  const pid_t pid = ::fork();
+  if (pid == -1) {
+    ::close(fd);
+    err = support::error_code(-1, std::string("Failed to fork: ") +
+                              std::strerror(errno));
+    return false;
+  }
+  if (!pid) {
+    ::dup2(fd, STDOUT_FILENO);
+    ::close(fd);
+    ::execvp(args[0], args.data());
+    ::_exit(127);
+  }
+  ::close(fd);
+
+  int status = 0;
+  struct rusage ru;
+  std::memset(&ru, 0, sizeof(ru));
+  while (::wait4(pid, &status, 0, &ru) == -1 && errno == EINTR) {
+  }
+  const std::chrono::steady_clock::time_point stop =
+    std::chrono::steady_clock::now();
+
+  if (WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+    err = support::error_code(-1, "Failed to start: <:" + argv[0] + ">");
+    return false;
+  }
+  r.wall_ms = std::chrono::duration<double, std::milli>(stop - start).count();
+  r.user_ms = ru.ru_utime.tv_sec * 1e3 + ru.ru_utime.tv_usec / 1e3;
+  r.sys_ms  = ru.ru_stime.tv_sec * 1e3 + ru.ru_stime.tv_usec / 1e3;
+  r.rss_kb  = ru.ru_maxrss;
+  r.status  = WIFEXITED(status) ? WEXITSTATUS(status) :
+                                  128 + WTERMSIG(status);
+  return true;
+}
+
+////////
+/// compare
+////////
+inline bool
+regression_harness::
+compare(const std::string& a,
+        const std::string& b,
+        size_t& line) const {
+
+  auto ignored = [this](const std::string& s) {
+    for (size_t i = 0; i < policy_.ignore.size(); ++i) {
+      if (s.find(policy_.ignore[i]) != std::string::npos) {
+        return true;
+      }
+    }
+    return false;
+  };
+  auto starts = [](const std::string& s, const std::string& p) {
+    return !p.empty() && s.compare(0, p.size(), p) == 0;
+  };
+  ////////
+  /// next compared line; open tracks the report block being skipped
+  ////////
+  auto next = [this, &ignored, &starts](std::ifstream& in,
+                                        std::string& s,
+                                        const block*& open,
+                                        size_t* count) {
+    while (std::getline(in, s)) {
+      if (count) {
+        ++*count;
+      }
+      if (open && starts(s, open->body)) {
+        continue;
+      }
+      open = nullptr;
+      for (size_t i = 0; i < policy_.blocks.size() && !open; ++i) {
+        if (starts(s, policy_.blocks[i].head)) {
+          open = &policy_.blocks[i];
+        }
+      }
+      if (!open && !ignored(s)) {
+        return true;
+      }
+    }
+    return false;
+  };
+  std::ifstream fa(a), fb(b);
+  std::string x, y;
+  const block* oa = nullptr;
+  const block* ob = nullptr;
+  line = 0;
+  for (;;) {
+    const bool ha = next(fa, x, oa, &line);
+    const bool hb = next(fb, y, ob, nullptr);
+    if (!ha || !hb) {
+      return ha == hb;
+    }
+    if (x != y) {
+      return false;
+    }
+  }
+}
+
+////////
+/// lines
+////////
+inline size_t
+regression_harness::
+lines(const std::string& file) {
+
+  std::ifstream in(file);
+  std::string s;
+  size_t n = 0;
+  while (std::getline(in, s)) {
+    ++n;
+  }
+  return n;
+}
+
+////////
+/// fixed
+////////
+inline std::string
+regression_harness::
+fixed(double v,
+      int d) {
+  char buf[64];
+  std::snprintf(buf, sizeof(buf), "%13.*f", d, v);
+  return buf;
+}
+
+////////
+/// operator<< (regression_harness)
+////////
+template <class T>
+T& operator<<(T& out, const regression_harness& in) {
+
+  typedef regression_harness h;
+
+  for (size_t i = 0; i < in.results_.size(); ++i) {
+    const h::result& r = in.results_[i];
+
+    const double a50 = r.a.percentile(50), b50 = r.b.percentile(50);
+    auto rate = [&r](double ms) -> double {
+      return ms > 0 ? r.messages / (ms / 1e3) : 0;
+    };
+    out << "Feed: " << r.feed << ", messages " << r.messages
+        << ", runs " << r.a.runs.size() << std::endl
+        << "  output:       "
+        << (r.same ? std::string("identical") :
+                     "differs at line " + std::to_string(r.line))
+        << std::endl
+        << "                            a            b          b/a"
+        << std::endl
+        << "  wall p50 ms " << h::fixed(a50, 1) << h::fixed(b50, 1)
+        << h::fixed(a50 > 0 ? b50 / a50 : 0, 3) << std::endl
+        << "  wall p90 ms " << h::fixed(r.a.percentile(90), 1)
+        << h::fixed(r.b.percentile(90), 1) << std::endl
+        << "  wall max ms " << h::fixed(r.a.percentile(100), 1)
+        << h::fixed(r.b.percentile(100), 1) << std::endl
+        << "  msgs/s p50  " << h::fixed(rate(a50), 0) << h::fixed(rate(b50), 0)
+        << h::fixed(a50 > 0 && b50 > 0 ? a50 / b50 : 0, 3) << std::endl
+        << "  user ms     " << h::fixed(r.a.user_ms(), 1)
+        << h::fixed(r.b.user_ms(), 1) << std::endl
+        << "  peak rss KB " << h::fixed(r.a.rss_kb(), 0)
+        << h::fixed(r.b.rss_kb(), 0)
+        << h::fixed(r.a.rss_kb() > 0 ?
+                    double(r.b.rss_kb()) / r.a.rss_kb() : 0, 3) << std::endl
+        << "  exit status " << h::fixed(r.a.runs.back().status, 0)
+        << h::fixed(r.b.runs.back().status, 0) << std::endl
+        << "  verdict:      "
+        << (r.failures.empty() ? std::string("pass") : "fail -" + r.failures)
+        << std::endl;
+  }
+  out << (in.passed() ? "PASS" : "FAIL") << std::endl;
+  return out;
+}
+
+}
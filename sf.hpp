@@ -0,0 +1,156 @@
+#ifndef __EXP_SPILL_FILE_HPP__
+#define __EXP_SPILL_FILE_HPP__
+
+#include <map>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <ec.hpp>
+
+namespace trade {
+
+////////
+/// memory mapped spill file for cold products' resting orders
+/// - a product's orders are stored as one extent: its records in
+///   product index order followed by their positions in composite
+///   index order, so a fault can rebuild both orderings exactly
+/// - extents of faulted products are reused best fit; the file grows
+///   by doubling and is never shrunk
+/// - keeps order id -> product for every spilled order so cancels and
+///   modifies can find their product w/o touching the file
+/// - the mapping is shared; the kernel writes cold pages back and
+///   drops them under memory pressure
+/// - single thread
+////////
+class spill_file {
+public:
+
+  ////////
+  /// spilled order
+  ////////
+  struct record {
+    int32_t  id;
+    int32_t  prod;
+    int32_t  quantity;
+    int32_t  price;
+    int32_t  side;      /// caller's encoding
+  };
+
+  ////////
+  /// spilled product
+  ////////
+  struct extent {
+    uint64_t  offset;
+    uint64_t  count;    /// records
+    uint64_t  bytes;    /// reserved
+  };
+
+  typedef std::map<int, extent>  products_t;
+
+  ////////
+  /// semantics ->
+  /// - nothing is created until open()
+  ////////
+  spill_file(const std::string& file);
+
+  ////////
+  /// semantics ->
+  /// - unmaps and closes; the file is left behind
+  ////////
+  ~spill_file();
+
+  spill_file(const spill_file&) = delete;
+  spill_file& operator=(const spill_file&) = delete;
+
+  ////////
+  /// open semantics ->
+  /// - creates or truncates the file and maps it
+  ////////
+  bool open(support::error_code& err);
+
+  ////////
+  /// put semantics ->
+  /// - stores prod's records [product order] and order, the record
+  ///   positions in composite order
+  /// - false w/ err set if the file couldn't grow; nothing is stored
+  ////////
+  bool put(support::error_code& err,
+           int prod,
+           const std::vector<record>& records,
+           const std::vector<uint32_t>& order);
+
+  ////////
+  /// take semantics ->
+  /// - copies prod's records and order out and forgets prod
+  /// - false if prod isn't spilled
+  ////////
+  bool take(int prod,
+            std::vector<record>& records,
+            std::vector<uint32_t>& order);
+
+  ////////
+  /// owner semantics ->
+  /// - true w/ prod set if order id is spilled
+  ////////
+  bool owner(int id, int& prod) const;
+
+  ////////
+  /// semantics ->
+  /// - spilled products in ascending order
+  ////////
+  const products_t& products() const;
+
+  ////////
+  /// visit semantics ->
+  /// - calls f(record) for the first limit records of e in product
+  ///   order, straight from the mapping
+  ////////
+  template <class F>
+  void visit(const extent& e, size_t limit, F f) const;
+
+  ////////
+  /// semantics ->
+  /// - spilled orders / file size in bytes
+  ////////
+  size_t orders() const;
+  size_t size() const;
+
+private:
+
+  ////////
+  /// semantics ->
+  /// - offset of a free run of at least n bytes [best fit or the end]
+  /// - false if the file couldn't grow
+  ////////
+  bool reserve(support::error_code& err, uint64_t n, uint64_t& offset,
+               uint64_t& bytes);
+
+  ////////
+  /// semantics ->
+  /// - file and mapping at least n bytes
+  ////////
+  bool grow(support::error_code& err, uint64_t n);
+
+  typedef std::multimap<uint64_t, uint64_t>  free_t;   /// bytes -> offset
+
+  std::string                  file_;
+  int                          fd_;
+  char*                        base_;
+  uint64_t                     capacity_;
+  uint64_t                     end_;
+  products_t                   products_;
+  free_t                       free_;
+  std::unordered_map<int, int> owners_;
+};
+
+}
+
+#include <sf.ipp>
+
+#endif
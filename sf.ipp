@@ -0,0 +1,224 @@
+namespace trade {
+
+////////
+/// constructor
+////////
+inline
+spill_file::
+spill_file(const std::string& file) :
+  file_    (file),
+  fd_      (-1),
+  base_    (nullptr),
+  capacity_(0),
+  end_     (0) {
+}
+
+////////
+/// destructor
+////////
+inline
+spill_file::
+~spill_file() {
+  if (base_) {
+    ::munmap(base_, capacity_);
+  }
+  if (fd_ != -1) {
+    ::close(fd_);
+  }
+}
+
+////////
+/// open
+////////
+inline bool
+spill_file::
+open(support::error_code& err) {
+
+  fd_ = ::open(file_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd_ == -1) {
+    err.append(-1, "Failed to open spill file: <:" + file_ + ">, " +
+                   std::strerror(errno));
+    return false;
+  }
+  return grow(err, 1 << 20);
+}
+
+////////
+/// put
+////////
+inline bool
+spill_file::
+put(support::error_code& err,
+    int prod,
+    const std::vector<record>& records,
+    const std::vector<uint32_t>& order) {
+
+  const uint64_t n = records.size() * sizeof(record) +
+                     order.size() * sizeof(uint32_t);
+  uint64_t offset, bytes;
+  if (!reserve(err, n, offset, bytes)) {
+    return false;
+  }
+  char* p = base_ + offset;
+  std::memcpy(p, records.data(), records.size() * sizeof(record));
+  std::memcpy(p + records.size() * sizeof(record), order.data(),
+              order.size() * sizeof(uint32_t));
+
+  products_[prod] = extent{offset, records.size(), bytes};
+  for (size_t i = 0; i < records.size(); ++i) {
+    owners_[records[i].id] = prod;
+  }
+  return true;
+}
+
+////////
+/// take
+////////
+inline bool
+spill_file::
+take(int prod,
+     std::vector<record>& records,
+     std::vector<uint32_t>& order) {
+
+  products_t::iterator i = products_.find(prod);
+  if (i == products_.end()) {
+    return false;
+  }
+  const extent e = i->second;
+  const record* r = reinterpret_cast<const record*>(base_ + e.offset);
+  const uint32_t* o = reinterpret_cast<const uint32_t*>(r + e.count);
+  records.assign(r, r + e.count);
+  order.assign(o, o + e.count);
+
+  for (size_t k = 0; k < e.count; ++k) {
+    owners_.erase(r[k].id);
+  }
+  products_.erase(i);
+  if (e.bytes) {
+    free_.insert(std::make_pair(e.bytes, e.offset));
+  }
+  return true;
+}
+
+////////
+/// owner
+////////
+inline bool
+spill_file::
+owner(int id,
+      int& prod) const {
+
+  std::unordered_map<int, int>::const_iterator i = owners_.find(id);
+  if (i == owners_.end()) {
+    return false;
+  }
+  prod = i->second;
+  return true;
+}
+
+////////
+/// products
+////////
+inline const spill_file::products_t&
+spill_file::
+products() const {
+  return products_;
+}
+
+////////
+/// visit
+////////
+template <class F>
+inline void
+spill_file::
+visit(const extent& e,
+      size_t limit,
+      F f) const {
+
+  const record* r = reinterpret_cast<const record*>(base_ + e.offset);
+  const size_t n = limit < e.count ? limit : e.count;
+  for (size_t i = 0; i < n; ++i) {
+    f(r[i]);
+  }
+}
+
+////////
+/// orders
+////////
+inline size_t
+spill_file::
+orders() const {
+  return owners_.size();
+}
+
+////////
+/// size
+////////
+inline size_t
+spill_file::
+size() const {
+  return end_;
+}
+
+////////
+/// reserve
+/// - runs are kept 64 byte granular so freed extents are reusable
+////////
+inline bool
+spill_file::
+reserve(support::error_code& err,
+        uint64_t n,
+        uint64_t& offset,
+        uint64_t& bytes) {
+
+  bytes = (n + 63) & ~uint64_t(63);
+  if (!bytes) {
+    offset = 0;
+    return true;
+  }
+  free_t::iterator i = free_.lower_bound(bytes);
+  if (i != free_.end()) {
+    offset = i->second;
+    bytes  = i->first;
+    free_.erase(i);
+    return true;
+  }
+  if (end_ + bytes > capacity_ && !grow(err, end_ + bytes)) {
+    return false;
+  }
+  offset = end_;
+  end_  += bytes;
+  return true;
+}
+
+////////
+/// grow
+////////
+inline bool
+spill_file::
+grow(support::error_code& err,
+     uint64_t n) {
+
+  uint64_t c = capacity_ ? capacity_ : n;
+  while (c < n) {
+    c *= 2;
+  }
+  if (::ftruncate(fd_, c) == -1) {
+    err.append(-1, "Failed to grow spill file: <:" + file_ + ">, " +
+                   std::strerror(errno));
+    return false;
+  }
+  void* p = base_ ?
+    ::mremap(base_, capacity_, c, MREMAP_MAYMOVE) :
+    ::mmap(nullptr, c, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (p == MAP_FAILED) {
+    err.append(-1, "Failed to map spill file: <:" + file_ + ">, " +
+                   std::strerror(errno));
+    return false;
+  }
+  base_     = static_cast<char*>(p);
+  capacity_ = c;
+  return true;
+}
+
+}
@@ -0,0 +1,45 @@
+#ifndef __EXP_SYNTHETIC_LOAD_HPP__
+#define __EXP_SYNTHETIC_LOAD_HPP__
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace trade {
+
+////////
+/// synthetic engine load
+/// - a fixed mix of adds, cancels and amends spread over products and
+///   a price band around a mid; buys and sells overlap, so some adds
+///   cross
+/// - drawn up front, so a timed loop only calls the engine
+/// - eb.cpp and sr.cpp replay it
+////////
+class synthetic_load {
+public:
+
+  struct op {
+    char  action;   /// N, R or M
+    int   id;
+    int   prod;
+    bool  buy;
+    int   quantity;
+    int   price;
+  };
+
+  ////////
+  /// generate semantics ->
+  /// - n ops over products products, prices in band ticks around 1000
+  /// - the same seed draws the same ops
+  ////////
+  static std::vector<op> generate(size_t n,
+                                  int products,
+                                  int band,
+                                  unsigned seed);
+};
+
+}
+
+#include <sl.ipp>
+
+#endif
@@ -0,0 +1,47 @@
+namespace trade {
+
+////////
+/// generate
+////////
+inline std::vector<synthetic_load::op>
+synthetic_load::
+generate(size_t n,
+         int products,
+         int band,
+         unsigned seed) {
+
+  std::vector<op> ops;
+  std::vector<int> live;
+  ops.reserve(n);
+  uint64_t s = seed;
+  auto next = [&s]() {
+    s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<uint32_t>(s >> 33);
+  };
+  int id = 0;
+  while (ops.size() < n) {
+    const uint32_t r = next() % 100;
+    if (r < 20 && !live.empty()) {
+      const size_t i = next() % live.size();
+      ops.push_back(op{'R', live[i], 0, false, 0, 0});
+      live[i] = live.back();
+      live.pop_back();
+    }
+    else if (r < 30 && !live.empty()) {
+      const int q = next() % 100 + 1;
+      const int p = 1000 + static_cast<int>(next() % band) - band / 2;
+      ops.push_back(op{'M', live[next() % live.size()], 0, false, q, p});
+    }
+    else {
+      const bool buy = next() & 1;
+      const int p = 1000 + static_cast<int>(next() % band) -
+                    (buy ? band / 2 + 1 : band / 2 - 1);
+      ops.push_back(op{'N', ++id, static_cast<int>(next() % products), buy,
+                       static_cast<int>(next() % 100 + 1), p});
+      live.push_back(id);
+    }
+  }
+  return ops;
+}
+
+}
@@ -0,0 +1,230 @@
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <iostream>
+#include <unistd.h>
+#include <me.hpp>
+#include <sl.hpp>
+#include <bs.hpp>
+#include <af.hpp>
+
+using op = trade::synthetic_load::op;
+
+////////
+/// mirrors engine changes into the snapshots the way the tracker does
+////////
+static void
+filled(const trade::matching_engine& me,
+       trade::book_snapshots& bs,
+       char side) {
+
+  for (const trade::matching_engine::fill& f : me.tape()) {
+    if (f.left > 0) {
+      bs.update(f.prod, side, f.price, f.resting, f.left);
+    }
+    else {
+      bs.remove(f.prod, side, f.price, f.resting);
+    }
+  }
+}
+
+static void
+rested(const trade::matching_engine& me,
+       trade::book_snapshots& bs,
+       int id) {
+
+  int prod;
+  bool buy;
+  int price;
+  int quantity;
+  if (me.locate(id, prod, buy, price, quantity)) {
+    bs.add(prod, buy ? 'B' : 'S', price, id, quantity);
+  }
+}
+
+////////
+/// one ingest pass; returns seconds spent
+////////
+static double
+ingest(const std::vector<op>& ops,
+       trade::matching_engine& me,
+       trade::book_snapshots& bs,
+       size_t interval) {
+
+  const std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  for (size_t i = 0; i < ops.size(); ++i) {
+    const op& o = ops[i];
+    int prod;
+    bool buy;
+    int price;
+    int quantity;
+    if (o.action == 'N') {
+      if (me.add(o.id, o.prod,
+                 o.buy ? trade::matching_engine::side_t::buy :
+                         trade::matching_engine::side_t::sell,
+                 o.quantity, o.price)) {
+        filled(me, bs, o.buy ? 'S' : 'B');
+        rested(me, bs, o.id);
+      }
+    }
+    else if (!me.locate(o.id, prod, buy, price, quantity)) {
+    }
+    else if (o.action == 'R') {
+      me.cancel(o.id);
+      bs.remove(prod, buy ? 'B' : 'S', price, o.id);
+    }
+    else if (me.modify(o.id, o.quantity, o.price)) {
+      if (o.price == price && o.quantity <= quantity) {
+        bs.update(prod, buy ? 'B' : 'S', price, o.id, o.quantity);
+      }
+      else {
+        bs.remove(prod, buy ? 'B' : 'S', price, o.id);
+        filled(me, bs, buy ? 'S' : 'B');
+        rested(me, bs, o.id);
+      }
+    }
+    if ((i + 1) % interval == 0) {
+      bs.publish(i + 1);
+    }
+  }
+  bs.publish(ops.size());
+  return std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+
+  ////////
+  /// -n n -> operations per run
+  /// -p n -> products
+  /// -b n -> price band in ticks
+  /// -i n -> publish every n operations
+  /// -r n -> reader threads, at most support::epoch::slots_
+  /// -d n -> reader pause between queries in microseconds [0 spins]
+  /// -c l -> pin ingest, then reader threads to the cpus in comma
+  ///         separated list l
+  /// -s n -> seed
+  ///
+  /// runs ingest alone, then w/ the readers, and prints both rates;
+  /// readers query products, ids and crossed orders picked from the
+  /// view they read, so every query hits something published
+  ////////
+  size_t n = 1000000;
+  int products = 16;
+  int band = 40;
+  size_t interval = 1024;
+  size_t readers = 4;
+  int pause = 0;
+  std::vector<int> cpus;
+  unsigned seed = 1;
+  int c;
+  while ((c = ::getopt(argc, argv, "n:p:b:i:r:d:c:s:")) != -1) {
+    if (c == 'n')      n = ::atol(optarg);
+    else if (c == 'p') products = ::atoi(optarg);
+    else if (c == 'b') band = ::atoi(optarg);
+    else if (c == 'i') interval = ::atol(optarg);
+    else if (c == 'r') readers = ::atol(optarg);
+    else if (c == 'd') pause = ::atoi(optarg);
+    else if (c == 'c') cpus = support::cpus(optarg);
+    else if (c == 's') seed = ::atoi(optarg);
+    else {
+      std::cout << "Usage: <" << argv[0] << "> [-n ops] [-p products] "
+                << "[-b band] [-i interval] [-r readers] [-d pause] "
+                << "[-c cpus] [-s seed]" << std::endl;
+      return -1;
+    }
+  }
+  if (!interval) {
+    std::cout << "Bad interval: <0>" << std::endl;
+    return -1;
+  }
+  if (readers > support::epoch::slots_) {
+    std::cout << "Too many readers: <" << readers << ">, at most "
+              << support::epoch::slots_ << std::endl;
+    return -1;
+  }
+  if (!cpus.empty()) {
+    support::error_code err;
+    if (!support::pin(err, cpus[0])) {
+      std::cout << err;
+      return -1;
+    }
+  }
+  const std::vector<op> ops =
+    trade::synthetic_load::generate(n, products, band, seed);
+
+  ////////
+  /// ingest alone
+  ////////
+  double alone;
+  {
+    trade::matching_engine me(n);
+    trade::book_snapshots bs;
+    alone = ingest(ops, me, bs, interval);
+  }
+
+  ////////
+  /// ingest w/ readers
+  ////////
+  trade::matching_engine me(n);
+  trade::book_snapshots bs;
+  std::atomic<bool> done(false);
+  std::atomic<size_t> queries(0);
+  std::atomic<size_t> hits(0);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < readers; ++i) {
+    const int cpu = cpus.size() > 1 ? cpus[1 + i % (cpus.size() - 1)] : -1;
+    threads.emplace_back([&bs, &done, &queries, &hits, i, cpu, pause,
+                          products]() {
+      support::error_code err;
+      support::pin(err, cpu);
+      trade::book_snapshots::reader r(bs);
+      trade::book_snapshots::order_views v;
+      trade::book_snapshots::order_view o;
+      size_t q = 0;
+      size_t h = 0;
+      for (size_t k = i; !done.load(std::memory_order_relaxed); ++k) {
+        int prod = -1;
+        int id = -1;
+        r.read([k, products, &prod, &id](
+                 const trade::book_snapshots::view& v) {
+          const trade::book_snapshots::book* b = v.find_book(k % products);
+          if (b) {
+            const trade::book_snapshots::page* p = b->begin()[k % b->size];
+            prod = p->prod;
+            id = p->begin()[k % p->size].id;
+          }
+        });
+        r.product(prod, v);
+        h += r.find(id, o);
+        r.crossed(v);
+        q += 3;
+        if (pause) {
+          std::this_thread::sleep_for(std::chrono::microseconds(pause));
+        }
+      }
+      queries += q;
+      hits += h;
+    });
+  }
+  const double shared = ingest(ops, me, bs, interval);
+  done = true;
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+
+  std::cout << "ops " << ops.size()
+            << ", interval " << interval
+            << ", resting " << me.size() << std::endl
+            << "alone: " << alone * 1e3 << "ms, "
+            << static_cast<uint64_t>(ops.size() / alone) << " ops/s"
+            << std::endl
+            << "readers " << readers << ": " << shared * 1e3 << "ms, "
+            << static_cast<uint64_t>(ops.size() / shared) << " ops/s, "
+            << "queries " << queries.load()
+            << ", ids found " << hits.load() << std::endl;
+  return 0;
+}
@@ -0,0 +1,171 @@
+#include <cstdlib>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+#include <me.hpp>
+#include <ar.hpp>
+#include <pc.hpp>
+
+////////
+/// AnonHugePages of this process in kB, -1 if the kernel won't say
+////////
+static long
+anon_huge_pages() {
+
+  std::ifstream in("/proc/self/smaps_rollup");
+  std::string line;
+  while (std::getline(in, line)) {
+    if (line.compare(0, 14, "AnonHugePages:") == 0) {
+      return ::atol(line.c_str() + 14);
+    }
+  }
+  return -1;
+}
+
+////////
+/// one pass over a resting book of n orders
+/// - build: adds n orders over a price band w/o crossing [bids below,
+///   asks above the mid]
+/// - touch: n cancels or same price amends of random resting ids, so
+///   every op lands on a cold node and index slot
+////////
+static void
+pass(size_t n,
+     int products,
+     int band,
+     unsigned seed,
+     support::arena* arena,
+     const char* name) {
+
+  std::vector<std::string> stages;
+  stages.push_back("build");
+  stages.push_back("touch");
+  support::perf_counters perf(stages);
+  trade::matching_engine me(n, arena);
+
+  uint64_t s = seed;
+  auto next = [&s]() {
+    s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<uint32_t>(s >> 33);
+  };
+
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  perf.enter(0);
+  for (size_t i = 0; i < n; ++i) {
+    const bool buy = next() & 1;
+    const int p = buy ? 1000 - 1 - static_cast<int>(next() % band) :
+                        1000 + 1 + static_cast<int>(next() % band);
+    me.add(static_cast<int>(i + 1), static_cast<int>(next() % products),
+           buy ? trade::matching_engine::side_t::buy :
+                 trade::matching_engine::side_t::sell,
+           static_cast<int>(next() % 100 + 2), p);
+  }
+  perf.leave();
+  const double build = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  size_t done = 0;
+  perf.enter(1);
+  for (size_t i = 0; i < n; ++i) {
+    const int id = static_cast<int>(next() % n + 1);
+    int prod;
+    bool buy;
+    int price;
+    int quantity;
+    if (!me.locate(id, prod, buy, price, quantity)) {
+      continue;
+    }
+    if (quantity > 1 && (next() & 3)) {
+      done += me.modify(id, quantity - 1, price);
+    }
+    else {
+      done += me.cancel(id);
+    }
+  }
+  perf.leave();
+  const double touch = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  perf.messages(n);
+
+  const long huge = anon_huge_pages();
+  std::cout << "pages " << name
+            << ": build " << static_cast<uint64_t>(n / build) << " ops/s"
+            << ", touch " << static_cast<uint64_t>(n / touch) << " ops/s"
+            << " [" << done << " applied]"
+            << ", AnonHugePages ";
+  if (huge < 0) std::cout << "n/a";
+  else          std::cout << huge << "kB";
+  std::cout << std::endl << perf;
+  if (arena) {
+    std::cout << *arena;
+  }
+}
+
+int main(int argc, char** argv) {
+
+  ////////
+  /// -n n -> resting orders [and touches] per pass
+  /// -p n -> products
+  /// -b n -> price levels per side
+  /// -H l -> page backings to run, any of o [operator new], n [arena,
+  ///         normal pages], t [transparent huge], h [hugetlb]
+  /// -N n -> arena memory preferred on numa node n
+  /// -s n -> seed
+  ///
+  /// prints build and touch rates per backing, the per op counter
+  /// profile [dtlb misses are n/a where the pmu isn't exposed] and
+  /// the process' AnonHugePages while the book is still resting
+  ////////
+  size_t n = 2000000;
+  int products = 64;
+  int band = 200;
+  std::string backings = "ont";
+  int node = -1;
+  unsigned seed = 1;
+  int c;
+  while ((c = ::getopt(argc, argv, "n:p:b:H:N:s:")) != -1) {
+    if (c == 'n')      n = ::atol(optarg);
+    else if (c == 'p') products = ::atoi(optarg);
+    else if (c == 'b') band = ::atoi(optarg);
+    else if (c == 'H') backings = optarg;
+    else if (c == 'N') node = ::atoi(optarg);
+    else if (c == 's') seed = ::atoi(optarg);
+    else {
+      std::cout << "Usage: <" << argv[0] << "> [-n orders] [-p products] "
+                << "[-b band] [-H onth] [-N node] [-s seed]" << std::endl;
+      return -1;
+    }
+  }
+
+  for (size_t i = 0; i < backings.size(); ++i) {
+    const char b = backings[i];
+    if (b == 'o') {
+      pass(n, products, band, seed, nullptr, "operator new");
+      continue;
+    }
+    support::arena::policy p;
+    p.node = node;
+    if (b == 'n') {
+      p.pages = support::arena::pages_t::normal;
+    }
+    else if (b == 't') {
+      p.pages = support::arena::pages_t::transparent;
+    }
+    else if (b == 'h') {
+      p.pages = support::arena::pages_t::hugetlb;
+    }
+    else {
+      std::cout << "Bad backing: <" << b << ">" << std::endl;
+      return -1;
+    }
+    support::arena a(p);
+    pass(n, products, band, seed, &a,
+         b == 'n' ? "normal" : b == 't' ? "transparent" : "hugetlb");
+  }
+  return 0;
+}